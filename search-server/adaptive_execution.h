@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+// Execution policy tag that lets the server choose between sequential and parallel execution per query
+struct AdaptivePolicy
+{};
+
+inline constexpr AdaptivePolicy adaptive_policy{};
+
+// Where adaptive execution switches to the parallel algorithms. SearchServer calibrates the defaults
+// once per process by timing both variants on a synthetic index, see GetCalibratedExecutionThresholds
+struct ExecutionThresholds
+{
+	// FindTopDocuments runs in parallel from this many postings of the query words on
+	size_t parallel_postings = std::numeric_limits<size_t>::max();
+	// Postings given to each worker, which sets the number of ConcurrentMap buckets
+	size_t postings_per_worker = std::numeric_limits<size_t>::max();
+	// MatchDocuments runs in parallel from this many (document, query word) pairs on
+	size_t parallel_match_pairs = std::numeric_limits<size_t>::max();
+};
+
+struct ExecutionPlan
+{
+	bool parallel = false;
+	int worker_count = 1;
+	// Postings of the plus and minus words of the query
+	size_t posting_count = 0;
+};
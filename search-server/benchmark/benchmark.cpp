@@ -0,0 +1,222 @@
+// End-to-end benchmark of the search server on a synthetic corpus with a Zipf-distributed vocabulary.
+// Prints one JSON object per line: the options first, then one line per measured operation.
+//
+// Build from the search-server directory:
+//   g++ -std=c++17 -O2 -DNDEBUG benchmark/benchmark.cpp benchmark/benchmark_tools.cpp benchmark/zipf_corpus.cpp $(ls *.cpp | grep -v '^main.cpp$') -ltbb -lpthread -o search_benchmark
+// Run:
+//   ./search_benchmark --documents 100000 --document-length 200 --minus-ratio 0.1 > results.jsonl
+
+#include "benchmark_tools.h"
+#include "zipf_corpus.h"
+
+#include "../search_server.h"
+#include "../remove_duplicates.h"
+#include "../sharded_search_server.h"
+
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::cerr << "Options: --documents N --vocabulary N --document-length N --queries N --query-length N"s
+			<< " --minus-ratio X --duplicate-ratio X --stop-words N --zipf X --seed N"s << std::endl;
+	}
+
+	CorpusOptions ParseOptions(int argc, char* argv[])
+	{
+		CorpusOptions options;
+		for (int index = 1; index < argc; ++index)
+		{
+			const std::string_view name = argv[index];
+			if (index + 1 == argc)
+			{
+				throw std::invalid_argument("Missing value of option "s + std::string(name));
+			}
+			const char* value = argv[++index];
+			if (name == "--documents")
+			{
+				options.document_count = std::stoull(value);
+			}
+			else if (name == "--vocabulary")
+			{
+				options.vocabulary_size = std::stoull(value);
+			}
+			else if (name == "--document-length")
+			{
+				options.document_length = std::stoull(value);
+			}
+			else if (name == "--queries")
+			{
+				options.query_count = std::stoull(value);
+			}
+			else if (name == "--query-length")
+			{
+				options.query_length = std::stoull(value);
+			}
+			else if (name == "--minus-ratio")
+			{
+				options.minus_ratio = std::stod(value);
+			}
+			else if (name == "--duplicate-ratio")
+			{
+				options.duplicate_ratio = std::stod(value);
+			}
+			else if (name == "--stop-words")
+			{
+				options.stop_word_count = std::stoull(value);
+			}
+			else if (name == "--zipf")
+			{
+				options.zipf_exponent = std::stod(value);
+			}
+			else if (name == "--seed")
+			{
+				options.seed = std::stoull(value);
+			}
+			else
+			{
+				throw std::invalid_argument("Unknown option "s + std::string(name));
+			}
+		}
+		if (options.vocabulary_size == 0 || options.document_count == 0)
+		{
+			throw std::invalid_argument("The corpus must have documents and words"s);
+		}
+		return options;
+	}
+
+	void PrintOptions(const CorpusOptions& options)
+	{
+		JsonLine()
+			.Add("benchmark", "options")
+			.Add("documents", static_cast<uint64_t>(options.document_count))
+			.Add("vocabulary", static_cast<uint64_t>(options.vocabulary_size))
+			.Add("document_length", static_cast<uint64_t>(options.document_length))
+			.Add("queries", static_cast<uint64_t>(options.query_count))
+			.Add("query_length", static_cast<uint64_t>(options.query_length))
+			.Add("minus_ratio", options.minus_ratio)
+			.Add("duplicate_ratio", options.duplicate_ratio)
+			.Add("stop_words", static_cast<uint64_t>(options.stop_word_count))
+			.Add("zipf", options.zipf_exponent)
+			.Add("seed", options.seed)
+			.Print(std::cout);
+	}
+
+	void RunBenchmarks(const CorpusOptions& options)
+	{
+		const Corpus corpus = GenerateCorpus(options);
+		const auto& documents = corpus.documents;
+		const auto& queries = corpus.queries;
+		const auto report = [](const BenchmarkResult& result)
+		{
+			MakeReport(result).Print(std::cout);
+		};
+
+		SearchServer server(corpus.stop_words);
+		report(MeasureEach("AddDocument", "seq", documents.size(), [&](size_t index)
+			{
+				server.AddDocument(documents[index].id, documents[index].text, DocumentStatus::ACTUAL, documents[index].ratings);
+			}));
+
+		if (!queries.empty())
+		{
+			report(MeasureEach("FindTopDocuments", "seq", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(server.FindTopDocuments(std::execution::seq, queries[index]));
+				}));
+			report(MeasureEach("FindTopDocuments", "par", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(server.FindTopDocuments(std::execution::par, queries[index]));
+				}));
+			report(MeasureEach("FindTopDocuments", "adaptive", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(server.FindTopDocuments(adaptive_policy, queries[index]));
+				}));
+
+			// Every query is matched against a document picked by the same seeded generator
+			std::mt19937_64 generator(options.seed);
+			std::vector<int> match_ids(queries.size());
+			for (int& id : match_ids)
+			{
+				id = documents[generator() % documents.size()].id;
+			}
+			report(MeasureEach("MatchDocument", "seq", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(server.MatchDocument(std::execution::seq, queries[index], match_ids[index]));
+				}));
+			report(MeasureEach("MatchDocument", "par", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(server.MatchDocument(std::execution::par, queries[index], match_ids[index]));
+				}));
+		}
+
+		// The same corpus split between one shard per hardware thread
+		ShardedSearchServer sharded(corpus.stop_words);
+		std::vector<ShardedSearchServer::NewDocument> new_documents;
+		new_documents.reserve(documents.size());
+		for (const CorpusDocument& document : documents)
+		{
+			new_documents.push_back({ document.id, document.text, DocumentStatus::ACTUAL, document.ratings });
+		}
+		report(MeasureBatch("AddDocument", "sharded batch", new_documents.size(), [&]()
+			{
+				sharded.AddDocuments(new_documents);
+			}));
+		if (!queries.empty())
+		{
+			report(MeasureEach("FindTopDocuments", "sharded", queries.size(), [&](size_t index)
+				{
+					DoNotOptimize(sharded.FindTopDocuments(queries[index]));
+				}));
+		}
+
+		const size_t document_count = server.GetDocumentCount();
+		report(MeasureBatch("RemoveDuplicates", "seq", document_count, [&]()
+			{
+				RemoveDuplicates(server);
+			}));
+
+		// Every other remaining document is removed sequentially, the rest in parallel
+		std::vector<int> remaining(server.begin(), server.end());
+		std::vector<int> sequential_ids;
+		std::vector<int> parallel_ids;
+		for (size_t index = 0; index < remaining.size(); ++index)
+		{
+			(index % 2 == 0 ? sequential_ids : parallel_ids).push_back(remaining[index]);
+		}
+		report(MeasureEach("RemoveDocument", "seq", sequential_ids.size(), [&](size_t index)
+			{
+				server.RemoveDocument(std::execution::seq, sequential_ids[index]);
+			}));
+		report(MeasureEach("RemoveDocument", "par", parallel_ids.size(), [&](size_t index)
+			{
+				server.RemoveDocument(std::execution::par, parallel_ids[index]);
+			}));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const CorpusOptions options = ParseOptions(argc, argv);
+		PrintOptions(options);
+		RunBenchmarks(options);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
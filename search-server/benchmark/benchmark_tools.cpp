@@ -0,0 +1,112 @@
+#include "benchmark_tools.h"
+
+#include <cstdio>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+JsonLine& JsonLine::Add(const std::string& key, const std::string& value)
+{
+	fields_.emplace_back(key, Quote(value));
+	return *this;
+}
+
+JsonLine& JsonLine::Add(const std::string& key, const char* value)
+{
+	return Add(key, std::string(value));
+}
+
+JsonLine& JsonLine::Add(const std::string& key, double value)
+{
+	std::ostringstream text;
+	text.precision(6);
+	text << std::fixed << value;
+	fields_.emplace_back(key, text.str());
+	return *this;
+}
+
+JsonLine& JsonLine::Add(const std::string& key, uint64_t value)
+{
+	fields_.emplace_back(key, std::to_string(value));
+	return *this;
+}
+
+JsonLine& JsonLine::Add(const std::string& key, int value)
+{
+	fields_.emplace_back(key, std::to_string(value));
+	return *this;
+}
+
+void JsonLine::Print(std::ostream& output) const
+{
+	output << '{';
+	for (size_t index = 0; index < fields_.size(); ++index)
+	{
+		output << (index == 0 ? "" : ",") << Quote(fields_[index].first) << ':' << fields_[index].second;
+	}
+	output << "}\n";
+}
+
+std::string JsonLine::Quote(const std::string& text)
+{
+	std::string result = "\"";
+	for (const char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+			result += escaped;
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result + '"';
+}
+
+JsonLine MakeReport(const BenchmarkResult& result)
+{
+	const double seconds = std::chrono::duration<double>(result.total_time).count();
+	JsonLine line;
+	line.Add("benchmark", result.name)
+		.Add("variant", result.variant)
+		.Add("operations", result.operations)
+		.Add("seconds", seconds)
+		.Add("throughput", seconds > 0.0 ? result.operations / seconds : 0.0);
+	if (result.latencies.GetCount() > 0)
+	{
+		line.Add("p50_ns", result.latencies.GetValueAtPercentile(50.0))
+			.Add("p95_ns", result.latencies.GetValueAtPercentile(95.0))
+			.Add("p99_ns", result.latencies.GetValueAtPercentile(99.0));
+	}
+	line.Add("peak_rss_kb", GetPeakRssKb());
+	return line;
+}
+
+uint64_t GetPeakRssKb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#if defined(__APPLE__)
+	// Reported in bytes on macOS and in kilobytes elsewhere
+	return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../histogram.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One line of machine-readable output: a flat JSON object with fields in insertion order
+class JsonLine
+{
+public:
+	JsonLine& Add(const std::string& key, const std::string& value);
+	JsonLine& Add(const std::string& key, const char* value);
+	JsonLine& Add(const std::string& key, double value);
+	JsonLine& Add(const std::string& key, uint64_t value);
+	JsonLine& Add(const std::string& key, int value);
+
+	void Print(std::ostream& output) const;
+
+private:
+	std::vector<std::pair<std::string, std::string>> fields_;
+
+	static std::string Quote(const std::string& text);
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string variant;
+	uint64_t operations = 0;
+	std::chrono::steady_clock::duration total_time{};
+	// Latency of single operations in nanoseconds, empty for benchmarks timed as a whole
+	Histogram latencies;
+};
+
+// Name, variant, operations, seconds, operations per second, latency percentiles and peak RSS so far
+JsonLine MakeReport(const BenchmarkResult& result);
+
+// Peak resident set size of the process in kilobytes, zero where it cannot be queried
+uint64_t GetPeakRssKb();
+
+// Calls operation(index) for every index, timing each call separately
+template <typename Operation>
+BenchmarkResult MeasureEach(std::string name, std::string variant, size_t count, Operation operation)
+{
+	using Clock = std::chrono::steady_clock;
+	BenchmarkResult result{ std::move(name), std::move(variant), count, {}, {} };
+	const auto start = Clock::now();
+	for (size_t index = 0; index < count; ++index)
+	{
+		const auto operation_start = Clock::now();
+		operation(index);
+		result.latencies.Add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - operation_start).count()));
+	}
+	result.total_time = Clock::now() - start;
+	return result;
+}
+
+// Calls operation() once and reports it as the given number of operations
+template <typename Operation>
+BenchmarkResult MeasureBatch(std::string name, std::string variant, size_t count, Operation operation)
+{
+	using Clock = std::chrono::steady_clock;
+	BenchmarkResult result{ std::move(name), std::move(variant), count, {}, {} };
+	const auto start = Clock::now();
+	operation();
+	result.total_time = Clock::now() - start;
+	return result;
+}
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused
+template <typename Value>
+void DoNotOptimize(const Value& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
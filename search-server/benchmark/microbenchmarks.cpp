@@ -0,0 +1,260 @@
+// Microbenchmarks of the utilities reused outside the server: ConcurrentMap, SplitIntoWords, query parsing
+// and Paginator. Every candidate is measured next to a baseline written with plain standard containers,
+// so a change to one of these headers can be judged in isolation. Output is one JSON object per line.
+//
+// Build from the search-server directory:
+//   g++ -std=c++17 -O2 -DNDEBUG benchmark/microbenchmarks.cpp benchmark/benchmark_tools.cpp benchmark/zipf_corpus.cpp $(ls *.cpp | grep -v '^main.cpp$') -ltbb -lpthread -o search_microbenchmarks
+// Run:
+//   ./search_microbenchmarks [--scale X]   (X multiplies the number of operations, 1 by default)
+
+#include "benchmark_tools.h"
+#include "zipf_corpus.h"
+
+#include "../concurrent_map.h"
+#include "../document.h"
+#include "../paginator.h"
+#include "../search_server.h"
+#include "../string_processing.h"
+
+#include <cstdlib>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	const size_t KEY_COUNT = 100000;
+
+	void Report(const BenchmarkResult& result, const std::string& parameter_name, const std::string& parameter_value)
+	{
+		MakeReport(result).Add(parameter_name, parameter_value).Print(std::cout);
+	}
+
+	std::vector<std::vector<int>> GenerateKeys(size_t thread_count, size_t operation_count, bool skewed, uint64_t seed)
+	{
+		const ZipfDistribution zipf(KEY_COUNT, 1.0);
+		std::vector<std::vector<int>> keys(thread_count);
+		for (size_t thread = 0; thread < thread_count; ++thread)
+		{
+			std::mt19937_64 generator(seed + thread);
+			keys[thread].reserve(operation_count / thread_count);
+			for (size_t index = 0; index < operation_count / thread_count; ++index)
+			{
+				keys[thread].push_back(static_cast<int>(skewed ? zipf(generator) : generator() % KEY_COUNT));
+			}
+		}
+		return keys;
+	}
+
+	template <typename Increment>
+	void RunThreads(const std::vector<std::vector<int>>& keys, Increment increment)
+	{
+		std::vector<std::thread> threads;
+		for (const auto& thread_keys : keys)
+		{
+			threads.emplace_back([&thread_keys, &increment]()
+				{
+					for (const int key : thread_keys)
+					{
+						increment(key);
+					}
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	void BenchmarkConcurrentMap(size_t operation_count)
+	{
+		const size_t bucket_count = std::max(1u, std::thread::hardware_concurrency());
+		for (const bool skewed : { false, true })
+		{
+			for (const size_t thread_count : { 1, 2, 4, 8 })
+			{
+				const auto keys = GenerateKeys(thread_count, operation_count, skewed, 42);
+				const std::string parameters = "threads="s + std::to_string(thread_count) + (skewed ? ",keys=zipf"s : ",keys=uniform"s);
+
+				ConcurrentMap<int, double> concurrent_map(bucket_count);
+				Report(MeasureBatch("ConcurrentMap", "candidate", operation_count, [&]()
+					{
+						RunThreads(keys, [&concurrent_map](int key)
+							{
+								concurrent_map[key].ref_to_value += 1.0;
+							});
+					}), "parameters", parameters);
+
+				std::map<int, double> locked_map;
+				std::mutex mutex;
+				Report(MeasureBatch("ConcurrentMap", "baseline: std::map under one mutex", operation_count, [&]()
+					{
+						RunThreads(keys, [&locked_map, &mutex](int key)
+							{
+								std::lock_guard guard(mutex);
+								locked_map[key] += 1.0;
+							});
+					}), "parameters", parameters);
+			}
+		}
+	}
+
+	void BenchmarkSplitIntoWords(size_t scale)
+	{
+		struct Input
+		{
+			std::string name;
+			size_t word_count;
+			size_t repetitions;
+		};
+
+		std::mt19937_64 generator(7);
+		const ZipfDistribution zipf(50000, 1.0);
+		for (const Input& input : { Input{ "short", 5, 200000 * scale }, Input{ "long", 20000, 50 * scale } })
+		{
+			std::string text;
+			for (size_t index = 0; index < input.word_count; ++index)
+			{
+				text += (index == 0 ? "" : " ") + MakeVocabularyWord(zipf(generator));
+			}
+
+			Report(MeasureEach("SplitIntoWords", "candidate", input.repetitions, [&](size_t)
+				{
+					DoNotOptimize(SplitIntoWords(text));
+				}), "input", input.name);
+
+			std::vector<std::byte> buffer(input.word_count * sizeof(std::string_view) * 4);
+			Report(MeasureEach("SplitIntoWords", "candidate: monotonic resource", input.repetitions, [&](size_t)
+				{
+					std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size());
+					DoNotOptimize(SplitIntoWords(text, &resource));
+				}), "input", input.name);
+
+			Report(MeasureEach("SplitIntoWords", "baseline: istringstream into strings", input.repetitions, [&](size_t)
+				{
+					std::istringstream stream(text);
+					std::vector<std::string> words;
+					std::string word;
+					while (stream >> word)
+					{
+						words.push_back(word);
+					}
+					DoNotOptimize(words);
+				}), "input", input.name);
+		}
+	}
+
+	void BenchmarkParseQuery(size_t scale)
+	{
+		// The query parser is private, so it is measured through FindTopDocuments on a server where the
+		// query words match nothing and parsing is the dominant cost
+		const std::string stop_words = "and with in"s;
+		SearchServer server(stop_words);
+		server.AddDocument(0, "unrelated document text"s, DocumentStatus::ACTUAL, { 1 });
+
+		std::string query;
+		for (size_t index = 0; index < 400; ++index)
+		{
+			const size_t word = index % 10;
+			query += (index == 0 ? "" : " ") + (word % 4 == 3 ? "-"s : ""s) + MakeVocabularyWord(word + 100);
+		}
+		const size_t repetitions = 20000 * scale;
+
+		Report(MeasureEach("ParseQuery", "candidate: FindTopDocuments seq", repetitions, [&](size_t)
+			{
+				DoNotOptimize(server.FindTopDocuments(std::execution::seq, query));
+			}), "input", "400 words, 10 distinct"s);
+		Report(MeasureEach("ParseQuery", "candidate: FindTopDocuments par", repetitions, [&](size_t)
+			{
+				DoNotOptimize(server.FindTopDocuments(std::execution::par, query));
+			}), "input", "400 words, 10 distinct"s);
+
+		const std::set<std::string, std::less<>> stop_word_set = { "and"s, "with"s, "in"s };
+		Report(MeasureEach("ParseQuery", "baseline: std::set of strings", repetitions, [&](size_t)
+			{
+				std::set<std::string> plus_words;
+				std::set<std::string> minus_words;
+				std::istringstream stream(query);
+				std::string word;
+				while (stream >> word)
+				{
+					const bool is_minus = word[0] == '-';
+					const std::string_view data = is_minus ? std::string_view(word).substr(1) : std::string_view(word);
+					if (stop_word_set.count(data) == 0)
+					{
+						(is_minus ? minus_words : plus_words).emplace(data);
+					}
+				}
+				DoNotOptimize(plus_words);
+				DoNotOptimize(minus_words);
+			}), "input", "400 words, 10 distinct"s);
+	}
+
+	void BenchmarkPaginator(size_t scale)
+	{
+		std::vector<Document> documents(1000000);
+		for (size_t index = 0; index < documents.size(); ++index)
+		{
+			documents[index] = Document(static_cast<int>(index), 1.0 / (index + 1), static_cast<int>(index % 10));
+		}
+		const size_t repetitions = 20 * scale;
+
+		for (const size_t page_size : { 2, 100 })
+		{
+			const std::string parameters = "documents=1000000,page_size="s + std::to_string(page_size);
+			Report(MeasureEach("Paginator", "candidate", repetitions, [&](size_t)
+				{
+					DoNotOptimize(Paginate(documents, page_size));
+				}), "parameters", parameters);
+
+			Report(MeasureEach("Paginator", "baseline: reserved vector of ranges", repetitions, [&](size_t)
+				{
+					using Iterator = std::vector<Document>::const_iterator;
+					std::vector<IteratorRange<Iterator>> pages;
+					pages.reserve((documents.size() + page_size - 1) / page_size);
+					for (size_t begin = 0; begin < documents.size(); begin += page_size)
+					{
+						pages.emplace_back(documents.cbegin() + begin, documents.cbegin() + std::min(begin + page_size, documents.size()));
+					}
+					DoNotOptimize(pages);
+				}), "parameters", parameters);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		size_t scale = 1;
+		if (argc == 3 && std::string_view(argv[1]) == "--scale")
+		{
+			scale = std::max<size_t>(1, std::stoull(argv[2]));
+		}
+		else if (argc != 1)
+		{
+			throw std::invalid_argument("Usage: search_microbenchmarks [--scale X]"s);
+		}
+
+		BenchmarkConcurrentMap(2000000 * scale);
+		BenchmarkSplitIntoWords(scale);
+		BenchmarkParseQuery(scale);
+		BenchmarkPaginator(scale);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "zipf_corpus.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Uniform double in [0, 1) built from the top 53 bits, unlike std::uniform_real_distribution it is portable
+	double GenerateUnit(std::mt19937_64& generator)
+	{
+		return static_cast<double>(generator() >> 11) * 0x1.0p-53;
+	}
+
+	size_t GenerateIndex(std::mt19937_64& generator, size_t size)
+	{
+		return static_cast<size_t>(GenerateUnit(generator) * size);
+	}
+}
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent)
+{
+	cumulative_.reserve(size);
+	double sum = 0.0;
+	for (size_t rank = 0; rank < size; ++rank)
+	{
+		sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+		cumulative_.push_back(sum);
+	}
+	for (double& value : cumulative_)
+	{
+		value /= sum;
+	}
+}
+
+size_t ZipfDistribution::operator()(std::mt19937_64& generator) const
+{
+	const double unit = GenerateUnit(generator);
+	const auto rank = std::upper_bound(cumulative_.begin(), cumulative_.end(), unit);
+	return std::min(static_cast<size_t>(rank - cumulative_.begin()), cumulative_.size() - 1);
+}
+
+std::string MakeVocabularyWord(size_t rank)
+{
+	std::string word;
+	do
+	{
+		word.push_back(static_cast<char>('a' + rank % 26));
+		rank /= 26;
+	} while (rank > 0);
+	return word;
+}
+
+Corpus GenerateCorpus(const CorpusOptions& options)
+{
+	std::mt19937_64 generator(options.seed);
+	const ZipfDistribution distribution(options.vocabulary_size, options.zipf_exponent);
+
+	Corpus corpus;
+	for (size_t rank = 0; rank < std::min(options.stop_word_count, options.vocabulary_size); ++rank)
+	{
+		corpus.stop_words += (rank == 0 ? "" : " ") + MakeVocabularyWord(rank);
+	}
+
+	corpus.documents.reserve(options.document_count);
+	for (size_t index = 0; index < options.document_count; ++index)
+	{
+		CorpusDocument document{ static_cast<int>(index), {}, {} };
+		if (index > 0 && GenerateUnit(generator) < options.duplicate_ratio)
+		{
+			// Same set of words as an earlier document, RemoveDuplicates must find it
+			const std::string& original = corpus.documents[GenerateIndex(generator, index)].text;
+			std::vector<std::string> words;
+			size_t begin = 0;
+			while (begin < original.size())
+			{
+				const size_t end = std::min(original.find(' ', begin), original.size());
+				words.push_back(original.substr(begin, end - begin));
+				begin = end + 1;
+			}
+			std::reverse(words.begin(), words.end());
+			for (const std::string& word : words)
+			{
+				document.text += (document.text.empty() ? "" : " ") + word;
+			}
+		}
+		else
+		{
+			for (size_t position = 0; position < options.document_length; ++position)
+			{
+				document.text += (position == 0 ? "" : " ") + MakeVocabularyWord(distribution(generator));
+			}
+		}
+		const size_t rating_count = 1 + GenerateIndex(generator, 3);
+		for (size_t rating = 0; rating < rating_count; ++rating)
+		{
+			document.ratings.push_back(static_cast<int>(GenerateIndex(generator, 21)) - 10);
+		}
+		corpus.documents.push_back(std::move(document));
+	}
+
+	corpus.queries.reserve(options.query_count);
+	for (size_t index = 0; index < options.query_count; ++index)
+	{
+		std::string query;
+		for (size_t position = 0; position < options.query_length; ++position)
+		{
+			query += position == 0 ? "" : " ";
+			if (GenerateUnit(generator) < options.minus_ratio)
+			{
+				query += '-';
+			}
+			query += MakeVocabularyWord(distribution(generator));
+		}
+		corpus.queries.push_back(std::move(query));
+	}
+	return corpus;
+}
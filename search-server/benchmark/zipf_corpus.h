@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+struct CorpusOptions
+{
+	size_t document_count = 10000;
+	size_t vocabulary_size = 50000;
+	size_t document_length = 100;
+	size_t query_count = 1000;
+	size_t query_length = 5;
+	// Share of query words turned into minus words
+	double minus_ratio = 0.2;
+	// Share of documents that repeat the words of an earlier document in another order
+	double duplicate_ratio = 0.05;
+	// The most frequent words of the vocabulary become stop words
+	size_t stop_word_count = 20;
+	double zipf_exponent = 1.0;
+	uint64_t seed = 42;
+};
+
+struct CorpusDocument
+{
+	int id;
+	std::string text;
+	std::vector<int> ratings;
+};
+
+struct Corpus
+{
+	std::string stop_words;
+	std::vector<CorpusDocument> documents;
+	std::vector<std::string> queries;
+};
+
+// Samples ranks 0..size-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution
+{
+public:
+	ZipfDistribution(size_t size, double exponent);
+
+	size_t operator()(std::mt19937_64& generator) const;
+
+private:
+	std::vector<double> cumulative_;
+};
+
+// Word of the given frequency rank, made of lowercase letters only
+std::string MakeVocabularyWord(size_t rank);
+
+// The same options and seed produce the same corpus on every platform: the generator only relies
+// on std::mt19937_64, whose output is fixed by the standard
+Corpus GenerateCorpus(const CorpusOptions& options);
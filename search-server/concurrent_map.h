@@ -1,7 +1,11 @@
+#pragma once
+
 #include <algorithm>
 #include <cstdlib>
+#include <deque>
 #include <future>
 #include <map>
+#include <memory_resource>
 #include <numeric>
 #include <random>
 #include <mutex>
@@ -14,9 +18,14 @@ class ConcurrentMap {
 public:
 	static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
 
-	explicit ConcurrentMap(size_t bucket_count)
-		: buckets(bucket_count)
-	{}
+	// The resource is shared by all buckets, so it has to be thread-safe
+	explicit ConcurrentMap(size_t bucket_count, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+	{
+		for (size_t i = 0; i < bucket_count; ++i)
+		{
+			buckets.emplace_back(resource);
+		}
+	}
 
 	struct Access
 	{
@@ -33,18 +42,18 @@ public:
 		return Access{ std::lock_guard<std::mutex>(bucket.m), bucket.dict[key] };
 	}
 
-	void erase(const Key& key)
+	size_t erase(const Key& key)
 	{
 		const uint64_t dict_num = GetDictionaryNumber(key);
         	auto& bucket = buckets[dict_num];
 		std::lock_guard<std::mutex> guard(bucket.m);
 
-		bucket.dict.erase(key);
+		return bucket.dict.erase(key);
 	}
 
-	std::map<Key, Value> BuildOrdinaryMap()
+	std::pmr::map<Key, Value> BuildOrdinaryMap()
 	{
-		std::map<Key, Value> ordinaryMap;
+		std::pmr::map<Key, Value> ordinaryMap(buckets.front().dict.get_allocator());
 
 		for (size_t i = 0; i < buckets.size(); ++i)
 		{
@@ -59,11 +68,15 @@ public:
 private:
     struct Bucket
     {
-        std::map<Key, Value> dict;
+        explicit Bucket(std::pmr::memory_resource* resource)
+            : dict(resource)
+        {}
+
+        std::pmr::map<Key, Value> dict;
         std::mutex m;
     };
     
-    std::vector<Bucket> buckets;
+    std::deque<Bucket> buckets;
 
 	uint64_t GetDictionaryNumber(const Key& key)
 	{
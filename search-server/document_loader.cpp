@@ -0,0 +1,278 @@
+#include "document_loader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <execution>
+#include <stdexcept>
+#include <string>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	int ParseInt(std::string_view text)
+	{
+		int value = 0;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc() || end != text.data() + text.size())
+		{
+			throw std::invalid_argument("Неверное число: "s + std::string(text));
+		}
+		return value;
+	}
+
+	// Lines are parsed in chunks of about this size, and the file is loaded in windows of about this many bytes,
+	// which bounds the memory of the parsed records
+	const size_t CHUNK_SIZE = 1 << 20;
+	const size_t WINDOW_SIZE = 64 << 20;
+
+	// Takes at least min_size bytes of the text, up to the end of a line
+	std::string_view TakeLines(std::string_view& text, size_t min_size)
+	{
+		const size_t line_end = min_size >= text.size() ? std::string_view::npos : text.find('\n', min_size);
+		const size_t size = line_end == std::string_view::npos ? text.size() : line_end + 1;
+		const std::string_view lines = text.substr(0, size);
+		text.remove_prefix(size);
+		return lines;
+	}
+
+	std::invalid_argument MakeLineError(std::string_view text, const char* position, const std::exception& e)
+	{
+		const size_t line_number = 1 + std::count(text.data(), position, '\n');
+		return std::invalid_argument("Строка "s + std::to_string(line_number) + ": "s + e.what());
+	}
+
+	// Parses the lines of the window, a part of the text that line numbers are counted from
+	std::vector<DocumentRecord> ParseWindow(std::string_view text, std::string_view window)
+	{
+		struct Chunk
+		{
+			std::string_view lines;
+			std::vector<DocumentRecord> records;
+			const char* error_line = nullptr;
+			std::exception_ptr error;
+		};
+		std::vector<Chunk> chunks;
+		while (!window.empty())
+		{
+			chunks.push_back({ TakeLines(window, CHUNK_SIZE), {}, nullptr, nullptr });
+		}
+
+		// Exceptions must not leave a parallel algorithm, every chunk keeps its own
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [](Chunk& chunk)
+			{
+				std::string_view lines = chunk.lines;
+				while (!lines.empty())
+				{
+					const size_t end = lines.find('\n');
+					const std::string_view line = lines.substr(0, end);
+					lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 1);
+					try
+					{
+						chunk.records.push_back(ParseDocumentRecord(line));
+					}
+					catch (...)
+					{
+						chunk.error_line = line.data();
+						chunk.error = std::current_exception();
+						return;
+					}
+				}
+			});
+
+		size_t record_count = 0;
+		for (const Chunk& chunk : chunks)
+		{
+			if (chunk.error)
+			{
+				try
+				{
+					std::rethrow_exception(chunk.error);
+				}
+				catch (const std::invalid_argument& e)
+				{
+					throw MakeLineError(text, chunk.error_line, e);
+				}
+			}
+			record_count += chunk.records.size();
+		}
+		std::vector<DocumentRecord> records;
+		records.reserve(record_count);
+		for (Chunk& chunk : chunks)
+		{
+			std::move(chunk.records.begin(), chunk.records.end(), std::back_inserter(records));
+		}
+		return records;
+	}
+
+	template <typename AddRecords>
+	size_t LoadDocumentsImpl(const std::string& path, AddRecords add_records)
+	{
+		// The server keeps copies of the words, so the mapping is released once the file is indexed
+		const MappedFile file(path);
+		const std::string_view text = file.GetData();
+		std::string_view rest = text;
+		size_t document_count = 0;
+		while (!rest.empty())
+		{
+			std::vector<DocumentRecord> records = ParseWindow(text, TakeLines(rest, WINDOW_SIZE));
+			add_records(text, records);
+			document_count += records.size();
+		}
+		return document_count;
+	}
+}
+
+DocumentStatus ParseDocumentStatus(std::string_view text)
+{
+	for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED })
+	{
+		if (text == GetDocumentStatusName(status))
+		{
+			return status;
+		}
+	}
+	throw std::invalid_argument("Неизвестный статус документа: "s + std::string(text));
+}
+
+std::string_view GetDocumentStatusName(DocumentStatus status)
+{
+	switch (status)
+	{
+	case DocumentStatus::ACTUAL:
+		return "ACTUAL";
+	case DocumentStatus::IRRELEVANT:
+		return "IRRELEVANT";
+	case DocumentStatus::BANNED:
+		return "BANNED";
+	case DocumentStatus::REMOVED:
+		return "REMOVED";
+	}
+	return "UNKNOWN";
+}
+
+DocumentRecord ParseDocumentRecord(std::string_view line)
+{
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.remove_suffix(1);
+	}
+	std::string_view fields[3];
+	for (std::string_view& field : fields)
+	{
+		const size_t tab = line.find('\t');
+		if (tab == std::string_view::npos)
+		{
+			throw std::invalid_argument("В строке документа меньше четырёх полей"s);
+		}
+		field = line.substr(0, tab);
+		line.remove_prefix(tab + 1);
+	}
+
+	DocumentRecord record{ ParseInt(fields[0]), ParseDocumentStatus(fields[1]), {}, line };
+	std::string_view ratings = fields[2];
+	while (!ratings.empty())
+	{
+		const size_t space = ratings.find(' ');
+		const std::string_view rating = ratings.substr(0, space);
+		if (!rating.empty())
+		{
+			record.ratings.push_back(ParseInt(rating));
+		}
+		ratings.remove_prefix(space == std::string_view::npos ? ratings.size() : space + 1);
+	}
+	return record;
+}
+
+void ReadDocuments(SearchServer& server, std::istream& input)
+{
+	std::string line;
+	for (size_t line_number = 1; std::getline(input, line); ++line_number)
+	{
+		try
+		{
+			const DocumentRecord record = ParseDocumentRecord(line);
+			server.AddDocument(record.id, record.text, record.status, record.ratings);
+		}
+		catch (const std::invalid_argument& e)
+		{
+			throw std::invalid_argument("Строка "s + std::to_string(line_number) + ": "s + e.what());
+		}
+	}
+}
+
+std::vector<DocumentRecord> ParseDocumentRecords(std::string_view text)
+{
+	return ParseWindow(text, text);
+}
+
+size_t LoadDocuments(SearchServer& server, const std::string& path)
+{
+	return LoadDocumentsImpl(path, [&server](std::string_view text, std::vector<DocumentRecord>& records)
+		{
+			for (const DocumentRecord& record : records)
+			{
+				try
+				{
+					server.AddDocument(record.id, record.text, record.status, record.ratings);
+				}
+				catch (const std::invalid_argument& e)
+				{
+					throw MakeLineError(text, record.text.data(), e);
+				}
+			}
+		});
+}
+
+size_t LoadDocuments(ShardedSearchServer& server, const std::string& path)
+{
+	std::exception_ptr error;
+	const size_t document_count = LoadDocumentsImpl(path, [&server, &error](std::string_view, std::vector<DocumentRecord>& records)
+		{
+			std::vector<ShardedSearchServer::NewDocument> documents;
+			documents.reserve(records.size());
+			for (DocumentRecord& record : records)
+			{
+				documents.push_back({ record.id, record.text, record.status, std::move(record.ratings) });
+			}
+			try
+			{
+				server.AddDocuments(documents);
+			}
+			catch (...)
+			{
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
+		});
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return document_count;
+}
+
+size_t LoadDocuments(DurableSearchServer& server, const std::string& path)
+{
+	uint64_t position = 0;
+	const size_t document_count = LoadDocumentsImpl(path, [&server, &position](std::string_view text, std::vector<DocumentRecord>& records)
+		{
+			for (const DocumentRecord& record : records)
+			{
+				try
+				{
+					position = server.AddDocument(record.id, record.text, record.status, record.ratings);
+				}
+				catch (const std::invalid_argument& e)
+				{
+					throw MakeLineError(text, record.text.data(), e);
+				}
+			}
+		});
+	server.Sync(position);
+	return document_count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "document.h"
+#include "durable_search_server.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Documents files have one document per line: id, status (ACTUAL, IRRELEVANT, BANNED or REMOVED),
+// ratings separated by spaces and the text, all separated by tabs. The text may contain no tabs
+struct DocumentRecord
+{
+	int id;
+	DocumentStatus status;
+	std::vector<int> ratings;
+	// Points into the parsed line
+	std::string_view text;
+};
+
+DocumentStatus ParseDocumentStatus(std::string_view text);
+std::string_view GetDocumentStatusName(DocumentStatus status);
+// Throws std::invalid_argument for a malformed line
+DocumentRecord ParseDocumentRecord(std::string_view line);
+// Parses the lines in parallel chunks, the records point into the text. Errors name the line they were found in
+std::vector<DocumentRecord> ParseDocumentRecords(std::string_view text);
+// Adds every document of the stream, errors name the line they were found in
+void ReadDocuments(SearchServer& server, std::istream& input);
+// Maps the file into memory and adds its documents as ReadDocuments would, a window of lines at a time: the window
+// is parsed in parallel without copying the texts, then indexed. Returns the number of documents added
+size_t LoadDocuments(SearchServer& server, const std::string& path);
+// Same, the shards index every window in parallel. Rejected documents don't stop the others, the first error is
+// rethrown after the whole file is loaded
+size_t LoadDocuments(ShardedSearchServer& server, const std::string& path);
+// Same, the documents are logged and synced once at the end
+size_t LoadDocuments(DurableSearchServer& server, const std::string& path);
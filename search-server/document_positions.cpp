@@ -0,0 +1,41 @@
+#include "document_positions.h"
+#include "varint.h"
+
+DocumentPositions::DocumentPositions(const allocator_type& allocator)
+	: offsets_(allocator)
+	, bytes_(allocator)
+{}
+
+void DocumentPositions::AddTerm(const std::vector<uint32_t>& positions)
+{
+	offsets_.push_back(static_cast<uint32_t>(bytes_.size()));
+	uint32_t previous = 0;
+	for (const uint32_t position : positions)
+	{
+		WriteVarint(bytes_, position - previous);
+		previous = position;
+	}
+}
+
+void DocumentPositions::GetPositions(size_t term_index, std::pmr::vector<uint32_t>& positions) const
+{
+	positions.clear();
+	size_t byte_index = offsets_[term_index];
+	const size_t group_end = term_index + 1 < offsets_.size() ? offsets_[term_index + 1] : bytes_.size();
+	uint32_t position = 0;
+	while (byte_index < group_end)
+	{
+		position += ReadVarint(bytes_.data(), byte_index);
+		positions.push_back(position);
+	}
+}
+
+size_t DocumentPositions::GetTermCount() const
+{
+	return offsets_.size();
+}
+
+bool DocumentPositions::empty() const
+{
+	return offsets_.empty();
+}
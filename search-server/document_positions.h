@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Word positions of one document grouped by term in the order of its forward index. Every group stores the
+// increasing positions of one term as variable-byte encoded deltas, the groups are found through their byte offsets.
+// Positions count all words of the text including stop words, so stop words leave gaps between the positions
+class DocumentPositions
+{
+public:
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	DocumentPositions() = default;
+	explicit DocumentPositions(const allocator_type& allocator);
+
+	// Groups are appended in the order of the terms
+	void AddTerm(const std::vector<uint32_t>& positions);
+	// Decodes the group of the term with the given index in the forward index
+	void GetPositions(size_t term_index, std::pmr::vector<uint32_t>& positions) const;
+
+	size_t GetTermCount() const;
+	bool empty() const;
+
+private:
+	std::pmr::vector<uint32_t> offsets_;
+	std::pmr::vector<uint8_t> bytes_;
+};
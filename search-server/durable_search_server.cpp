@@ -0,0 +1,624 @@
+#include "durable_search_server.h"
+#include "mapped_file.h"
+#include "shard_protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <execution>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	const std::string_view SNAPSHOT_MAGIC = "SRCHSNP1";
+	const std::string_view CHECKPOINT_MAGIC = "SRCHCKP1";
+	// The magic and the sequence number of the last update included
+	const size_t HEADER_SIZE = 16;
+	const std::string_view SNAPSHOT_NAME = "snapshot";
+	const std::string_view CHECKPOINT_PREFIX = "checkpoint.";
+	const std::string_view LOG_PREFIX = "log.";
+	// Files being written get this suffix until they are complete
+	const std::string_view NEW_SUFFIX = ".new";
+	// The snapshot is written in pieces of this size
+	const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+	[[noreturn]] void ThrowSystemError(const std::string& what)
+	{
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	struct LogRecord
+	{
+		ShardMessageType type = ShardMessageType::ADD_DOCUMENT_REQUEST;
+		uint64_t sequence = 0;
+		int document_id = 0;
+		DocumentStatus status = DocumentStatus::ACTUAL;
+		std::vector<int> ratings;
+		// Points into the record
+		std::string_view text;
+	};
+
+	LogRecord DecodeRecord(std::string_view payload)
+	{
+		MessageReader reader(payload);
+		LogRecord record;
+		record.type = reader.GetType();
+		if (record.type != ShardMessageType::ADD_DOCUMENT_REQUEST && record.type != ShardMessageType::REMOVE_DOCUMENT_REQUEST)
+		{
+			throw std::runtime_error("Неизвестный тип записи журнала: "s + std::to_string(static_cast<int>(record.type)));
+		}
+		record.sequence = reader.GetUnsigned();
+		record.document_id = static_cast<int>(reader.GetSigned());
+		if (record.type == ShardMessageType::ADD_DOCUMENT_REQUEST)
+		{
+			record.status = reader.GetStatus();
+			record.ratings = reader.GetRatings();
+			record.text = reader.GetString();
+		}
+		reader.ExpectEnd();
+		return record;
+	}
+
+	// Decodes the records in parallel, the checksums have already been verified
+	std::vector<LogRecord> DecodeRecords(const std::vector<std::string_view>& payloads)
+	{
+		std::vector<LogRecord> records(payloads.size());
+		std::vector<uint8_t> valid(payloads.size());
+		std::transform(std::execution::par, payloads.begin(), payloads.end(), valid.begin(), [&payloads, &records](const std::string_view& payload)
+			{
+				// Exceptions must not leave a parallel algorithm
+				try
+				{
+					records[&payload - payloads.data()] = DecodeRecord(payload);
+					return uint8_t{ 1 };
+				}
+				catch (const std::exception&)
+				{
+					return uint8_t{ 0 };
+				}
+			});
+		const auto invalid = std::find(valid.begin(), valid.end(), 0);
+		if (invalid != valid.end())
+		{
+			// Repeated to get the message
+			DecodeRecord(payloads[invalid - valid.begin()]);
+		}
+		return records;
+	}
+
+	uint64_t GetUint64(const char* data)
+	{
+		uint64_t value = 0;
+		for (int index = 7; index >= 0; --index)
+		{
+			value = (value << 8) | static_cast<uint8_t>(data[index]);
+		}
+		return value;
+	}
+
+	void PutUint64(std::string& data, uint64_t value)
+	{
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			data.push_back(static_cast<char>((value >> shift) & 0xFF));
+		}
+	}
+
+	bool FileExists(const std::string& path)
+	{
+		struct stat file_status{};
+		return ::stat(path.c_str(), &file_status) == 0;
+	}
+
+	// Makes the creation and renaming of the files in the directory durable
+	void SyncDirectory(const std::string& directory)
+	{
+		const int descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (descriptor < 0)
+		{
+			ThrowSystemError("open "s + directory);
+		}
+		const int result = ::fsync(descriptor);
+		const int error = errno;
+		::close(descriptor);
+		if (result != 0)
+		{
+			throw std::system_error(error, std::generic_category(), "fsync "s + directory);
+		}
+	}
+
+	class FileWriter
+	{
+	public:
+		explicit FileWriter(const std::string& path)
+			: path_(path)
+			, descriptor_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+		{
+			if (descriptor_ < 0)
+			{
+				ThrowSystemError("open "s + path);
+			}
+		}
+
+		~FileWriter()
+		{
+			::close(descriptor_);
+		}
+
+		std::string& GetBuffer()
+		{
+			if (buffer_.size() >= WRITE_BUFFER_SIZE)
+			{
+				Flush();
+			}
+			return buffer_;
+		}
+
+		void Sync()
+		{
+			Flush();
+			if (::fsync(descriptor_) != 0)
+			{
+				ThrowSystemError("fsync "s + path_);
+			}
+		}
+
+	private:
+		std::string path_;
+		int descriptor_;
+		std::string buffer_;
+
+		void Flush()
+		{
+			size_t written = 0;
+			while (written < buffer_.size())
+			{
+				const ssize_t result = ::write(descriptor_, buffer_.data() + written, buffer_.size() - written);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					ThrowSystemError("write "s + path_);
+				}
+				written += static_cast<size_t>(result);
+			}
+			buffer_.clear();
+		}
+	};
+
+	// Logs and checkpoints are numbered by the first sequence number the log may hold. The number is padded,
+	// so that the names sort in the order of the numbers
+	std::string MakeFileName(std::string_view prefix, uint64_t number)
+	{
+		std::string digits = std::to_string(number);
+		return std::string(prefix) + std::string(20 - digits.size(), '0') + digits;
+	}
+
+	// The numbered files with the prefix, in the order of the numbers
+	std::vector<std::pair<uint64_t, std::string>> ListFiles(const std::string& directory, std::string_view prefix)
+	{
+		std::vector<std::pair<uint64_t, std::string>> files;
+		for (const auto& entry : std::filesystem::directory_iterator(directory))
+		{
+			const std::string name = entry.path().filename().string();
+			if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0)
+			{
+				continue;
+			}
+			uint64_t number = 0;
+			const auto [end, error] = std::from_chars(name.data() + prefix.size(), name.data() + name.size(), number);
+			if (error == std::errc() && end == name.data() + name.size())
+			{
+				files.emplace_back(number, entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	// The records of a snapshot or a checkpoint, which are renamed into place complete: damage is not a crash to recover from
+	std::vector<std::string_view> ReadRecordFile(const MappedFile& file, std::string_view magic, const std::string& path, uint64_t& sequence)
+	{
+		const std::string_view data = file.GetData();
+		if (data.size() < HEADER_SIZE || data.substr(0, magic.size()) != magic)
+		{
+			throw std::runtime_error("Файл "s + path + " не является файлом поискового сервера нужного типа"s);
+		}
+		sequence = GetUint64(data.data() + magic.size());
+		size_t valid_size = 0;
+		std::vector<std::string_view> payloads = WriteAheadLog::ReadFrames(data.substr(HEADER_SIZE), valid_size);
+		if (HEADER_SIZE + valid_size != data.size())
+		{
+			throw std::runtime_error("Файл "s + path + " повреждён"s);
+		}
+		return payloads;
+	}
+
+	// Writes the file under a temporary name and renames it into place once it is durable
+	void WriteRecordFile(const std::string& directory, const std::string& path, std::string_view magic, uint64_t sequence, const std::vector<std::string_view>& payloads)
+	{
+		const std::string new_path = path + std::string(NEW_SUFFIX);
+		{
+			FileWriter writer(new_path);
+			std::string& header = writer.GetBuffer();
+			header.append(magic);
+			PutUint64(header, sequence);
+			for (const std::string_view payload : payloads)
+			{
+				WriteAheadLog::AppendFrame(writer.GetBuffer(), payload);
+			}
+			writer.Sync();
+		}
+		if (::rename(new_path.c_str(), path.c_str()) != 0)
+		{
+			ThrowSystemError("rename "s + new_path);
+		}
+		SyncDirectory(directory);
+	}
+
+	void RemoveFile(const std::string& path)
+	{
+		if (::unlink(path.c_str()) != 0 && errno != ENOENT)
+		{
+			ThrowSystemError("unlink "s + path);
+		}
+	}
+}
+
+DurableSearchServer::DurableSearchServer(SearchServer& server, const std::string& directory)
+	: DurableSearchServer(server, directory, Options())
+{}
+
+DurableSearchServer::DurableSearchServer(SearchServer& server, const std::string& directory, Options options)
+	: server_(server)
+	, directory_(directory)
+	, options_(options)
+{
+	if (::mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		ThrowSystemError("mkdir "s + directory_);
+	}
+	for (const auto& entry : std::filesystem::directory_iterator(directory_))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.size() > NEW_SUFFIX.size() && name.compare(name.size() - NEW_SUFFIX.size(), NEW_SUFFIX.size(), NEW_SUFFIX) == 0)
+		{
+			// Left by a crash while it was written
+			RemoveFile(entry.path().string());
+		}
+	}
+
+	const std::string snapshot_path = directory_ + "/"s + std::string(SNAPSHOT_NAME);
+	uint64_t applied_sequence = 0;
+	if (FileExists(snapshot_path))
+	{
+		const MappedFile snapshot(snapshot_path);
+		const std::vector<std::string_view> payloads = ReadRecordFile(snapshot, SNAPSHOT_MAGIC, snapshot_path, applied_sequence);
+		Replay(payloads, 0);
+	}
+	for (const auto& [number, path] : ListFiles(directory_, CHECKPOINT_PREFIX))
+	{
+		const MappedFile checkpoint(path);
+		uint64_t checkpoint_sequence = 0;
+		const std::vector<std::string_view> payloads = ReadRecordFile(checkpoint, CHECKPOINT_MAGIC, path, checkpoint_sequence);
+		if (checkpoint_sequence <= applied_sequence)
+		{
+			// Merged into the snapshot by a merge that crashed before removing it
+			RemoveFile(path);
+			continue;
+		}
+		Replay(payloads, applied_sequence);
+		applied_sequence = checkpoint_sequence;
+	}
+
+	const std::vector<std::pair<uint64_t, std::string>> logs = ListFiles(directory_, LOG_PREFIX);
+	size_t log_size = 0;
+	for (size_t index = 0; index < logs.size(); ++index)
+	{
+		const MappedFile log(logs[index].second);
+		applied_sequence = Replay(WriteAheadLog::ReadFrames(log.GetData(), log_size), applied_sequence);
+		if (index + 1 < logs.size())
+		{
+			// A log whose checkpoint was made is skipped by its sequence numbers
+			if (FileExists(directory_ + "/"s + MakeFileName(CHECKPOINT_PREFIX, logs[index].first)))
+			{
+				RemoveFile(logs[index].second);
+			}
+			else
+			{
+				sealed_logs_.push_back(logs[index].second);
+			}
+		}
+	}
+	last_sequence_ = applied_sequence;
+
+	log_path_ = logs.empty() ? directory_ + "/"s + MakeFileName(LOG_PREFIX, last_sequence_ + 1) : logs.back().second;
+	log_ = std::make_unique<WriteAheadLog>(log_path_, logs.empty() ? 0 : log_size);
+	SyncDirectory(directory_);
+	checkpoint_thread_ = std::thread([this]()
+		{
+			RunCheckpoints();
+		});
+}
+
+DurableSearchServer::~DurableSearchServer()
+{
+	{
+		std::lock_guard guard(checkpoint_mutex_);
+		stopping_ = true;
+	}
+	checkpoint_condition_.notify_all();
+	checkpoint_thread_.join();
+}
+
+SearchServer& DurableSearchServer::GetServer()
+{
+	return server_;
+}
+
+const SearchServer& DurableSearchServer::GetServer() const
+{
+	return server_;
+}
+
+uint64_t DurableSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings)
+{
+	server_.AddDocument(document_id, document, status, ratings);
+	MessageWriter record(ShardMessageType::ADD_DOCUMENT_REQUEST);
+	record.PutUnsigned(++last_sequence_).PutSigned(document_id).PutStatus(status).PutUnsigned(ratings.size());
+	for (const int rating : ratings)
+	{
+		record.PutSigned(rating);
+	}
+	record.PutString(document);
+	const uint64_t position = log_->Write(record.GetData());
+	if (options_.checkpoint_log_size > 0 && position - log_file_position_ >= options_.checkpoint_log_size)
+	{
+		SealLog();
+	}
+	return position;
+}
+
+uint64_t DurableSearchServer::RemoveDocument(int document_id)
+{
+	server_.RemoveDocument(document_id);
+	const uint64_t position = log_->Write(MessageWriter(ShardMessageType::REMOVE_DOCUMENT_REQUEST).PutUnsigned(++last_sequence_).PutSigned(document_id).GetData());
+	if (options_.checkpoint_log_size > 0 && position - log_file_position_ >= options_.checkpoint_log_size)
+	{
+		SealLog();
+	}
+	return position;
+}
+
+void DurableSearchServer::Sync(uint64_t position)
+{
+	log_->Sync(position);
+}
+
+void DurableSearchServer::Checkpoint()
+{
+	{
+		std::lock_guard guard(checkpoint_mutex_);
+		if (checkpoint_error_)
+		{
+			std::rethrow_exception(std::exchange(checkpoint_error_, nullptr));
+		}
+	}
+	if (log_->GetPosition() > log_file_position_)
+	{
+		SealLog();
+	}
+}
+
+void DurableSearchServer::WaitForCheckpoints()
+{
+	std::unique_lock lock(checkpoint_mutex_);
+	checkpoint_condition_.wait(lock, [this]()
+		{
+			return sealed_logs_.empty() && !checkpointing_;
+		});
+	if (checkpoint_error_)
+	{
+		std::rethrow_exception(std::exchange(checkpoint_error_, nullptr));
+	}
+}
+
+uint64_t DurableSearchServer::Replay(const std::vector<std::string_view>& payloads, uint64_t applied_sequence)
+{
+	uint64_t last_sequence = applied_sequence;
+	for (const LogRecord& record : DecodeRecords(payloads))
+	{
+		if (record.sequence <= applied_sequence)
+		{
+			continue;
+		}
+		if (record.type == ShardMessageType::ADD_DOCUMENT_REQUEST)
+		{
+			server_.AddDocument(record.document_id, record.text, record.status, record.ratings);
+		}
+		else
+		{
+			server_.RemoveDocument(record.document_id);
+		}
+		last_sequence = std::max(last_sequence, record.sequence);
+	}
+	return last_sequence;
+}
+
+void DurableSearchServer::SealLog()
+{
+	std::string sealed_path = std::exchange(log_path_, directory_ + "/"s + MakeFileName(LOG_PREFIX, last_sequence_ + 1));
+	log_->Rotate(log_path_);
+	SyncDirectory(directory_);
+	log_file_position_ = log_->GetPosition();
+	{
+		std::lock_guard guard(checkpoint_mutex_);
+		sealed_logs_.push_back(std::move(sealed_path));
+	}
+	checkpoint_condition_.notify_all();
+}
+
+void DurableSearchServer::RunCheckpoints()
+{
+	while (true)
+	{
+		std::string log_path;
+		{
+			std::unique_lock lock(checkpoint_mutex_);
+			checkpoint_condition_.wait(lock, [this]()
+				{
+					return stopping_ || !sealed_logs_.empty();
+				});
+			if (stopping_)
+			{
+				return;
+			}
+			log_path = sealed_logs_.front();
+			checkpointing_ = true;
+		}
+
+		std::exception_ptr error;
+		try
+		{
+			MakeCheckpoint(log_path);
+			MergeCheckpoints();
+		}
+		catch (...)
+		{
+			// The sealed log stays, the next recovery replays it
+			error = std::current_exception();
+		}
+
+		{
+			std::lock_guard guard(checkpoint_mutex_);
+			sealed_logs_.pop_front();
+			checkpointing_ = false;
+			if (error && !checkpoint_error_)
+			{
+				checkpoint_error_ = error;
+			}
+		}
+		checkpoint_condition_.notify_all();
+	}
+}
+
+void DurableSearchServer::MakeCheckpoint(const std::string& log_path)
+{
+	const MappedFile log(log_path);
+	size_t valid_size = 0;
+	const std::vector<std::string_view> payloads = WriteAheadLog::ReadFrames(log.GetData(), valid_size);
+	const std::vector<LogRecord> records = DecodeRecords(payloads);
+
+	// The last removal and the last version of every document the log changed
+	std::map<int, std::pair<std::string_view, std::string_view>> changes;
+	uint64_t last_sequence = 0;
+	for (size_t index = 0; index < records.size(); ++index)
+	{
+		auto& [removal, version] = changes[records[index].document_id];
+		if (records[index].type == ShardMessageType::ADD_DOCUMENT_REQUEST)
+		{
+			version = payloads[index];
+		}
+		else
+		{
+			removal = payloads[index];
+			version = {};
+		}
+		last_sequence = std::max(last_sequence, records[index].sequence);
+	}
+
+	if (!records.empty())
+	{
+		// All removals go before all versions: the versions then describe documents that existed together at the end
+		// of the log, so replaying them can't hit a duplicate that an interleaved order would bring back
+		std::vector<std::string_view> checkpoint_payloads;
+		for (const bool removals : { true, false })
+		{
+			for (const auto& [document_id, change] : changes)
+			{
+				const std::string_view payload = removals ? change.first : change.second;
+				if (!payload.empty())
+				{
+					checkpoint_payloads.push_back(payload);
+				}
+			}
+		}
+		const std::string name = std::filesystem::path(log_path).filename().string();
+		const std::string checkpoint_path = directory_ + "/"s + std::string(CHECKPOINT_PREFIX) + name.substr(LOG_PREFIX.size());
+		WriteRecordFile(directory_, checkpoint_path, CHECKPOINT_MAGIC, last_sequence, checkpoint_payloads);
+	}
+	RemoveFile(log_path);
+	SyncDirectory(directory_);
+}
+
+void DurableSearchServer::MergeCheckpoints()
+{
+	const std::string snapshot_path = directory_ + "/"s + std::string(SNAPSHOT_NAME);
+	const std::vector<std::pair<uint64_t, std::string>> checkpoints = ListFiles(directory_, CHECKPOINT_PREFIX);
+	uint64_t checkpoints_size = 0;
+	for (const auto& [number, path] : checkpoints)
+	{
+		checkpoints_size += std::filesystem::file_size(path);
+	}
+	const uint64_t snapshot_size = FileExists(snapshot_path) ? std::filesystem::file_size(snapshot_path) : 0;
+	if (checkpoints.empty() || static_cast<double>(checkpoints_size) < options_.merge_ratio * static_cast<double>(snapshot_size))
+	{
+		return;
+	}
+
+	// The records adding the documents, pointing into the mapped files
+	std::map<int, std::string_view> documents;
+	std::vector<MappedFile> files;
+	uint64_t sequence = 0;
+	if (snapshot_size > 0)
+	{
+		files.emplace_back(snapshot_path);
+		for (const std::string_view payload : ReadRecordFile(files.back(), SNAPSHOT_MAGIC, snapshot_path, sequence))
+		{
+			documents[DecodeRecord(payload).document_id] = payload;
+		}
+	}
+	for (const auto& [number, path] : checkpoints)
+	{
+		files.emplace_back(path);
+		const std::vector<std::string_view> payloads = ReadRecordFile(files.back(), CHECKPOINT_MAGIC, path, sequence);
+		const std::vector<LogRecord> records = DecodeRecords(payloads);
+		for (size_t index = 0; index < records.size(); ++index)
+		{
+			if (records[index].type == ShardMessageType::ADD_DOCUMENT_REQUEST)
+			{
+				documents[records[index].document_id] = payloads[index];
+			}
+			else
+			{
+				documents.erase(records[index].document_id);
+			}
+		}
+	}
+
+	std::vector<std::string_view> payloads;
+	payloads.reserve(documents.size());
+	for (const auto& [document_id, payload] : documents)
+	{
+		payloads.push_back(payload);
+	}
+	WriteRecordFile(directory_, snapshot_path, SNAPSHOT_MAGIC, sequence, payloads);
+	// A crash before the checkpoints are removed leaves them behind the snapshot, recovery skips them by their sequence numbers
+	for (const auto& [number, path] : checkpoints)
+	{
+		RemoveFile(path);
+	}
+	SyncDirectory(directory_);
+}
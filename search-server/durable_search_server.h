@@ -0,0 +1,98 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Keeps the documents of a SearchServer in a directory: a snapshot, incremental checkpoints made after it and
+// write-ahead logs of the updates made after those. Log records are shard protocol messages (see shard_protocol.h)
+// with a sequence number after the type:
+//
+//     ADD_DOCUMENT_REQUEST     sequence, id, status, ratings, text
+//     REMOVE_DOCUMENT_REQUEST  sequence, id
+//
+// The snapshot and the checkpoints start with the sequence number of the last update they include, followed by
+// records in the frames of WriteAheadLog. The snapshot adds its documents. A checkpoint is made from one sealed
+// log and holds, for every document the log changed, its removal if the log removed it and its last version.
+//
+// Checkpoints only read files that no longer change, so a background thread makes them while the server is
+// searched and updated: sealing a log costs one fsync, the thread turns it into a checkpoint and merges the
+// checkpoints into a new snapshot once they grow large next to it.
+//
+// An update is applied to the server first and logged only if the server accepted it, so replaying the log
+// repeats exactly the accepted updates
+class DurableSearchServer
+{
+public:
+	struct Options
+	{
+		// The log is sealed once it grows this large, zero leaves sealing to Checkpoint
+		uint64_t checkpoint_log_size = 64 << 20;
+		// The checkpoints are merged into the snapshot once their size reaches this share of its size
+		double merge_ratio = 0.5;
+	};
+
+	// Recovers the server, which must be empty and configured as before (stop words, duplicate mode, positional index):
+	// adds the documents of the snapshot, then applies the checkpoints and replays the logs. The records are
+	// decoded and verified in parallel, a log cut off by a crash is replayed up to its last complete record
+	DurableSearchServer(SearchServer& server, const std::string& directory);
+	DurableSearchServer(SearchServer& server, const std::string& directory, Options options);
+	DurableSearchServer(const DurableSearchServer&) = delete;
+	DurableSearchServer& operator=(const DurableSearchServer&) = delete;
+	// Finishes the checkpoint in progress, sealed logs left over are replayed and checkpointed by the next recovery
+	~DurableSearchServer();
+
+	SearchServer& GetServer();
+	const SearchServer& GetServer() const;
+
+	// Update the server and log the update, return the position to wait for with Sync. The caller keeps
+	// readers and other updates of the server out as for SearchServer itself, but not while waiting in Sync,
+	// which lets concurrent updates share one fsync
+	uint64_t AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+	uint64_t RemoveDocument(int document_id);
+	// Returns once the updates up to the position are durable
+	void Sync(uint64_t position);
+
+	// Seals the log and returns, the background thread makes a checkpoint of it. Must not run concurrently with updates
+	void Checkpoint();
+	// Waits for the checkpoints of the logs sealed so far and rethrows the error of a failed one
+	void WaitForCheckpoints();
+
+private:
+	SearchServer& server_;
+	std::string directory_;
+	const Options options_;
+	uint64_t last_sequence_ = 0;
+	std::unique_ptr<WriteAheadLog> log_;
+	std::string log_path_;
+	// The log position the current log file starts at
+	uint64_t log_file_position_ = 0;
+
+	std::mutex checkpoint_mutex_;
+	std::condition_variable checkpoint_condition_;
+	// Sealed log files waiting for their checkpoint, the first one is in progress while checkpointing_ is set
+	std::deque<std::string> sealed_logs_;
+	bool checkpointing_ = false;
+	bool stopping_ = false;
+	std::exception_ptr checkpoint_error_;
+	// Started last, stopped first
+	std::thread checkpoint_thread_;
+
+	// Skips the records up to the sequence number, returns the last sequence number applied
+	uint64_t Replay(const std::vector<std::string_view>& payloads, uint64_t applied_sequence);
+	void SealLog();
+	void RunCheckpoints();
+	void MakeCheckpoint(const std::string& log_path);
+	void MergeCheckpoints();
+};
@@ -0,0 +1,134 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+Histogram::Histogram()
+	: counts_(BUCKET_COUNT, 0)
+{}
+
+void Histogram::Add(uint64_t value, uint64_t count)
+{
+	counts_[GetBucketIndex(value)] += count;
+	total_count_ += count;
+}
+
+void Histogram::Merge(const Histogram& other)
+{
+	for (size_t index = 0; index < BUCKET_COUNT; ++index)
+	{
+		counts_[index] += other.counts_[index];
+	}
+	total_count_ += other.total_count_;
+}
+
+void Histogram::Clear()
+{
+	std::fill(counts_.begin(), counts_.end(), 0);
+	total_count_ = 0;
+}
+
+uint64_t Histogram::GetCount() const
+{
+	return total_count_;
+}
+
+uint64_t Histogram::GetBucketCount(size_t index) const
+{
+	return counts_.at(index);
+}
+
+uint64_t Histogram::GetValueAtPercentile(double percentile) const
+{
+	if (total_count_ == 0)
+	{
+		return 0;
+	}
+
+	const double clamped = std::clamp(percentile, 0.0, 100.0);
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * total_count_)));
+	uint64_t seen = 0;
+	for (size_t index = 0; index < BUCKET_COUNT; ++index)
+	{
+		seen += counts_[index];
+		if (seen >= rank)
+		{
+			return GetBucketUpperBound(index);
+		}
+	}
+	return GetBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+size_t Histogram::GetBucketIndex(uint64_t value)
+{
+	const uint64_t sub_bucket_count = uint64_t{ 1 } << SUB_BUCKET_BITS;
+	if (value < sub_bucket_count)
+	{
+		return static_cast<size_t>(value);
+	}
+
+	int exponent = 63;
+	while ((value >> exponent) == 0)
+	{
+		--exponent;
+	}
+	if (exponent >= MAX_VALUE_BITS)
+	{
+		return BUCKET_COUNT - 1;
+	}
+
+	const int shift = exponent - SUB_BUCKET_BITS;
+	const size_t group = static_cast<size_t>(shift + 1);
+	const size_t sub_bucket = static_cast<size_t>((value >> shift) & (sub_bucket_count - 1));
+	return (group << SUB_BUCKET_BITS) + sub_bucket;
+}
+
+uint64_t Histogram::GetBucketUpperBound(size_t index)
+{
+	const size_t group = index >> SUB_BUCKET_BITS;
+	const uint64_t sub_bucket = index & ((size_t{ 1 } << SUB_BUCKET_BITS) - 1);
+	if (group == 0)
+	{
+		return sub_bucket;
+	}
+
+	const int shift = static_cast<int>(group) - 1;
+	const uint64_t lower_bound = (sub_bucket + (uint64_t{ 1 } << SUB_BUCKET_BITS)) << shift;
+	return lower_bound + (uint64_t{ 1 } << shift) - 1;
+}
+
+AtomicHistogram::AtomicHistogram()
+{
+	Clear();
+}
+
+void AtomicHistogram::Add(uint64_t value)
+{
+	counts_[Histogram::GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void AtomicHistogram::AddFromOwner(uint64_t value)
+{
+	auto& count = counts_[Histogram::GetBucketIndex(value)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void AtomicHistogram::Clear()
+{
+	for (auto& count : counts_)
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+}
+
+void AtomicHistogram::AddTo(Histogram& histogram) const
+{
+	for (size_t index = 0; index < Histogram::BUCKET_COUNT; ++index)
+	{
+		const uint64_t count = counts_[index].load(std::memory_order_relaxed);
+		if (count > 0)
+		{
+			histogram.Add(Histogram::GetBucketUpperBound(index), count);
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts of non-negative values in logarithmic buckets: every power of two is split into
+// 2^SUB_BUCKET_BITS linear sub-buckets, so a value is reported with a relative error below 1/16.
+// Values of MAX_VALUE_BITS bits and more fall into the last bucket
+class Histogram
+{
+public:
+	static constexpr int SUB_BUCKET_BITS = 4;
+	static constexpr int MAX_VALUE_BITS = 40;
+	static constexpr size_t BUCKET_COUNT = static_cast<size_t>(MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+	Histogram();
+
+	void Add(uint64_t value, uint64_t count = 1);
+	void Merge(const Histogram& other);
+	void Clear();
+
+	uint64_t GetCount() const;
+	uint64_t GetBucketCount(size_t index) const;
+	// The largest value of the bucket holding the given percentile (0..100), zero for an empty histogram
+	uint64_t GetValueAtPercentile(double percentile) const;
+
+	static size_t GetBucketIndex(uint64_t value);
+	static uint64_t GetBucketUpperBound(size_t index);
+
+private:
+	std::vector<uint64_t> counts_;
+	uint64_t total_count_ = 0;
+};
+
+// Histogram that several threads may add to at once, every Add is one relaxed atomic increment
+class AtomicHistogram
+{
+public:
+	AtomicHistogram();
+
+	void Add(uint64_t value);
+	// Plain load and store instead of a locked increment, for histograms written by a single thread
+	void AddFromOwner(uint64_t value);
+	// Not atomic with respect to concurrent Add calls
+	void Clear();
+	void AddTo(Histogram& histogram) const;
+
+private:
+	std::array<std::atomic<uint64_t>, Histogram::BUCKET_COUNT> counts_;
+};
@@ -0,0 +1,211 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	struct ThreadProbes
+	{
+		// Histograms are created by the owning thread on first use and published with a release store
+		std::array<std::atomic<AtomicHistogram*>, Instrumentation::MAX_PROBES> timers;
+		std::array<std::atomic<uint64_t>, Instrumentation::MAX_PROBES> counters;
+
+		ThreadProbes()
+		{
+			for (size_t id = 0; id < Instrumentation::MAX_PROBES; ++id)
+			{
+				timers[id].store(nullptr, std::memory_order_relaxed);
+				counters[id].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		~ThreadProbes()
+		{
+			for (auto& timer : timers)
+			{
+				delete timer.load(std::memory_order_relaxed);
+			}
+		}
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::string> timer_names;
+		std::vector<std::string> counter_names;
+		std::vector<const ThreadProbes*> threads;
+		// What the threads that have already exited recorded
+		std::map<size_t, Histogram> retired_timers;
+		std::array<uint64_t, Instrumentation::MAX_PROBES> retired_counters{};
+	};
+
+	// Never destroyed, so that threads finishing during static destruction can still retire their probes
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry;
+		return *registry;
+	}
+
+	void MergeInto(const ThreadProbes& probes, std::map<size_t, Histogram>& timers, std::array<uint64_t, Instrumentation::MAX_PROBES>& counters)
+	{
+		for (size_t id = 0; id < Instrumentation::MAX_PROBES; ++id)
+		{
+			const AtomicHistogram* timer = probes.timers[id].load(std::memory_order_acquire);
+			if (timer != nullptr)
+			{
+				timer->AddTo(timers[id]);
+			}
+			counters[id] += probes.counters[id].load(std::memory_order_relaxed);
+		}
+	}
+
+	class ThreadProbesHolder
+	{
+	public:
+		ThreadProbesHolder()
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard guard(registry.mutex);
+			registry.threads.push_back(&probes);
+		}
+
+		~ThreadProbesHolder()
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard guard(registry.mutex);
+			MergeInto(probes, registry.retired_timers, registry.retired_counters);
+			registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &probes));
+		}
+
+		ThreadProbes probes;
+	};
+
+	ThreadProbes& GetThreadProbes()
+	{
+		thread_local ThreadProbesHolder holder;
+		return holder.probes;
+	}
+
+	size_t Register(std::vector<std::string>& names, std::string_view name)
+	{
+		const auto found = std::find(names.begin(), names.end(), name);
+		if (found != names.end())
+		{
+			return found - names.begin();
+		}
+		if (names.size() == Instrumentation::MAX_PROBES)
+		{
+			return Instrumentation::MAX_PROBES - 1;
+		}
+		names.emplace_back(name);
+		return names.size() - 1;
+	}
+}
+
+size_t Instrumentation::RegisterTimer(std::string_view name)
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	return Register(registry.timer_names, name);
+}
+
+size_t Instrumentation::RegisterCounter(std::string_view name)
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	return Register(registry.counter_names, name);
+}
+
+void Instrumentation::RecordTime(size_t timer_id, uint64_t nanoseconds)
+{
+	auto& slot = GetThreadProbes().timers[timer_id];
+	AtomicHistogram* timer = slot.load(std::memory_order_relaxed);
+	if (timer == nullptr)
+	{
+		timer = new AtomicHistogram;
+		slot.store(timer, std::memory_order_release);
+	}
+	timer->AddFromOwner(nanoseconds);
+}
+
+void Instrumentation::AddToCounter(size_t counter_id, uint64_t value)
+{
+	auto& counter = GetThreadProbes().counters[counter_id];
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+Instrumentation::Snapshot Instrumentation::TakeSnapshot()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+
+	std::map<size_t, Histogram> timers = registry.retired_timers;
+	std::array<uint64_t, MAX_PROBES> counters = registry.retired_counters;
+	for (const ThreadProbes* probes : registry.threads)
+	{
+		MergeInto(*probes, timers, counters);
+	}
+
+	Snapshot snapshot;
+	for (auto& [id, histogram] : timers)
+	{
+		if (id < registry.timer_names.size())
+		{
+			snapshot.timers[registry.timer_names[id]].Merge(histogram);
+		}
+	}
+	for (size_t id = 0; id < registry.counter_names.size(); ++id)
+	{
+		snapshot.counters[registry.counter_names[id]] += counters[id];
+	}
+	return snapshot;
+}
+
+void Instrumentation::Dump(std::ostream& output)
+{
+	Dump(output, TakeSnapshot());
+}
+
+void Instrumentation::Dump(std::ostream& output, const Snapshot& snapshot)
+{
+	for (const auto& [name, histogram] : snapshot.timers)
+	{
+		output << name << ": count="s << histogram.GetCount()
+			<< " p50="s << histogram.GetValueAtPercentile(50.0)
+			<< " p95="s << histogram.GetValueAtPercentile(95.0)
+			<< " p99="s << histogram.GetValueAtPercentile(99.0) << " ns\n"s;
+	}
+	for (const auto& [name, value] : snapshot.counters)
+	{
+		output << name << ": "s << value << '\n';
+	}
+	output.flush();
+}
+
+PeriodicDump::PeriodicDump(std::ostream& output, std::chrono::milliseconds period)
+	: output_(output)
+	, period_(period)
+	, thread_([this]()
+		{
+			std::unique_lock lock(mutex_);
+			while (!stop_condition_.wait_for(lock, period_, [this]() { return stopped_; }))
+			{
+				Instrumentation::Dump(output_);
+			}
+		})
+{}
+
+PeriodicDump::~PeriodicDump()
+{
+	{
+		std::lock_guard guard(mutex_);
+		stopped_ = true;
+	}
+	stop_condition_.notify_one();
+	thread_.join();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Named timers and counters for hot paths. Every thread records into its own histograms and counters,
+// so a probe costs a clock read and a few uncontended stores; a snapshot merges the data of all threads.
+// Probes are placed with the PROFILE_SCOPE and PROFILE_COUNT macros from log_duration.h, which expand
+// to nothing unless SEARCH_SERVER_INSTRUMENTATION is defined
+class Instrumentation
+{
+public:
+	struct Snapshot
+	{
+		// Durations in nanoseconds
+		std::map<std::string, Histogram> timers;
+		std::map<std::string, uint64_t> counters;
+	};
+
+	// At most MAX_PROBES timers and as many counters, further registrations share the last id
+	static constexpr size_t MAX_PROBES = 64;
+
+	// Returns the same id for the same name
+	static size_t RegisterTimer(std::string_view name);
+	static size_t RegisterCounter(std::string_view name);
+
+	static void RecordTime(size_t timer_id, uint64_t nanoseconds);
+	static void AddToCounter(size_t counter_id, uint64_t value);
+
+	static Snapshot TakeSnapshot();
+	// One line per probe: timers with count and p50/p95/p99 in nanoseconds, counters with their value
+	static void Dump(std::ostream& output);
+	static void Dump(std::ostream& output, const Snapshot& snapshot);
+};
+
+// Records the lifetime of the scope into a timer
+class ScopedTimer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit ScopedTimer(size_t timer_id)
+		: timer_id_(timer_id)
+	{}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	~ScopedTimer()
+	{
+		const auto duration = Clock::now() - start_time_;
+		Instrumentation::RecordTime(timer_id_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+	}
+
+private:
+	const size_t timer_id_;
+	const Clock::time_point start_time_ = Clock::now();
+};
+
+// Dumps a snapshot to the stream every period until destroyed
+class PeriodicDump
+{
+public:
+	PeriodicDump(std::ostream& output, std::chrono::milliseconds period);
+	~PeriodicDump();
+
+	PeriodicDump(const PeriodicDump&) = delete;
+	PeriodicDump& operator=(const PeriodicDump&) = delete;
+
+private:
+	std::ostream& output_;
+	const std::chrono::milliseconds period_;
+	std::mutex mutex_;
+	std::condition_variable stop_condition_;
+	bool stopped_ = false;
+	std::thread thread_;
+};
@@ -8,6 +8,24 @@
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 
+// Hot path probes: PROFILE_SCOPE(name) times the rest of the scope, PROFILE_COUNT(name, value) adds to a counter.
+// Without SEARCH_SERVER_INSTRUMENTATION they expand to nothing and their arguments are not evaluated
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+#include "instrumentation.h"
+
+#define PROFILE_SCOPE(name) \
+    static const size_t PROFILE_CONCAT(profileTimerId, __LINE__) = Instrumentation::RegisterTimer(name); \
+    const ScopedTimer UNIQUE_VAR_NAME_PROFILE(PROFILE_CONCAT(profileTimerId, __LINE__))
+#define PROFILE_COUNT(name, value) \
+    do { \
+        static const size_t profileCounterId = Instrumentation::RegisterCounter(name); \
+        Instrumentation::AddToCounter(profileCounterId, (value)); \
+    } while (false)
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#define PROFILE_COUNT(name, value) static_cast<void>(0)
+#endif
+
 class LogDuration {
 public:
     using Clock = std::chrono::steady_clock;
@@ -0,0 +1,79 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "open "s + path);
+	}
+	struct stat file_status{};
+	if (::fstat(descriptor, &file_status) != 0)
+	{
+		const int error = errno;
+		::close(descriptor);
+		throw std::system_error(error, std::generic_category(), "fstat "s + path);
+	}
+	// mmap refuses an empty mapping
+	if (file_status.st_size > 0)
+	{
+		void* const data = ::mmap(nullptr, static_cast<size_t>(file_status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (data == MAP_FAILED)
+		{
+			const int error = errno;
+			::close(descriptor);
+			throw std::system_error(error, std::generic_category(), "mmap "s + path);
+		}
+		data_ = data;
+		size_ = static_cast<size_t>(file_status.st_size);
+		::madvise(data_, size_, MADV_SEQUENTIAL);
+	}
+	::close(descriptor);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data_(std::exchange(other.data_, nullptr))
+	, size_(std::exchange(other.size_, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Unmap();
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+std::string_view MappedFile::GetData() const
+{
+	return { static_cast<const char*>(data_), size_ };
+}
+
+void MappedFile::Unmap()
+{
+	if (data_ != nullptr)
+	{
+		::munmap(data_, size_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
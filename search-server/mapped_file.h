@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file, advised for a sequential read. The file may be closed or
+// replaced while mapped. Errors of the system calls are thrown as std::system_error
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path);
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	// Empty for an empty file, valid while the mapping lives
+	std::string_view GetData() const;
+
+private:
+	void* data_ = nullptr;
+	size_t size_ = 0;
+
+	void Unmap();
+};
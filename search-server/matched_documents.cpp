@@ -0,0 +1,32 @@
+#include "matched_documents.h"
+
+MatchedDocuments::MatchedDocuments(std::vector<Entry> entries, std::vector<std::string_view> words)
+	: entries_(std::move(entries))
+	, words_(std::move(words))
+{}
+
+size_t MatchedDocuments::size() const
+{
+	return entries_.size();
+}
+
+bool MatchedDocuments::empty() const
+{
+	return entries_.empty();
+}
+
+int MatchedDocuments::GetDocumentId(size_t index) const
+{
+	return entries_.at(index).document_id;
+}
+
+DocumentStatus MatchedDocuments::GetStatus(size_t index) const
+{
+	return entries_.at(index).status;
+}
+
+MatchedDocuments::WordRange MatchedDocuments::GetWords(size_t index) const
+{
+	const Entry& entry = entries_.at(index);
+	return WordRange(words_.begin() + entry.words_begin, words_.begin() + entry.words_end);
+}
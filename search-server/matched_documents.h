@@ -0,0 +1,37 @@
+#pragma once
+
+#include "document.h"
+#include "paginator.h"
+
+#include <string_view>
+#include <vector>
+
+// Results of matching one query against many documents. The matched words of all
+// documents are stored back to back in a single buffer instead of a vector per document
+class MatchedDocuments
+{
+public:
+	using WordRange = IteratorRange<std::vector<std::string_view>::const_iterator>;
+
+	struct Entry
+	{
+		int document_id;
+		DocumentStatus status;
+		size_t words_begin;
+		size_t words_end;
+	};
+
+	MatchedDocuments() = default;
+	MatchedDocuments(std::vector<Entry> entries, std::vector<std::string_view> words);
+
+	size_t size() const;
+	bool empty() const;
+
+	int GetDocumentId(size_t index) const;
+	DocumentStatus GetStatus(size_t index) const;
+	WordRange GetWords(size_t index) const;
+
+private:
+	std::vector<Entry> entries_;
+	std::vector<std::string_view> words_;
+};
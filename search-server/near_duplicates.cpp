@@ -0,0 +1,286 @@
+#include "near_duplicates.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	const size_t MINHASH_SIGNATURE_SIZE = 128;
+
+	using Signature = std::array<uint64_t, MINHASH_SIGNATURE_SIZE>;
+
+	struct BandLayout
+	{
+		size_t bands;
+		size_t rows;
+	};
+
+	// splitmix64 finalizer, gives an independent-looking hash for every signature slot
+	uint64_t Mix(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	Signature ComputeSignature(const SearchServer& search_server, int document_id)
+	{
+		Signature signature;
+		signature.fill(std::numeric_limits<uint64_t>::max());
+		for (const SearchServer::TermCount& term : search_server.GetDocumentTerms(document_id))
+		{
+			const uint64_t word_hash = Mix(static_cast<uint64_t>(term.term_id));
+			for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i)
+			{
+				signature[i] = std::min(signature[i], Mix(word_hash + i));
+			}
+		}
+		return signature;
+	}
+
+	// Two documents with similarity s share at least one band with probability 1 - (1 - s^rows)^bands.
+	// The steepest part of that curve sits near (1 / bands)^(1 / rows), keep it a bit below the
+	// threshold so that pairs right at the threshold are still very likely to become candidates
+	BandLayout ChooseBandLayout(double threshold)
+	{
+		BandLayout layout{ MINHASH_SIGNATURE_SIZE, 1 };
+		for (size_t rows = 2; rows <= MINHASH_SIGNATURE_SIZE; ++rows)
+		{
+			const size_t bands = MINHASH_SIGNATURE_SIZE / rows;
+			if (std::pow(1.0 / bands, 1.0 / rows) > threshold - 0.1)
+			{
+				break;
+			}
+			layout = { bands, rows };
+		}
+		return layout;
+	}
+
+	double ComputeJaccardSimilarity(const SearchServer::DocumentTerms& lhs, const SearchServer::DocumentTerms& rhs)
+	{
+		if (lhs.empty() && rhs.empty())
+		{
+			return 1.0;
+		}
+		size_t intersection = 0;
+		auto lhs_iter = lhs.begin();
+		auto rhs_iter = rhs.begin();
+		while (lhs_iter != lhs.end() && rhs_iter != rhs.end())
+		{
+			if (lhs_iter->term_id < rhs_iter->term_id)
+			{
+				++lhs_iter;
+			}
+			else if (rhs_iter->term_id < lhs_iter->term_id)
+			{
+				++rhs_iter;
+			}
+			else
+			{
+				++intersection;
+				++lhs_iter;
+				++rhs_iter;
+			}
+		}
+		return static_cast<double>(intersection) / (lhs.size() + rhs.size() - intersection);
+	}
+
+	// Documents sharing a band of their signatures, as indexes into document_ids, sorted within every bucket
+	struct CandidateBuckets
+	{
+		std::vector<int> document_ids;
+		std::vector<std::vector<size_t>> buckets;
+	};
+
+	template <typename ExecutionPolicy>
+	CandidateBuckets FindCandidateBuckets(const ExecutionPolicy& policy, const SearchServer& search_server, double threshold)
+	{
+		if (!(threshold > 0.0 && threshold <= 1.0))
+		{
+			throw std::invalid_argument("Порог похожести документов должен лежать в полуинтервале (0, 1]"s);
+		}
+
+		CandidateBuckets result;
+		result.document_ids.assign(search_server.begin(), search_server.end());
+		std::vector<Signature> signatures(result.document_ids.size());
+		std::transform(policy, result.document_ids.begin(), result.document_ids.end(), signatures.begin(),
+			[&search_server](int document_id)
+			{
+				return ComputeSignature(search_server, document_id);
+			});
+
+		const BandLayout layout = ChooseBandLayout(threshold);
+		std::vector<std::vector<std::vector<size_t>>> band_buckets(layout.bands);
+		std::vector<size_t> band_numbers(layout.bands);
+		std::iota(band_numbers.begin(), band_numbers.end(), 0);
+
+		std::for_each(policy, band_numbers.begin(), band_numbers.end(),
+			[&](size_t band)
+			{
+				std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+				for (size_t index = 0; index < signatures.size(); ++index)
+				{
+					uint64_t band_hash = band;
+					for (size_t row = band * layout.rows; row < (band + 1) * layout.rows; ++row)
+					{
+						band_hash = Mix(band_hash ^ signatures[index][row]);
+					}
+					buckets[band_hash].push_back(index);
+				}
+
+				for (auto& [_, indexes] : buckets)
+				{
+					if (indexes.size() > 1)
+					{
+						band_buckets[band].push_back(std::move(indexes));
+					}
+				}
+			});
+
+		for (auto& buckets : band_buckets)
+		{
+			std::move(buckets.begin(), buckets.end(), std::back_inserter(result.buckets));
+		}
+		// A group of exact duplicates falls into the same bucket of every band, it is kept once
+		std::sort(policy, result.buckets.begin(), result.buckets.end());
+		result.buckets.erase(std::unique(result.buckets.begin(), result.buckets.end()), result.buckets.end());
+		return result;
+	}
+
+	template <typename ExecutionPolicy>
+	std::vector<NearDuplicate> FindNearDuplicatesImpl(const ExecutionPolicy& policy, const SearchServer& search_server, double threshold)
+	{
+		const CandidateBuckets candidate_buckets = FindCandidateBuckets(policy, search_server, threshold);
+		const std::vector<int>& document_ids = candidate_buckets.document_ids;
+
+		// Buckets of different bands overlap, the pairs are deduplicated as they are produced
+		std::unordered_set<uint64_t> seen_pairs;
+		std::vector<std::pair<size_t, size_t>> candidates;
+		for (const std::vector<size_t>& indexes : candidate_buckets.buckets)
+		{
+			for (size_t i = 0; i < indexes.size(); ++i)
+			{
+				for (size_t j = i + 1; j < indexes.size(); ++j)
+				{
+					if (seen_pairs.insert((static_cast<uint64_t>(indexes[i]) << 32) | indexes[j]).second)
+					{
+						candidates.push_back({ indexes[i], indexes[j] });
+					}
+				}
+			}
+		}
+		seen_pairs = {};
+		std::sort(policy, candidates.begin(), candidates.end());
+
+		std::vector<NearDuplicate> near_duplicates(candidates.size());
+		std::transform(policy, candidates.begin(), candidates.end(), near_duplicates.begin(),
+			[&](const std::pair<size_t, size_t>& candidate)
+			{
+				const int original_id = document_ids[candidate.first];
+				const int document_id = document_ids[candidate.second];
+				return NearDuplicate{ document_id, original_id,
+					ComputeJaccardSimilarity(search_server.GetDocumentTerms(original_id), search_server.GetDocumentTerms(document_id)) };
+			});
+
+		near_duplicates.erase(std::remove_if(near_duplicates.begin(), near_duplicates.end(),
+			[threshold](const NearDuplicate& near_duplicate)
+			{
+				return near_duplicate.similarity < threshold;
+			}), near_duplicates.end());
+		return near_duplicates;
+	}
+
+	template <typename ExecutionPolicy>
+	std::vector<int> RemoveNearDuplicatesImpl(const ExecutionPolicy& policy, SearchServer& search_server, double threshold)
+	{
+		const CandidateBuckets candidate_buckets = FindCandidateBuckets(policy, search_server, threshold);
+		const std::vector<int>& document_ids = candidate_buckets.document_ids;
+
+		// Union-find over the documents, the root of a group is its smallest index and so its smallest id.
+		// Every bucket member is checked against the first one only, members already in its group are skipped,
+		// so a group of k copies costs k checks instead of k^2 pairs
+		std::vector<size_t> parents(document_ids.size());
+		std::iota(parents.begin(), parents.end(), 0);
+		const auto find_root = [&parents](size_t index)
+		{
+			while (parents[index] != index)
+			{
+				parents[index] = parents[parents[index]];
+				index = parents[index];
+			}
+			return index;
+		};
+
+		for (const std::vector<size_t>& indexes : candidate_buckets.buckets)
+		{
+			const SearchServer::DocumentTerms& representative_terms = search_server.GetDocumentTerms(document_ids[indexes.front()]);
+			for (size_t i = 1; i < indexes.size(); ++i)
+			{
+				const size_t representative_root = find_root(indexes.front());
+				const size_t member_root = find_root(indexes[i]);
+				if (member_root == representative_root
+					|| ComputeJaccardSimilarity(representative_terms, search_server.GetDocumentTerms(document_ids[indexes[i]])) < threshold)
+				{
+					continue;
+				}
+				parents[std::max(member_root, representative_root)] = std::min(member_root, representative_root);
+			}
+		}
+
+		std::vector<int> to_remove;
+		for (size_t index = 0; index < document_ids.size(); ++index)
+		{
+			if (find_root(index) != index)
+			{
+				to_remove.push_back(document_ids[index]);
+			}
+		}
+
+		for (const int document_id : to_remove)
+		{
+			search_server.RemoveDocument(policy, document_id);
+		}
+		return to_remove;
+	}
+}
+
+std::vector<NearDuplicate> FindNearDuplicates(std::execution::sequenced_policy policy, const SearchServer& search_server, double threshold)
+{
+	return FindNearDuplicatesImpl(policy, search_server, threshold);
+}
+
+std::vector<NearDuplicate> FindNearDuplicates(std::execution::parallel_policy policy, const SearchServer& search_server, double threshold)
+{
+	return FindNearDuplicatesImpl(policy, search_server, threshold);
+}
+
+std::vector<NearDuplicate> FindNearDuplicates(const SearchServer& search_server, double threshold)
+{
+	return FindNearDuplicates(std::execution::seq, search_server, threshold);
+}
+
+std::vector<int> RemoveNearDuplicates(std::execution::sequenced_policy policy, SearchServer& search_server, double threshold)
+{
+	return RemoveNearDuplicatesImpl(policy, search_server, threshold);
+}
+
+std::vector<int> RemoveNearDuplicates(std::execution::parallel_policy policy, SearchServer& search_server, double threshold)
+{
+	return RemoveNearDuplicatesImpl(policy, search_server, threshold);
+}
+
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server, double threshold)
+{
+	return RemoveNearDuplicates(std::execution::seq, search_server, threshold);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <vector>
+#include <execution>
+
+struct NearDuplicate
+{
+	int document_id;
+	int original_id;
+	double similarity;
+};
+
+// Pairs of documents whose word sets have a Jaccard similarity of at least threshold.
+// Candidates come from MinHash signatures bucketed by LSH bands, so a pair close to the
+// threshold may be missed; every reported pair is verified against the exact word sets.
+std::vector<NearDuplicate> FindNearDuplicates(std::execution::sequenced_policy, const SearchServer& search_server, double threshold);
+std::vector<NearDuplicate> FindNearDuplicates(std::execution::parallel_policy, const SearchServer& search_server, double threshold);
+std::vector<NearDuplicate> FindNearDuplicates(const SearchServer& search_server, double threshold);
+
+// Keeps the document with the smallest id of every group of near-duplicates, returns the removed ids.
+// Documents linked through a chain of similar pairs form one group
+std::vector<int> RemoveNearDuplicates(std::execution::sequenced_policy, SearchServer& search_server, double threshold);
+std::vector<int> RemoveNearDuplicates(std::execution::parallel_policy, SearchServer& search_server, double threshold);
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server, double threshold);
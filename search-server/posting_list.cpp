@@ -0,0 +1,323 @@
+#include "posting_list.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <utility>
+
+const PostingList::Posting& PostingList::ConstIterator::operator*() const
+{
+	return current_;
+}
+
+const PostingList::Posting* PostingList::ConstIterator::operator->() const
+{
+	return &current_;
+}
+
+PostingList::ConstIterator& PostingList::ConstIterator::operator++()
+{
+	if (left_in_block_ > 0)
+	{
+		DecodeNext();
+	}
+	else
+	{
+		++block_index_;
+		LoadBlock();
+	}
+	return *this;
+}
+
+PostingList::ConstIterator PostingList::ConstIterator::operator++(int)
+{
+	ConstIterator previous = *this;
+	++(*this);
+	return previous;
+}
+
+PostingList::ConstIterator& PostingList::ConstIterator::SkipTo(int document_id)
+{
+	const auto& blocks = postings_->blocks_;
+	if (block_index_ == blocks.size() || current_.document_id >= document_id)
+	{
+		return *this;
+	}
+	if (blocks[block_index_].last_id < document_id)
+	{
+		// Gallop until a block ending at or after the id is passed, then binary search the last step
+		size_t bound = 1;
+		while (block_index_ + bound < blocks.size() && blocks[block_index_ + bound].last_id < document_id)
+		{
+			bound *= 2;
+		}
+		const auto first = blocks.begin() + (block_index_ + bound / 2 + 1);
+		const auto last = blocks.begin() + std::min(block_index_ + bound + 1, blocks.size());
+		block_index_ = std::lower_bound(first, last, document_id, [](const Block& block, int id)
+			{
+				return block.last_id < id;
+			}) - blocks.begin();
+		LoadBlock();
+	}
+	// The block holds the id or the first larger one
+	while (block_index_ < blocks.size() && current_.document_id < document_id)
+	{
+		++(*this);
+	}
+	return *this;
+}
+
+bool PostingList::ConstIterator::operator==(const ConstIterator& other) const
+{
+	return postings_ == other.postings_
+		&& block_index_ == other.block_index_
+		&& byte_index_ == other.byte_index_;
+}
+
+bool PostingList::ConstIterator::operator!=(const ConstIterator& other) const
+{
+	return !(*this == other);
+}
+
+PostingList::ConstIterator::ConstIterator(const PostingList* postings, size_t block_index)
+	: postings_(postings)
+	, block_index_(block_index)
+{
+	LoadBlock();
+}
+
+void PostingList::ConstIterator::LoadBlock()
+{
+	byte_index_ = 0;
+	if (block_index_ < postings_->blocks_.size())
+	{
+		const Block& block = postings_->blocks_[block_index_];
+		byte_index_ = block.offset;
+		left_in_block_ = block.size;
+		current_.document_id = block.first_id;
+		DecodeNext();
+	}
+}
+
+void PostingList::ConstIterator::DecodeNext()
+{
+	const uint8_t* bytes = postings_->bytes_.data();
+	current_.document_id += static_cast<int>(ReadVarint(bytes, byte_index_));
+	current_.term_count = ReadVarint(bytes, byte_index_);
+	--left_in_block_;
+}
+
+PostingList::PostingList(const allocator_type& allocator)
+	: blocks_(allocator)
+	, bytes_(allocator)
+{}
+
+PostingList::PostingList(const PostingList& other, const allocator_type& allocator)
+	: blocks_(other.blocks_, allocator)
+	, bytes_(other.bytes_, allocator)
+	, size_(other.size_)
+{}
+
+PostingList::PostingList(PostingList&& other, const allocator_type& allocator)
+	: blocks_(std::move(other.blocks_), allocator)
+	, bytes_(std::move(other.bytes_), allocator)
+	, size_(other.size_)
+{
+	other.size_ = 0;
+	other.blocks_.clear();
+	other.bytes_.clear();
+}
+
+PostingList::allocator_type PostingList::get_allocator() const
+{
+	return blocks_.get_allocator();
+}
+
+void PostingList::Add(int document_id, uint32_t term_count)
+{
+	if (blocks_.empty() || document_id > blocks_.back().last_id)
+	{
+		if (blocks_.empty() || blocks_.back().size >= MAX_BLOCK_SIZE)
+		{
+			blocks_.push_back({ document_id, document_id, 0, static_cast<uint32_t>(bytes_.size()) });
+		}
+		// The tail block ends the buffer, so it grows in place
+		AppendToBlock(blocks_.back(), bytes_, document_id, term_count);
+		++size_;
+		return;
+	}
+
+	const size_t block_index = FindBlock(document_id);
+	std::vector<Posting> postings = DecodeBlock(block_index);
+	const auto position = std::lower_bound(postings.begin(), postings.end(), document_id,
+		[](const Posting& posting, int id)
+		{
+			return posting.document_id < id;
+		});
+	if (position != postings.end() && position->document_id == document_id)
+	{
+		position->term_count = term_count;
+	}
+	else
+	{
+		postings.insert(position, { document_id, term_count });
+		++size_;
+	}
+	ReplaceBlock(block_index, postings);
+}
+
+bool PostingList::Remove(int document_id)
+{
+	const size_t block_index = FindBlock(document_id);
+	if (block_index == blocks_.size() || document_id < blocks_[block_index].first_id)
+	{
+		return false;
+	}
+
+	std::vector<Posting> postings = DecodeBlock(block_index);
+	const auto position = std::find_if(postings.begin(), postings.end(), [document_id](const Posting& posting)
+		{
+			return posting.document_id == document_id;
+		});
+	if (position == postings.end())
+	{
+		return false;
+	}
+
+	postings.erase(position);
+	--size_;
+	ReplaceBlock(block_index, postings);
+	return true;
+}
+
+bool PostingList::Contains(int document_id) const
+{
+	return GetTermCount(document_id) > 0;
+}
+
+uint32_t PostingList::GetTermCount(int document_id) const
+{
+	const size_t block_index = FindBlock(document_id);
+	if (block_index == blocks_.size() || document_id < blocks_[block_index].first_id)
+	{
+		return 0;
+	}
+
+	const Block& block = blocks_[block_index];
+	size_t position = block.offset;
+	int current_id = block.first_id;
+	for (uint32_t i = 0; i < block.size; ++i)
+	{
+		current_id += static_cast<int>(ReadVarint(bytes_.data(), position));
+		const uint32_t term_count = ReadVarint(bytes_.data(), position);
+		if (current_id >= document_id)
+		{
+			return current_id == document_id ? term_count : 0;
+		}
+	}
+	return 0;
+}
+
+PostingList::ConstIterator PostingList::begin() const
+{
+	return ConstIterator(this, 0);
+}
+
+PostingList::ConstIterator PostingList::end() const
+{
+	return ConstIterator(this, blocks_.size());
+}
+
+size_t PostingList::size() const
+{
+	return size_;
+}
+
+bool PostingList::empty() const
+{
+	return size_ == 0;
+}
+
+size_t PostingList::GetMemoryUsage() const
+{
+	return sizeof(*this) + blocks_.capacity() * sizeof(Block) + bytes_.capacity();
+}
+
+size_t PostingList::FindBlock(int document_id) const
+{
+	return std::partition_point(blocks_.begin(), blocks_.end(), [document_id](const Block& block)
+		{
+			return block.last_id < document_id;
+		}) - blocks_.begin();
+}
+
+std::vector<PostingList::Posting> PostingList::DecodeBlock(size_t block_index) const
+{
+	const Block& block = blocks_[block_index];
+	std::vector<Posting> postings;
+	postings.reserve(block.size + 1);
+	size_t position = block.offset;
+	int current_id = block.first_id;
+	for (uint32_t i = 0; i < block.size; ++i)
+	{
+		current_id += static_cast<int>(ReadVarint(bytes_.data(), position));
+		postings.push_back({ current_id, ReadVarint(bytes_.data(), position) });
+	}
+	return postings;
+}
+
+void PostingList::ReplaceBlock(size_t block_index, const std::vector<Posting>& postings)
+{
+	const uint32_t begin = blocks_[block_index].offset;
+	const uint32_t end = block_index + 1 < blocks_.size() ? blocks_[block_index + 1].offset : static_cast<uint32_t>(bytes_.size());
+
+	std::vector<Block> blocks;
+	std::pmr::vector<uint8_t> bytes;
+	const size_t middle = postings.size() > MAX_BLOCK_SIZE ? postings.size() / 2 : postings.size();
+	for (const auto& [first, last] : { std::pair{ size_t{ 0 }, middle }, std::pair{ middle, postings.size() } })
+	{
+		if (first == last)
+		{
+			continue;
+		}
+		Block& block = blocks.emplace_back(Block{ postings[first].document_id, postings[first].document_id, 0, static_cast<uint32_t>(begin + bytes.size()) });
+		for (size_t index = first; index < last; ++index)
+		{
+			AppendToBlock(block, bytes, postings[index].document_id, postings[index].term_count);
+		}
+	}
+
+	// The blocks after this one move by the change in its size
+	if (bytes.size() > end - begin)
+	{
+		bytes_.insert(bytes_.begin() + end, bytes.size() - (end - begin), 0);
+	}
+	else
+	{
+		bytes_.erase(bytes_.begin() + begin + bytes.size(), bytes_.begin() + end);
+	}
+	std::copy(bytes.begin(), bytes.end(), bytes_.begin() + begin);
+	const uint32_t shift = static_cast<uint32_t>(bytes.size()) - (end - begin);
+	for (size_t index = block_index + 1; index < blocks_.size(); ++index)
+	{
+		blocks_[index].offset += shift;
+	}
+
+	if (blocks.empty())
+	{
+		blocks_.erase(blocks_.begin() + block_index);
+	}
+	else
+	{
+		blocks_[block_index] = blocks.front();
+		blocks_.insert(blocks_.begin() + block_index + 1, blocks.begin() + 1, blocks.end());
+	}
+}
+
+void PostingList::AppendToBlock(Block& block, std::pmr::vector<uint8_t>& bytes, int document_id, uint32_t term_count)
+{
+	const int previous_id = block.size == 0 ? block.first_id : block.last_id;
+	WriteVarint(bytes, static_cast<uint32_t>(document_id - previous_id));
+	WriteVarint(bytes, term_count);
+	block.last_id = document_id;
+	++block.size;
+}
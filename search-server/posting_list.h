@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <vector>
+
+// Document ids of one word in increasing order together with the number of times the word occurs in each document.
+// Postings are kept in blocks of up to MAX_BLOCK_SIZE entries: every block remembers its first and last id and
+// stores the postings as variable-byte encoded deltas between neighbouring ids followed by the term count.
+// The blocks of a list are packed one after another into a single byte buffer next to an array of small headers.
+// Appending a larger id touches only the tail block, other updates re-encode the single block they fall into
+// and move the bytes of the blocks after it. Both arrays are allocated from the memory resource of the list,
+// so a container of lists can keep them in its pool.
+class PostingList
+{
+public:
+	struct Posting
+	{
+		int document_id;
+		uint32_t term_count;
+	};
+
+	class ConstIterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Posting;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Posting*;
+		using reference = const Posting&;
+
+		ConstIterator() = default;
+
+		reference operator*() const;
+		pointer operator->() const;
+		ConstIterator& operator++();
+		ConstIterator operator++(int);
+		// Moves forward to the first posting with an id not less than the given one. Whole blocks are skipped
+		// by their last id with an exponential search from the current block, only the target block is decoded
+		ConstIterator& SkipTo(int document_id);
+
+		bool operator==(const ConstIterator& other) const;
+		bool operator!=(const ConstIterator& other) const;
+
+	private:
+		friend class PostingList;
+
+		ConstIterator(const PostingList* postings, size_t block_index);
+
+		void LoadBlock();
+		void DecodeNext();
+
+		const PostingList* postings_ = nullptr;
+		size_t block_index_ = 0;
+		size_t byte_index_ = 0;
+		uint32_t left_in_block_ = 0;
+		Posting current_{ 0, 0 };
+	};
+
+	static const uint32_t MAX_BLOCK_SIZE = 128;
+
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	PostingList() = default;
+	explicit PostingList(const allocator_type& allocator);
+	PostingList(const PostingList& other) = default;
+	PostingList(const PostingList& other, const allocator_type& allocator);
+	PostingList(PostingList&& other) = default;
+	PostingList(PostingList&& other, const allocator_type& allocator);
+	PostingList& operator=(const PostingList& other) = default;
+	PostingList& operator=(PostingList&& other) = default;
+
+	allocator_type get_allocator() const;
+
+	// Inserts a posting or replaces the term count of an existing one
+	void Add(int document_id, uint32_t term_count);
+	bool Remove(int document_id);
+
+	bool Contains(int document_id) const;
+	uint32_t GetTermCount(int document_id) const;
+
+	ConstIterator begin() const;
+	ConstIterator end() const;
+
+	size_t size() const;
+	bool empty() const;
+	size_t GetMemoryUsage() const;
+
+private:
+	struct Block
+	{
+		int first_id;
+		int last_id;
+		uint32_t size;
+		// Where the block starts in bytes_, it ends where the next one starts
+		uint32_t offset;
+	};
+
+	std::pmr::vector<Block> blocks_;
+	std::pmr::vector<uint8_t> bytes_;
+	size_t size_ = 0;
+
+	size_t FindBlock(int document_id) const;
+	std::vector<Posting> DecodeBlock(size_t block_index) const;
+	// Encodes the postings in place of the block: splits them in two when they outgrow a block, drops the block when there are none
+	void ReplaceBlock(size_t block_index, const std::vector<Posting>& postings);
+	static void AppendToBlock(Block& block, std::pmr::vector<uint8_t>& bytes, int document_id, uint32_t term_count);
+};
@@ -0,0 +1,74 @@
+#include "query_arena.h"
+
+#include <algorithm>
+
+QueryArena::Scope::Scope()
+	: arena_(ForCurrentThread())
+{
+	++arena_.depth_;
+}
+
+QueryArena::Scope::~Scope()
+{
+	if (--arena_.depth_ == 0)
+	{
+		arena_.Release();
+	}
+}
+
+std::pmr::memory_resource* QueryArena::Scope::GetResource() const
+{
+	return &*arena_.monotonic_;
+}
+
+std::pmr::memory_resource* QueryArena::Scope::GetSharedResource() const
+{
+	return &arena_.shared_;
+}
+
+QueryArena& QueryArena::ForCurrentThread()
+{
+	thread_local QueryArena arena;
+	return arena;
+}
+
+size_t QueryArena::GetBufferSize() const
+{
+	return buffer_.size();
+}
+
+QueryArena::QueryArena()
+	: buffer_(INITIAL_BUFFER_SIZE)
+{
+	monotonic_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+}
+
+void QueryArena::Release()
+{
+	monotonic_->release();
+	if (upstream_.allocated > 0 && buffer_.size() < MAX_BUFFER_SIZE)
+	{
+		// The last query overflowed the buffer, make the next one fit with room to spare
+		const size_t required = std::min((buffer_.size() + upstream_.allocated) * 2, MAX_BUFFER_SIZE);
+		monotonic_.reset();
+		buffer_.assign(required, std::byte{});
+		monotonic_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+	}
+	upstream_.allocated = 0;
+}
+
+void* QueryArena::CountingResource::do_allocate(size_t bytes, size_t alignment)
+{
+	allocated += bytes;
+	return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void QueryArena::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool QueryArena::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
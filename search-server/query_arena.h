@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+// Scratch memory for the temporary containers of a query. Every thread owns one arena,
+// a Scope hands it out and the outermost Scope releases everything at once when it ends.
+// When a query needed more than the arena had, the arena grows for the next one, so that
+// queries stop touching the global heap once the largest one has been seen
+class QueryArena
+{
+public:
+	class Scope
+	{
+	public:
+		Scope();
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		// Must only be used by the thread that opened the scope
+		std::pmr::memory_resource* GetResource() const;
+		// May be shared with the worker threads of a parallel algorithm
+		std::pmr::memory_resource* GetSharedResource() const;
+
+	private:
+		QueryArena& arena_;
+	};
+
+	static constexpr size_t INITIAL_BUFFER_SIZE = 16 * 1024;
+	// Queries that need more than this keep allocating the excess from the heap
+	static constexpr size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
+	QueryArena(const QueryArena&) = delete;
+	QueryArena& operator=(const QueryArena&) = delete;
+
+	static QueryArena& ForCurrentThread();
+	size_t GetBufferSize() const;
+
+private:
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		size_t allocated = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	};
+
+	QueryArena();
+
+	void Release();
+
+	std::vector<std::byte> buffer_;
+	CountingResource upstream_;
+	std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+	std::pmr::synchronized_pool_resource shared_;
+	int depth_ = 0;
+};
@@ -0,0 +1,729 @@
+#include "query_server.h"
+#include "document_loader.h"
+#include "unix_socket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	// epoll keys: the listener, the wake-up descriptor, and connection id * 2 plus one for a separate output descriptor
+	const uint64_t LISTENER_KEY = 0;
+	const uint64_t WAKE_KEY = 1;
+	const size_t READ_CHUNK_SIZE = 64 * 1024;
+	// Reading stops while this much output waits for a client that doesn't read its responses
+	const size_t MAX_PENDING_OUTPUT = 4 << 20;
+
+	[[noreturn]] void ThrowSystemError(const std::string& what)
+	{
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	int GetFlags(int descriptor)
+	{
+		const int flags = ::fcntl(descriptor, F_GETFL);
+		if (flags < 0)
+		{
+			ThrowSystemError("fcntl"s);
+		}
+		return flags;
+	}
+
+	void SetNonBlocking(int descriptor)
+	{
+		if (::fcntl(descriptor, F_SETFL, GetFlags(descriptor) | O_NONBLOCK) < 0)
+		{
+			ThrowSystemError("fcntl"s);
+		}
+	}
+
+	std::vector<std::string_view> SplitFields(std::string_view line, size_t max_count)
+	{
+		std::vector<std::string_view> fields;
+		while (fields.size() + 1 < max_count)
+		{
+			const size_t tab = line.find('\t');
+			if (tab == std::string_view::npos)
+			{
+				break;
+			}
+			fields.push_back(line.substr(0, tab));
+			line.remove_prefix(tab + 1);
+		}
+		fields.push_back(line);
+		return fields;
+	}
+
+	int ParseDocumentId(std::string_view text)
+	{
+		int value = 0;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc() || end != text.data() + text.size())
+		{
+			throw std::invalid_argument("Неверный id документа: "s + std::string(text));
+		}
+		return value;
+	}
+
+	void RequireFieldCount(const std::vector<std::string_view>& fields, size_t min_count, size_t max_count)
+	{
+		if (fields.size() < min_count || fields.size() > max_count)
+		{
+			throw std::invalid_argument("Неверное число полей в запросе "s + std::string(fields[0]));
+		}
+	}
+}
+
+class QueryServer::WorkerPool
+{
+public:
+	explicit WorkerPool(size_t thread_count)
+	{
+		for (size_t index = 0; index < thread_count; ++index)
+		{
+			threads_.emplace_back([this]()
+				{
+					Run();
+				});
+		}
+	}
+
+	// Runs the queued tasks before returning
+	~WorkerPool()
+	{
+		{
+			std::lock_guard guard(mutex_);
+			stopping_ = true;
+		}
+		condition_.notify_all();
+		for (std::thread& thread : threads_)
+		{
+			thread.join();
+		}
+	}
+
+	void Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard guard(mutex_);
+			tasks_.push_back(std::move(task));
+		}
+		condition_.notify_one();
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::deque<std::function<void()>> tasks_;
+	bool stopping_ = false;
+	std::vector<std::thread> threads_;
+
+	void Run()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock lock(mutex_);
+				condition_.wait(lock, [this]()
+					{
+						return stopping_ || !tasks_.empty();
+					});
+				if (tasks_.empty())
+				{
+					return;
+				}
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+		}
+	}
+};
+
+// State of one Serve call, owned by the thread running it
+class QueryServer::EventLoop
+{
+public:
+	explicit EventLoop(QueryServer& server)
+		: server_(server)
+		, epoll_descriptor_(::epoll_create1(EPOLL_CLOEXEC))
+	{
+		if (epoll_descriptor_ < 0)
+		{
+			ThrowSystemError("epoll_create1"s);
+		}
+		Register(server_.wake_descriptor_, WAKE_KEY, EPOLLIN);
+	}
+
+	~EventLoop()
+	{
+		for (const auto& [id, connection] : connections_)
+		{
+			RestoreFlags(connection);
+		}
+		::close(epoll_descriptor_);
+	}
+
+	void Listen(const std::string& socket_path)
+	{
+		listener_ = UnixSocket::Listen(socket_path);
+		SetNonBlocking(listener_.GetDescriptor());
+		Register(listener_.GetDescriptor(), LISTENER_KEY, EPOLLIN);
+	}
+
+	void AddStreams(int input_descriptor, int output_descriptor)
+	{
+		AddConnection(UnixSocket(), input_descriptor, output_descriptor);
+	}
+
+	// Returns when the server is stopped or, without a listener, when the last connection is closed
+	void Run()
+	{
+		std::vector<epoll_event> events(64);
+		while (!server_.stopping_ && (listener_ || !connections_.empty()))
+		{
+			// Regular files are never reported by epoll, they are read without waiting
+			const bool has_ready_files = std::any_of(connections_.begin(), connections_.end(), [this](const auto& connection)
+				{
+					return !connection.second.input_registrable && WantsInput(connection.second);
+				});
+			const int count = ::epoll_wait(epoll_descriptor_, events.data(), static_cast<int>(events.size()), has_ready_files ? 0 : -1);
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				ThrowSystemError("epoll_wait"s);
+			}
+
+			for (int index = 0; index < count; ++index)
+			{
+				const uint64_t key = events[index].data.u64;
+				if (key == LISTENER_KEY)
+				{
+					AcceptConnections();
+				}
+				else if (key == WAKE_KEY)
+				{
+					uint64_t value;
+					[[maybe_unused]] const ssize_t result = ::read(server_.wake_descriptor_, &value, sizeof(value));
+					ProcessCompletions();
+				}
+				else if (const auto connection = connections_.find(key >> 1); connection != connections_.end())
+				{
+					if ((key & 1) == 0 && (events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0 && WantsInput(connection->second))
+					{
+						ReadInput(connection->second);
+					}
+					WriteOutput(connection->second);
+					Update(connection->first);
+				}
+			}
+
+			if (has_ready_files)
+			{
+				std::vector<uint64_t> ids;
+				for (const auto& [id, connection] : connections_)
+				{
+					if (!connection.input_registrable && WantsInput(connection))
+					{
+						ids.push_back(id);
+					}
+				}
+				for (const uint64_t id : ids)
+				{
+					ReadInput(connections_.at(id));
+					Update(id);
+				}
+			}
+		}
+	}
+
+private:
+	struct Connection
+	{
+		// Empty for descriptors the loop doesn't own
+		UnixSocket socket;
+		int input_descriptor;
+		int output_descriptor;
+		// Flags to put back on descriptors the loop doesn't own, which share them with the caller
+		int input_flags = -1;
+		int output_flags = -1;
+		// False for regular files, which epoll rejects and which are always ready
+		bool input_registrable = true;
+		bool output_registrable = true;
+		uint32_t input_events = 0;
+		uint32_t output_events = 0;
+
+		std::string input;
+		bool input_closed = false;
+		bool broken = false;
+		std::string output;
+		size_t output_offset = 0;
+
+		uint64_t next_sequence = 0;
+		uint64_t next_response = 0;
+		// Responses that arrived before those of earlier requests
+		std::map<uint64_t, std::string> ready;
+	};
+
+	QueryServer& server_;
+	int epoll_descriptor_;
+	UnixSocket listener_;
+	std::unordered_map<uint64_t, Connection> connections_;
+
+	bool Register(int descriptor, uint64_t key, uint32_t events)
+	{
+		epoll_event event{};
+		event.events = events;
+		event.data.u64 = key;
+		if (::epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, descriptor, &event) == 0)
+		{
+			return true;
+		}
+		if (errno == EPERM)
+		{
+			return false;
+		}
+		ThrowSystemError("epoll_ctl"s);
+	}
+
+	// Descriptors without interest are taken out of epoll, which would otherwise keep reporting a hang-up
+	void SetInterest(int descriptor, uint64_t key, uint32_t& current, uint32_t wanted)
+	{
+		if (current == wanted)
+		{
+			return;
+		}
+		epoll_event event{};
+		event.events = wanted;
+		event.data.u64 = key;
+		const int operation = current == 0 ? EPOLL_CTL_ADD : (wanted == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD);
+		if (::epoll_ctl(epoll_descriptor_, operation, descriptor, &event) != 0)
+		{
+			ThrowSystemError("epoll_ctl"s);
+		}
+		current = wanted;
+	}
+
+	void AddConnection(UnixSocket socket, int input_descriptor, int output_descriptor)
+	{
+		const uint64_t id = server_.next_connection_id_++;
+		Connection& connection = connections_[id];
+		connection.input_descriptor = input_descriptor;
+		connection.output_descriptor = output_descriptor;
+		if (!socket)
+		{
+			// Both are read first, the descriptors may share one open file description
+			const int input_flags = GetFlags(input_descriptor);
+			const int output_flags = GetFlags(output_descriptor);
+			connection.input_flags = input_flags;
+			connection.output_flags = output_flags;
+		}
+		connection.socket = std::move(socket);
+		SetNonBlocking(input_descriptor);
+		SetNonBlocking(output_descriptor);
+		// Probe whether epoll accepts the descriptors, they are registered for real by Update
+		connection.input_registrable = Register(input_descriptor, id << 1, 0);
+		if (connection.input_registrable)
+		{
+			::epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, input_descriptor, nullptr);
+		}
+		if (output_descriptor != input_descriptor)
+		{
+			connection.output_registrable = Register(output_descriptor, (id << 1) | 1, 0);
+			if (connection.output_registrable)
+			{
+				::epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, output_descriptor, nullptr);
+			}
+		}
+		Update(id);
+	}
+
+	static void RestoreFlags(const Connection& connection)
+	{
+		if (connection.output_flags >= 0)
+		{
+			::fcntl(connection.output_descriptor, F_SETFL, connection.output_flags);
+		}
+		if (connection.input_flags >= 0)
+		{
+			::fcntl(connection.input_descriptor, F_SETFL, connection.input_flags);
+		}
+	}
+
+	void AcceptConnections()
+	{
+		while (true)
+		{
+			const int descriptor = ::accept4(listener_.GetDescriptor(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (descriptor < 0)
+			{
+				if (errno == EINTR || errno == ECONNABORTED)
+				{
+					continue;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					return;
+				}
+				ThrowSystemError("accept"s);
+			}
+			AddConnection(UnixSocket(descriptor), descriptor, descriptor);
+		}
+	}
+
+	bool WantsInput(const Connection& connection) const
+	{
+		return !connection.input_closed && !connection.broken
+			&& connection.next_sequence - connection.next_response < server_.options_.max_pending_requests
+			&& connection.output.size() - connection.output_offset < MAX_PENDING_OUTPUT;
+	}
+
+	void ReadInput(Connection& connection)
+	{
+		char buffer[READ_CHUNK_SIZE];
+		const ssize_t received = ::read(connection.input_descriptor, buffer, sizeof(buffer));
+		if (received < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				connection.broken = true;
+			}
+			return;
+		}
+		if (received == 0)
+		{
+			connection.input_closed = true;
+		}
+		connection.input.append(buffer, static_cast<size_t>(received));
+	}
+
+	// Submits the complete lines of the input, as many as the limit of unanswered requests allows
+	void SubmitRequests(uint64_t id, Connection& connection)
+	{
+		size_t position = 0;
+		while (connection.next_sequence - connection.next_response < server_.options_.max_pending_requests)
+		{
+			size_t end = connection.input.find('\n', position);
+			if (end == std::string::npos)
+			{
+				if (connection.input.size() - position > server_.options_.max_line_length)
+				{
+					// Without a line end there is no way to find the next request, the connection is answered and closed
+					connection.ready.emplace(connection.next_sequence++, "ERROR\tСлишком длинный запрос"s);
+					connection.input_closed = true;
+					position = connection.input.size();
+					break;
+				}
+				if (!connection.input_closed || position == connection.input.size())
+				{
+					break;
+				}
+				end = connection.input.size();
+			}
+			std::string_view line(connection.input.data() + position, end - position);
+			position = std::min(end + 1, connection.input.size());
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.remove_suffix(1);
+			}
+			if (!line.empty())
+			{
+				server_.Submit(id, connection.next_sequence++, std::string(line));
+			}
+		}
+		connection.input.erase(0, position);
+	}
+
+	void ProcessCompletions()
+	{
+		std::vector<uint64_t> ids;
+		for (Completion& completion : server_.TakeCompletions())
+		{
+			// The connection may have been closed in the meantime
+			const auto connection = connections_.find(completion.connection_id);
+			if (connection != connections_.end())
+			{
+				connection->second.ready.emplace(completion.sequence, std::move(completion.response));
+				ids.push_back(completion.connection_id);
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+		for (const uint64_t id : ids)
+		{
+			WriteOutput(connections_.at(id));
+			Update(id);
+		}
+	}
+
+	void WriteOutput(Connection& connection)
+	{
+		while (!connection.ready.empty() && connection.ready.begin()->first == connection.next_response)
+		{
+			connection.output += connection.ready.begin()->second;
+			connection.output += '\n';
+			connection.ready.erase(connection.ready.begin());
+			++connection.next_response;
+		}
+		while (connection.output_offset < connection.output.size() && !connection.broken)
+		{
+			const ssize_t written = ::write(connection.output_descriptor, connection.output.data() + connection.output_offset, connection.output.size() - connection.output_offset);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					connection.broken = true;
+				}
+				break;
+			}
+			connection.output_offset += static_cast<size_t>(written);
+		}
+		if (connection.output_offset == connection.output.size())
+		{
+			connection.output.clear();
+			connection.output_offset = 0;
+		}
+	}
+
+	// Submits what can be submitted, then closes the connection or adjusts what epoll waits for
+	void Update(uint64_t id)
+	{
+		Connection& connection = connections_.at(id);
+		if (!connection.broken)
+		{
+			SubmitRequests(id, connection);
+			WriteOutput(connection);
+		}
+		const bool has_output = connection.output_offset < connection.output.size();
+		const bool finished = connection.input_closed && connection.next_response == connection.next_sequence && !has_output;
+		if (connection.broken || finished)
+		{
+			const uint32_t none = 0;
+			if (connection.input_registrable)
+			{
+				SetInterest(connection.input_descriptor, id << 1, connection.input_events, none);
+			}
+			if (connection.output_descriptor != connection.input_descriptor && connection.output_registrable)
+			{
+				SetInterest(connection.output_descriptor, (id << 1) | 1, connection.output_events, none);
+			}
+			RestoreFlags(connection);
+			connections_.erase(id);
+			return;
+		}
+
+		const uint32_t input_events = WantsInput(connection) ? static_cast<uint32_t>(EPOLLIN) : 0;
+		const uint32_t output_events = has_output ? static_cast<uint32_t>(EPOLLOUT) : 0;
+		if (connection.output_descriptor == connection.input_descriptor)
+		{
+			SetInterest(connection.input_descriptor, id << 1, connection.input_events, input_events | output_events);
+			return;
+		}
+		if (connection.input_registrable)
+		{
+			SetInterest(connection.input_descriptor, id << 1, connection.input_events, input_events);
+		}
+		if (connection.output_registrable)
+		{
+			SetInterest(connection.output_descriptor, (id << 1) | 1, connection.output_events, output_events);
+		}
+	}
+};
+
+QueryServer::QueryServer(SearchServer& server)
+	: QueryServer(server, Options())
+{}
+
+QueryServer::QueryServer(SearchServer& server, Options options)
+	: server_(server)
+	, options_(options)
+	, wake_descriptor_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+	if (wake_descriptor_ < 0)
+	{
+		ThrowSystemError("eventfd"s);
+	}
+	const size_t worker_count = options_.worker_count > 0 ? options_.worker_count : std::max(1u, std::thread::hardware_concurrency());
+	workers_ = std::make_unique<WorkerPool>(worker_count);
+}
+
+QueryServer::QueryServer(DurableSearchServer& server, Options options)
+	: QueryServer(server.GetServer(), options)
+{
+	durable_server_ = &server;
+}
+
+QueryServer::~QueryServer()
+{
+	workers_.reset();
+	::close(wake_descriptor_);
+}
+
+std::string QueryServer::HandleRequest(std::string_view line)
+{
+	try
+	{
+		const std::vector<std::string_view> fields = SplitFields(line, 5);
+		const std::string_view command = fields[0];
+		std::ostringstream response;
+		response << "OK"s;
+		if (command == "FIND")
+		{
+			RequireFieldCount(fields, 2, 3);
+			const DocumentStatus status = fields.size() == 3 ? ParseDocumentStatus(fields[2]) : DocumentStatus::ACTUAL;
+			std::shared_lock lock(server_mutex_);
+			for (const Document& document : server_.FindTopDocuments(adaptive_policy, fields[1], status))
+			{
+				response << '\t' << document.id << ' ' << document.relevance << ' ' << document.rating;
+			}
+		}
+		else if (command == "MATCH")
+		{
+			RequireFieldCount(fields, 3, 3);
+			const int document_id = ParseDocumentId(fields[1]);
+			std::shared_lock lock(server_mutex_);
+			const auto [words, status] = server_.MatchDocument(fields[2], document_id);
+			response << '\t' << GetDocumentStatusName(status) << '\t';
+			for (size_t index = 0; index < words.size(); ++index)
+			{
+				response << (index == 0 ? "" : " ") << words[index];
+			}
+		}
+		else if (command == "ADD")
+		{
+			RequireFieldCount(fields, 5, 5);
+			const DocumentRecord record = ParseDocumentRecord(line.substr(fields[1].data() - line.data()));
+			if (durable_server_ == nullptr)
+			{
+				std::lock_guard guard(server_mutex_);
+				server_.AddDocument(record.id, record.text, record.status, record.ratings);
+			}
+			else
+			{
+				// Answered once the update is durable, without holding up the readers meanwhile
+				uint64_t position = 0;
+				{
+					std::lock_guard guard(server_mutex_);
+					position = durable_server_->AddDocument(record.id, record.text, record.status, record.ratings);
+				}
+				durable_server_->Sync(position);
+			}
+		}
+		else if (command == "REMOVE")
+		{
+			RequireFieldCount(fields, 2, 2);
+			const int document_id = ParseDocumentId(fields[1]);
+			if (durable_server_ == nullptr)
+			{
+				std::lock_guard guard(server_mutex_);
+				server_.RemoveDocument(document_id);
+			}
+			else
+			{
+				uint64_t position = 0;
+				{
+					std::lock_guard guard(server_mutex_);
+					position = durable_server_->RemoveDocument(document_id);
+				}
+				durable_server_->Sync(position);
+			}
+		}
+		else if (command == "COUNT")
+		{
+			RequireFieldCount(fields, 1, 1);
+			std::shared_lock lock(server_mutex_);
+			response << '\t' << server_.GetDocumentCount();
+		}
+		else
+		{
+			throw std::invalid_argument("Неизвестная команда: "s + std::string(command));
+		}
+		return response.str();
+	}
+	catch (const std::exception& e)
+	{
+		// The messages of SearchServer may span several lines
+		std::string message = e.what();
+		std::replace_if(message.begin(), message.end(), [](char c)
+			{
+				return c == '\n' || c == '\t' || c == '\r';
+			}, ' ');
+		while (!message.empty() && message.back() == ' ')
+		{
+			message.pop_back();
+		}
+		return "ERROR\t"s + message;
+	}
+}
+
+void QueryServer::ServeSocket(const std::string& socket_path)
+{
+	EventLoop loop(*this);
+	loop.Listen(socket_path);
+	loop.Run();
+}
+
+void QueryServer::ServeStreams(int input_descriptor, int output_descriptor)
+{
+	EventLoop loop(*this);
+	loop.AddStreams(input_descriptor, output_descriptor);
+	loop.Run();
+}
+
+void QueryServer::Stop()
+{
+	stopping_ = true;
+	Wake();
+}
+
+void QueryServer::Submit(uint64_t connection_id, uint64_t sequence, std::string line)
+{
+	workers_->Submit([this, connection_id, sequence, line = std::move(line)]()
+		{
+			std::string response = HandleRequest(line);
+			{
+				std::lock_guard guard(completions_mutex_);
+				completions_.push_back({ connection_id, sequence, std::move(response) });
+			}
+			Wake();
+		});
+}
+
+std::vector<QueryServer::Completion> QueryServer::TakeCompletions()
+{
+	std::lock_guard guard(completions_mutex_);
+	return std::exchange(completions_, {});
+}
+
+void QueryServer::Wake()
+{
+	const uint64_t value = 1;
+	[[maybe_unused]] const ssize_t result = ::write(wake_descriptor_, &value, sizeof(value));
+}
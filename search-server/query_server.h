@@ -0,0 +1,86 @@
+#pragma once
+
+#include "durable_search_server.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Serves a SearchServer over a Unix domain socket or a pair of streams with a line protocol. Every request is one
+// line of tab-separated fields and gets one response line, in the order the requests came on the connection:
+//
+//     FIND    query [status]                   -> OK  then "id relevance rating" of every document
+//     MATCH   id  query                        -> OK  status  matched words separated by spaces
+//     ADD     id  status  ratings  text        -> OK            (the fields of a documents file, see document_loader.h)
+//     REMOVE  id                               -> OK
+//     COUNT                                    -> OK  document count
+//
+// A failed request is answered with ERROR and the message. One thread runs an epoll loop that reads requests,
+// hands them to a pool of workers and writes the responses back, so a connection may send further requests
+// while the earlier ones are executed and one slow query doesn't hold up other connections.
+// Searches run concurrently, updates lock the server exclusively. With a DurableSearchServer an update is
+// answered once it is logged durably, updates of several workers share one fsync
+class QueryServer
+{
+public:
+	struct Options
+	{
+		// Zero means one worker per hardware thread
+		size_t worker_count = 0;
+		// A connection is not read any further while this many of its requests are unanswered
+		size_t max_pending_requests = 256;
+		size_t max_line_length = 1 << 20;
+	};
+
+	explicit QueryServer(SearchServer& server);
+	QueryServer(SearchServer& server, Options options);
+	QueryServer(DurableSearchServer& server, Options options);
+	~QueryServer();
+
+	std::string HandleRequest(std::string_view line);
+
+	// Accepts connections until Stop is called
+	void ServeSocket(const std::string& socket_path);
+	// Serves a single client on already opened descriptors, e.g. stdin and stdout, until the input ends or Stop is called.
+	// Regular files are accepted too, the descriptors are switched to non-blocking mode and not closed
+	void ServeStreams(int input_descriptor, int output_descriptor);
+	// Only one serving call may run at a time. Stop can be called from any thread, the serving call returns soon after
+	void Stop();
+
+private:
+	class WorkerPool;
+	class EventLoop;
+
+	struct Completion
+	{
+		uint64_t connection_id;
+		uint64_t sequence;
+		std::string response;
+	};
+
+	SearchServer& server_;
+	// Logs the updates of server_ when set
+	DurableSearchServer* durable_server_ = nullptr;
+	std::shared_mutex server_mutex_;
+	const Options options_;
+
+	// Wakes the event loop when responses are ready or the server is stopped
+	int wake_descriptor_ = -1;
+	std::atomic<bool> stopping_{ false };
+	std::atomic<uint64_t> next_connection_id_{ 1 };
+	std::mutex completions_mutex_;
+	std::vector<Completion> completions_;
+
+	// Destroyed first, so that no worker outlives the members above
+	std::unique_ptr<WorkerPool> workers_;
+
+	void Submit(uint64_t connection_id, uint64_t sequence, std::string line);
+	std::vector<Completion> TakeCompletions();
+	void Wake();
+};
@@ -0,0 +1,202 @@
+// Query server: owns one SearchServer and answers requests of the QueryServer line protocol, see query_server.h.
+//
+// Build from the search-server directory:
+//   g++ -std=c++17 -O2 -DNDEBUG query_server/main.cpp $(ls *.cpp | grep -v '^main.cpp$') -ltbb -lpthread -o search_query_server
+// Run:
+//   ./search_query_server --socket /tmp/search.sock [--stop-words "and in on"] [--documents docs.tsv] [--workers 4]
+//   ./search_query_server --stdio [--documents docs.tsv] < requests.txt > responses.txt
+//   ./search_query_server --socket /tmp/search.sock --data /var/lib/search [--documents docs.tsv]
+//   ./search_query_server --socket /tmp/search.sock --positions --documents docs.tsv
+//
+// The documents file is loaded by LoadDocuments, see document_loader.h. With --stdio the server answers the requests
+// of stdin on stdout and exits at the end of the input. With --data the updates are kept in the directory by
+// DurableSearchServer and the documents file only seeds an empty directory. --positions builds the positional
+// index for phrase and NEAR queries, a data directory must always be opened with the same choice. SIGINT and SIGTERM stop the server
+
+#include "../document_loader.h"
+#include "../durable_search_server.h"
+#include "../query_server.h"
+#include "../search_server.h"
+
+#include <charconv>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <pthread.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	struct Options
+	{
+		std::string socket_path;
+		bool use_stdio = false;
+		bool positional_index = false;
+		std::string stop_words;
+		std::string documents_path;
+		std::string data_directory;
+		size_t worker_count = 0;
+	};
+
+	size_t ParseWorkerCount(std::string_view text)
+	{
+		size_t value = 0;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc() || end != text.data() + text.size())
+		{
+			throw std::invalid_argument("Неверное число потоков: "s + std::string(text));
+		}
+		return value;
+	}
+
+	Options ParseOptions(int argc, char* argv[])
+	{
+		const std::string usage = "Использование: search_query_server (--socket PATH | --stdio) [--stop-words WORDS] [--documents FILE] [--data DIR] [--workers N] [--positions]"s;
+		Options options;
+		for (int index = 1; index < argc; ++index)
+		{
+			const std::string_view name = argv[index];
+			if (name == "--stdio")
+			{
+				options.use_stdio = true;
+				continue;
+			}
+			if (name == "--positions")
+			{
+				options.positional_index = true;
+				continue;
+			}
+			if (index + 1 == argc)
+			{
+				throw std::invalid_argument(usage);
+			}
+			const std::string_view value = argv[++index];
+			if (name == "--socket")
+			{
+				options.socket_path = value;
+			}
+			else if (name == "--stop-words")
+			{
+				options.stop_words = value;
+			}
+			else if (name == "--documents")
+			{
+				options.documents_path = value;
+			}
+			else if (name == "--data")
+			{
+				options.data_directory = value;
+			}
+			else if (name == "--workers")
+			{
+				options.worker_count = ParseWorkerCount(value);
+			}
+			else
+			{
+				throw std::invalid_argument("Неизвестный параметр "s + std::string(name));
+			}
+		}
+		if (options.use_stdio == !options.socket_path.empty())
+		{
+			throw std::invalid_argument(usage);
+		}
+		return options;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+
+		// The signals are taken by a dedicated thread, the other threads inherit the blocked mask
+		sigset_t stop_signals;
+		sigemptyset(&stop_signals);
+		sigaddset(&stop_signals, SIGINT);
+		sigaddset(&stop_signals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+		SearchServer server(options.stop_words);
+		server.SetPositionalIndex(options.positional_index);
+		std::optional<DurableSearchServer> durable_server;
+		if (!options.data_directory.empty())
+		{
+			durable_server.emplace(server, options.data_directory);
+		}
+		if (!options.documents_path.empty() && (!durable_server || server.GetDocumentCount() == 0))
+		{
+			if (durable_server)
+			{
+				LoadDocuments(*durable_server, options.documents_path);
+			}
+			else
+			{
+				LoadDocuments(server, options.documents_path);
+			}
+		}
+		if (durable_server)
+		{
+			// The replayed log becomes a checkpoint in the background, so the next start doesn't replay it again
+			durable_server->Checkpoint();
+		}
+		std::cerr << "Query server: " << server.GetDocumentCount() << " documents" << std::endl;
+		// Adaptive queries are answered with calibrated thresholds, measure them before accepting any
+		SearchServer::Calibrate();
+
+		QueryServer::Options query_options;
+		query_options.worker_count = options.worker_count;
+		std::optional<QueryServer> query_server;
+		if (durable_server)
+		{
+			query_server.emplace(*durable_server, query_options);
+		}
+		else
+		{
+			query_server.emplace(server, query_options);
+		}
+		std::thread signal_thread([&query_server, &stop_signals]()
+			{
+				int signal = 0;
+				sigwait(&stop_signals, &signal);
+				query_server->Stop();
+			});
+		// The thread uses the servers, it is woken and joined before they are destroyed
+		const auto stop_signal_thread = [&signal_thread]()
+			{
+				pthread_kill(signal_thread.native_handle(), SIGTERM);
+				signal_thread.join();
+			};
+		try
+		{
+			if (options.use_stdio)
+			{
+				query_server->ServeStreams(STDIN_FILENO, STDOUT_FILENO);
+			}
+			else
+			{
+				query_server->ServeSocket(options.socket_path);
+			}
+		}
+		catch (...)
+		{
+			stop_signal_thread();
+			throw;
+		}
+		stop_signal_thread();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// What FindTopDocuments did for one query, filled in when a trace is passed to it
+struct QueryTrace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Term
+	{
+		std::string word;
+		// Zero for words missing from the index
+		size_t posting_count = 0;
+		// Weight of the term under the ranking policy, the IDF for TF-IDF. Not computed for minus words
+		double weight = 0.0;
+		size_t documents_scored = 0;
+		size_t documents_filtered = 0;
+		// Postings never scored by a query with required (+word) words, see QueryTrace::documents_skipped
+		size_t documents_skipped = 0;
+		size_t documents_excluded = 0;
+	};
+
+	std::vector<std::string> stop_words;
+	std::vector<Term> plus_terms;
+	std::vector<Term> minus_terms;
+
+	// Postings of plus words that passed the predicate and were scored
+	size_t documents_scored = 0;
+	// Postings of plus words rejected by the predicate
+	size_t documents_filtered = 0;
+	// Postings of plus words in documents outside the intersection of the required words, or in documents
+	// of the intersection excluded by a minus word, neither of which is scored
+	size_t documents_skipped = 0;
+	// Candidates removed because they contain a minus word
+	size_t documents_excluded = 0;
+	// Candidates removed because their positions don't satisfy a quoted phrase or a NEAR operator
+	size_t documents_constrained = 0;
+	size_t candidate_count = 0;
+	size_t result_count = 0;
+
+	Clock::duration parse_time{};
+	Clock::duration score_time{};
+	Clock::duration exclude_time{};
+	Clock::duration sort_time{};
+};
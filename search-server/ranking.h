@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Corpus-wide numbers a ranking needs besides the postings themselves
+struct CorpusStatistics
+{
+	size_t document_count;
+	double average_document_length;
+};
+
+// Corpus size and document frequencies of the plus words of one query. Statistics of several servers
+// are merged and passed back to each of them, so that every part of a split collection ranks its documents
+// with the weights the whole collection would give
+struct QueryStatistics
+{
+	size_t document_count = 0;
+	uint64_t word_count = 0;
+	std::map<std::string, size_t, std::less<>> document_freqs;
+
+	void Merge(const QueryStatistics& other);
+	CorpusStatistics GetCorpusStatistics() const;
+	size_t GetDocumentFreq(std::string_view word) const;
+};
+
+// How SearchServer turns term counts into relevance when no ranking is passed explicitly
+enum class RankingFunction
+{
+	TF_IDF,
+	BM25,
+	BM25_PLUS,
+};
+
+// A ranking is a policy passed to FindTopDocuments by value, so its functions are inlined into the scoring loop.
+// It must provide
+//     double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const;
+// called once per query word, and
+//     double ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const;
+// called for every posting of that word. Document relevance is the sum of the scores of its postings
+struct TfIdfRanking
+{
+	double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const;
+	double ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const;
+};
+
+struct Bm25Ranking
+{
+	double k1 = 1.2;
+	double b = 0.75;
+
+	double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const;
+	double ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const;
+};
+
+// BM25 with a lower bound delta on the contribution of a matched word, so that long documents
+// are not pushed below short ones that don't contain the word at all, and an optional boost
+// of rating_boost per rating point applied as a factor to the whole document
+struct Bm25PlusRanking
+{
+	double k1 = 1.2;
+	double b = 0.75;
+	double delta = 1.0;
+	double rating_boost = 0.0;
+
+	double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const;
+	double ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const;
+};
+
+inline double TfIdfRanking::ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const
+{
+	return std::log(corpus.document_count * 1.0 / document_freq);
+}
+
+inline double TfIdfRanking::ComputeScore([[maybe_unused]] const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, [[maybe_unused]] int rating) const
+{
+	const double term_freq = static_cast<double>(term_count) / document_length;
+	return term_freq * term_weight;
+}
+
+inline double ComputeBm25TermFreq(const CorpusStatistics& corpus, double k1, double b, uint32_t term_count, int document_length)
+{
+	const double average_length = corpus.average_document_length > 0.0 ? corpus.average_document_length : 1.0;
+	const double length_norm = 1.0 - b + b * document_length / average_length;
+	return term_count * (k1 + 1.0) / (term_count + k1 * length_norm);
+}
+
+inline double Bm25Ranking::ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const
+{
+	// The "+ 1" keeps the weight positive for words that occur in more than half of the documents
+	return std::log(1.0 + (corpus.document_count - static_cast<double>(document_freq) + 0.5) / (document_freq + 0.5));
+}
+
+inline double Bm25Ranking::ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, [[maybe_unused]] int rating) const
+{
+	return term_weight * ComputeBm25TermFreq(corpus, k1, b, term_count, document_length);
+}
+
+inline double Bm25PlusRanking::ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const
+{
+	return std::log((corpus.document_count + 1.0) / document_freq);
+}
+
+inline double Bm25PlusRanking::ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const
+{
+	const double rating_factor = std::max(0.0, 1.0 + rating_boost * rating);
+	return term_weight * (ComputeBm25TermFreq(corpus, k1, b, term_count, document_length) + delta) * rating_factor;
+}
+
+inline void QueryStatistics::Merge(const QueryStatistics& other)
+{
+	document_count += other.document_count;
+	word_count += other.word_count;
+	for (const auto& [word, document_freq] : other.document_freqs)
+	{
+		document_freqs[word] += document_freq;
+	}
+}
+
+inline CorpusStatistics QueryStatistics::GetCorpusStatistics() const
+{
+	return { document_count, document_count == 0 ? 0.0 : static_cast<double>(word_count) / document_count };
+}
+
+inline size_t QueryStatistics::GetDocumentFreq(std::string_view word) const
+{
+	const auto document_freq = document_freqs.find(word);
+	return document_freq == document_freqs.end() ? 0 : document_freq->second;
+}
@@ -4,15 +4,14 @@ using std::string_literals::operator""s;
 
 void RemoveDuplicates(SearchServer& search_server)
 {
-	std::map<std::set<std::string>, std::vector<int>> doc_to_del;
+	std::map<std::vector<int>, std::vector<int>> doc_to_del;
 	std::set<int> remove_docs;
 	for (const int document_id : search_server)
 	{
-		std::set<std::string> words;
-		std::map<std::string, double> word_with_freq = search_server.GetWordFrequencies(document_id);
-		for (auto [word, freq] : word_with_freq)
+		std::vector<int> words;
+		for (const SearchServer::TermCount& term : search_server.GetDocumentTerms(document_id))
 		{
-			words.insert(word);
+			words.push_back(term.term_id);
 		}
 		
 		if (doc_to_del.count(words) == 0)
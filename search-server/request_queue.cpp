@@ -1,8 +1,21 @@
 #include "request_queue.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+#include <algorithm>
+
+RequestQueue::RequestQueue(const SearchServer& search_server, QueryStorage query_storage)
 	: server_(search_server)
-{}
+	, query_storage_(query_storage)
+{
+	for (auto& slot : slots_)
+	{
+		slot.store(0, std::memory_order_relaxed);
+	}
+	if (query_storage_ == QueryStorage::KEEP)
+	{
+		queries_.resize(min_in_day_);
+		query_sequences_.resize(min_in_day_, 0);
+	}
+}
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status)
 {
@@ -20,12 +33,78 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 
 int RequestQueue::GetNoResultRequests() const
 {
-	return (std::accumulate(requests_.begin(), requests_.end(), 0, [](int sum, const QueryResult& elem)
+	return no_result_count_.load(std::memory_order_relaxed);
+}
+
+std::vector<std::string> RequestQueue::GetStoredQueries() const
+{
+	std::vector<std::string> result;
+	if (query_storage_ == QueryStorage::NONE)
+	{
+		return result;
+	}
+
+	std::lock_guard guard(queries_mutex_);
+	std::vector<size_t> order;
+	for (size_t index = 0; index < query_sequences_.size(); ++index)
+	{
+		if (query_sequences_[index] != 0)
 		{
-			if (elem.num_of_results == 0)
-			{
-				++sum;
-			}
-			return sum;
-		}));
+			order.push_back(index);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs)
+		{
+			return query_sequences_[lhs] < query_sequences_[rhs];
+		});
+	result.reserve(order.size());
+	for (const size_t index : order)
+	{
+		result.push_back(queries_[index]);
+	}
+	return result;
+}
+
+const RequestStatistics& RequestQueue::GetStatistics() const
+{
+	return statistics_;
+}
+
+void RequestQueue::RecordRequest(const std::string& raw_query, size_t result_count)
+{
+	const uint64_t sequence = next_request_.fetch_add(1, std::memory_order_relaxed);
+	const uint64_t state = ((sequence + 1) << 1) | (result_count == 0 ? NO_RESULT_FLAG : 0);
+	auto& slot = slots_[sequence % min_in_day_];
+
+	uint64_t previous = slot.load(std::memory_order_relaxed);
+	do
+	{
+		// A request that arrived a full window later already owns the slot, so this one has left the window
+		if (previous > state)
+		{
+			return;
+		}
+	} while (!slot.compare_exchange_weak(previous, state, std::memory_order_relaxed));
+
+	const int delta = static_cast<int>(state & NO_RESULT_FLAG) - static_cast<int>(previous & NO_RESULT_FLAG);
+	if (delta != 0)
+	{
+		no_result_count_.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	if (query_storage_ == QueryStorage::KEEP)
+	{
+		StoreQuery(sequence, raw_query);
+	}
+}
+
+void RequestQueue::StoreQuery(uint64_t sequence, const std::string& raw_query)
+{
+	const size_t index = sequence % min_in_day_;
+	std::lock_guard guard(queries_mutex_);
+	if (query_sequences_[index] <= sequence + 1)
+	{
+		query_sequences_[index] = sequence + 1;
+		queries_[index] = raw_query;
+	}
 }
@@ -2,42 +2,69 @@
 
 #include "document.h"
 #include "search_server.h"
+#include "request_statistics.h"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <deque>
-#include <numeric>
 
+// Keeps the outcome of the last min_in_day_ requests. AddFindRequest may be called from several threads:
+// every request takes a sequence number and publishes its result count into a fixed ring slot with
+// a single compare-exchange, while the number of requests without results is adjusted incrementally.
+// Latencies and result counts are also kept per second and per minute of wall-clock time
 class RequestQueue
 {
 public:
-	explicit RequestQueue(const SearchServer& search_server);
+	enum class QueryStorage
+	{
+		NONE,
+		// Keeps the text of the requests in the window, at the cost of a lock and a copy per request
+		KEEP,
+	};
+
+	explicit RequestQueue(const SearchServer& search_server, QueryStorage query_storage = QueryStorage::NONE);
 
 	template <typename DocumentPredicate>
 	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
 	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
 	std::vector<Document> AddFindRequest(const std::string& raw_query);
 	int GetNoResultRequests() const;
+	// Texts of the requests in the window from the oldest to the newest, empty unless QueryStorage::KEEP
+	std::vector<std::string> GetStoredQueries() const;
+	const RequestStatistics& GetStatistics() const;
 
 private:
-	struct QueryResult
-	{
-		std::string query;
-		int num_of_results;
-	};
-	const SearchServer& server_;
-	std::deque<QueryResult> requests_;
 	const static int min_in_day_ = 1440;
+	// Slot state: (sequence number + 1) shifted left by one, the low bit is set when the request found nothing.
+	// Zero marks a slot that was never written
+	static constexpr uint64_t NO_RESULT_FLAG = 1;
+
+	const SearchServer& server_;
+	const QueryStorage query_storage_;
+	std::array<std::atomic<uint64_t>, min_in_day_> slots_;
+	alignas(64) std::atomic<uint64_t> next_request_{ 0 };
+	alignas(64) std::atomic<int> no_result_count_{ 0 };
+
+	mutable std::mutex queries_mutex_;
+	std::vector<std::string> queries_;
+	std::vector<uint64_t> query_sequences_;
+
+	RequestStatistics statistics_;
+
+	void RecordRequest(const std::string& raw_query, size_t result_count);
+	void StoreQuery(uint64_t sequence, const std::string& raw_query);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate)
 {
+	const auto start = RequestStatistics::Clock::now();
 	std::vector<Document> search_result = server_.FindTopDocuments(raw_query, document_predicate);
-	if (requests_.size() >= min_in_day_)
-	{
-		requests_.pop_front();
-	}
-	requests_.push_back({ raw_query, static_cast<int>(search_result.size()) });
+	const auto finish = RequestStatistics::Clock::now();
+	statistics_.Record(finish, finish - start, search_result.size());
+	RecordRequest(raw_query, search_result.size());
 	return search_result;
 }
@@ -0,0 +1,116 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+
+RequestStatistics::RequestStatistics()
+{
+	for (Ring* ring : { &seconds_, &minutes_ })
+	{
+		for (Bucket& bucket : *ring)
+		{
+			bucket.period.store(EMPTY_PERIOD, std::memory_order_relaxed);
+		}
+	}
+}
+
+void RequestStatistics::Record(Clock::time_point time, Clock::duration latency, size_t result_count)
+{
+	const uint64_t latency_us = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+	RecordTo(seconds_, GetPeriod(Window::MINUTE, time), latency_us, result_count);
+	RecordTo(minutes_, GetPeriod(Window::HOUR, time), latency_us, result_count);
+}
+
+Histogram RequestStatistics::GetLatencyHistogram(Window window, Clock::time_point now) const
+{
+	return Collect(window, now, &Histograms::latency);
+}
+
+Histogram RequestStatistics::GetResultCountHistogram(Window window, Clock::time_point now) const
+{
+	return Collect(window, now, &Histograms::result_count);
+}
+
+RequestStatistics::Summary RequestStatistics::GetLatencySummary(Window window, Clock::time_point now) const
+{
+	return Summarize(GetLatencyHistogram(window, now));
+}
+
+RequestStatistics::Summary RequestStatistics::GetResultCountSummary(Window window, Clock::time_point now) const
+{
+	return Summarize(GetResultCountHistogram(window, now));
+}
+
+void RequestStatistics::RecordTo(Ring& ring, int64_t period, uint64_t latency, size_t result_count)
+{
+	Bucket& bucket = ring[static_cast<size_t>(period) % RING_SIZE];
+	if (bucket.period.load(std::memory_order_acquire) != period)
+	{
+		// Requests reaching the bucket while it is cleared wait for the clearing one
+		std::lock_guard guard(bucket.mutex);
+		const int64_t current = bucket.period.load(std::memory_order_relaxed);
+		if (current > period)
+		{
+			// The bucket already serves a later period, this request is too old to be counted
+			return;
+		}
+		if (current < period)
+		{
+			bucket.period.store(CLEARING_PERIOD, std::memory_order_relaxed);
+			if (bucket.histograms)
+			{
+				bucket.histograms->latency.Clear();
+				bucket.histograms->result_count.Clear();
+			}
+			else
+			{
+				bucket.histograms = std::make_unique<Histograms>();
+			}
+			bucket.period.store(period, std::memory_order_release);
+		}
+	}
+
+	bucket.histograms->latency.Add(latency);
+	bucket.histograms->result_count.Add(result_count);
+}
+
+int64_t RequestStatistics::GetPeriod(Window window, Clock::time_point time)
+{
+	const auto since_epoch = time.time_since_epoch();
+	if (window == Window::MINUTE)
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+	}
+	return std::chrono::duration_cast<std::chrono::minutes>(since_epoch).count();
+}
+
+const RequestStatistics::Ring& RequestStatistics::GetRing(Window window) const
+{
+	return window == Window::MINUTE ? seconds_ : minutes_;
+}
+
+template <typename Member>
+Histogram RequestStatistics::Collect(Window window, Clock::time_point now, Member member) const
+{
+	const int64_t last_period = GetPeriod(window, now);
+	Histogram histogram;
+	for (const Bucket& bucket : GetRing(window))
+	{
+		const int64_t period = bucket.period.load(std::memory_order_acquire);
+		if (period != EMPTY_PERIOD && period != CLEARING_PERIOD
+			&& period <= last_period && period > last_period - static_cast<int64_t>(RING_SIZE))
+		{
+			(bucket.histograms.get()->*member).AddTo(histogram);
+		}
+	}
+	return histogram;
+}
+
+RequestStatistics::Summary RequestStatistics::Summarize(const Histogram& histogram)
+{
+	Summary summary;
+	summary.count = histogram.GetCount();
+	summary.p50 = histogram.GetValueAtPercentile(50.0);
+	summary.p95 = histogram.GetValueAtPercentile(95.0);
+	summary.p99 = histogram.GetValueAtPercentile(99.0);
+	return summary;
+}
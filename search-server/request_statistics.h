@@ -0,0 +1,81 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Latency and result count distributions of requests over wall-clock windows.
+// Requests are recorded into a ring of per-second buckets and a ring of per-minute buckets. Within a period
+// a request is one relaxed increment per histogram; the first request of a new period clears the bucket
+// under its mutex, and the histograms of a bucket are only allocated when a request first reaches it
+class RequestStatistics
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class Window
+	{
+		// The last RING_SIZE seconds
+		MINUTE,
+		// The last RING_SIZE minutes
+		HOUR,
+	};
+
+	struct Summary
+	{
+		uint64_t count = 0;
+		uint64_t p50 = 0;
+		uint64_t p95 = 0;
+		uint64_t p99 = 0;
+	};
+
+	static constexpr size_t RING_SIZE = 60;
+
+	RequestStatistics();
+
+	void Record(Clock::time_point time, Clock::duration latency, size_t result_count);
+
+	// Latencies are reported in microseconds
+	Histogram GetLatencyHistogram(Window window, Clock::time_point now = Clock::now()) const;
+	Histogram GetResultCountHistogram(Window window, Clock::time_point now = Clock::now()) const;
+	Summary GetLatencySummary(Window window, Clock::time_point now = Clock::now()) const;
+	Summary GetResultCountSummary(Window window, Clock::time_point now = Clock::now()) const;
+
+private:
+	struct Histograms
+	{
+		AtomicHistogram latency;
+		AtomicHistogram result_count;
+	};
+
+	struct Bucket
+	{
+		std::atomic<int64_t> period;
+		// Set once before the first period is stored, which publishes it to the threads loading the period
+		std::unique_ptr<Histograms> histograms;
+		// Taken only to move the bucket to a new period
+		std::mutex mutex;
+	};
+
+	using Ring = std::array<Bucket, RING_SIZE>;
+
+	// A bucket that was never used, and a bucket that is being cleared for a new period
+	static constexpr int64_t EMPTY_PERIOD = INT64_MIN;
+	static constexpr int64_t CLEARING_PERIOD = INT64_MIN + 1;
+
+	Ring seconds_;
+	Ring minutes_;
+
+	static void RecordTo(Ring& ring, int64_t period, uint64_t latency, size_t result_count);
+	static int64_t GetPeriod(Window window, Clock::time_point time);
+	const Ring& GetRing(Window window) const;
+	template <typename Member>
+	Histogram Collect(Window window, Clock::time_point now, Member member) const;
+	static Summary Summarize(const Histogram& histogram);
+};
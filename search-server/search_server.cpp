@@ -1,14 +1,48 @@
 #include "search_server.h"
+#include "print_functions.h"
+
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <thread>
 
 using std::string_literals::operator""s;
 
-SearchServer::SearchServer(const std::string& stopWords)
+DuplicateDocumentError::DuplicateDocumentError(int document_id, int original_id)
+	: std::invalid_argument("Документ "s + std::to_string(document_id) + " является дубликатом документа "s + std::to_string(original_id))
+	, document_id_(document_id)
+	, original_id_(original_id)
+{}
+
+int DuplicateDocumentError::GetDocumentId() const
+{
+	return document_id_;
+}
+
+int DuplicateDocumentError::GetOriginalId() const
+{
+	return original_id_;
+}
+
+SearchServer::SearchServer(std::pmr::memory_resource* resource)
+	: index_resource_(std::make_unique<std::pmr::synchronized_pool_resource>(resource))
+	, word_to_term_id_(index_resource_.get())
+	, term_words_(index_resource_.get())
+	, term_postings_(index_resource_.get())
+	, term_dictionary_(index_resource_.get())
+	, documents_(index_resource_.get())
+	, document_ids_(index_resource_.get())
+{}
+
+SearchServer::SearchServer(const std::string& stopWords, std::pmr::memory_resource* resource)
+	: SearchServer(resource)
 {
 	SetStopWords(SplitIntoWords(stopWords));
 }
 
 void SearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings)
 {
+	PROFILE_SCOPE("AddDocument");
 	std::string error = ""s;
 	if (document_id < 0)
 	{
@@ -24,17 +58,146 @@ void SearchServer::AddDocument(int document_id, const std::string_view& document
 	}
 
 	const auto words = SplitIntoWordsNoStop(document);
-	std::vector<std::string> words_std(words.begin(), words.end());
-	const double inv_word_count = 1.0 / words.size();
 
-	documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, words_std });
+	uint64_t fingerprint = 0;
+	if (duplicate_mode_ != DuplicateMode::OFF)
+	{
+		std::vector<std::string_view> unique_words = words;
+		SortAndUnique(unique_words);
+		fingerprint = ComputeFingerprint(unique_words);
+		if (duplicate_mode_ == DuplicateMode::REJECT)
+		{
+			const auto original_id = FindDuplicate(fingerprint, unique_words);
+			if (original_id)
+			{
+				throw DuplicateDocumentError(document_id, *original_id);
+			}
+		}
+	}
+
+	std::map<std::string_view, uint32_t> word_counts;
+	for (const std::string_view& word : words)
+	{
+		++word_counts[word];
+	}
 
-	for (const std::string& word : documents_.at(document_id).doc_words)
+	auto& document_data = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, static_cast<int>(words.size()), fingerprint, DocumentTerms(index_resource_.get()), DocumentPositions(index_resource_.get()) }).first->second;
+	document_data.terms.reserve(word_counts.size());
+	for (const auto [word, term_count] : word_counts)
 	{
-		word_to_document_freqs_[word][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][word] += inv_word_count;
+		const int term_id = AddTerm(word);
+		term_postings_[term_id].Add(document_id, term_count);
+		document_data.terms.push_back({ term_id, term_count });
+	}
+	std::sort(document_data.terms.begin(), document_data.terms.end(), [](const TermCount& lhs, const TermCount& rhs)
+		{
+			return lhs.term_id < rhs.term_id;
+		});
+	if (positional_index_)
+	{
+		// Positions count the stop words too, so that a phrase with a stop word inside matches only the same gap
+		std::map<std::string_view, std::vector<uint32_t>> word_positions;
+		uint32_t position = 0;
+		for (const std::string_view& word : SplitIntoWords(document))
+		{
+			if (!IsStopWord(word))
+			{
+				word_positions[word].push_back(position);
+			}
+			++position;
+		}
+		for (const TermCount& term : document_data.terms)
+		{
+			document_data.positions.AddTerm(word_positions.at(term_words_[term.term_id]));
+		}
 	}
+	total_word_count_ += words.size();
 	document_ids_.insert(document_id);
+
+	if (duplicate_mode_ != DuplicateMode::OFF)
+	{
+		AddFingerprint(document_id, fingerprint);
+	}
+}
+
+void SearchServer::SetDuplicateMode(DuplicateMode mode)
+{
+	if (mode == DuplicateMode::OFF)
+	{
+		fingerprint_to_documents_.clear();
+	}
+	else if (duplicate_mode_ == DuplicateMode::OFF)
+	{
+		// The fingerprint index is not maintained while the mode is off, so rebuild it from the forward index
+		for (auto& [document_id, document_data] : documents_)
+		{
+			std::vector<std::string_view> unique_words;
+			for (const TermCount& term : document_data.terms)
+			{
+				unique_words.push_back(term_words_[term.term_id]);
+			}
+			std::sort(unique_words.begin(), unique_words.end());
+			document_data.fingerprint = ComputeFingerprint(unique_words);
+			AddFingerprint(document_id, document_data.fingerprint);
+		}
+	}
+	duplicate_mode_ = mode;
+}
+
+DuplicateMode SearchServer::GetDuplicateMode() const
+{
+	return duplicate_mode_;
+}
+
+void SearchServer::SetPositionalIndex(bool enabled)
+{
+	if (enabled != positional_index_ && !documents_.empty())
+	{
+		throw std::logic_error("Позиционный индекс можно включить или выключить только у пустого поискового сервера"s);
+	}
+	positional_index_ = enabled;
+}
+
+bool SearchServer::HasPositionalIndex() const
+{
+	return positional_index_;
+}
+
+void SearchServer::SetMaxPrefixExpansions(size_t count)
+{
+	max_prefix_expansions_ = count;
+}
+
+size_t SearchServer::GetMaxPrefixExpansions() const
+{
+	return max_prefix_expansions_;
+}
+
+void SearchServer::SetRankingFunction(RankingFunction ranking_function)
+{
+	ranking_function_ = ranking_function;
+}
+
+RankingFunction SearchServer::GetRankingFunction() const
+{
+	return ranking_function_;
+}
+
+CorpusStatistics SearchServer::GetCorpusStatistics() const
+{
+	const size_t document_count = GetDocumentCount();
+	return { document_count, document_count == 0 ? 0.0 : static_cast<double>(total_word_count_) / document_count };
+}
+
+std::optional<int> SearchServer::FindDuplicate(const std::string_view& document) const
+{
+	if (duplicate_mode_ == DuplicateMode::OFF)
+	{
+		throw std::logic_error("Поиск дубликатов невозможен при выключенном DuplicateMode"s);
+	}
+	std::vector<std::string_view> unique_words = SplitIntoWordsNoStop(document);
+	SortAndUnique(unique_words);
+	return FindDuplicate(ComputeFingerprint(unique_words), unique_words);
 }
 
 
@@ -58,44 +221,181 @@ size_t SearchServer::GetDocumentCount() const
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const
 {
-	//return MatchDocument(std::execution::seq, raw_query, document_id);
-	const auto query = ParseQuery(raw_query);
-	std::vector<std::string_view> matched_words;
+	PROFILE_SCOPE("MatchDocument");
+	const QueryArena::Scope scratch;
+	const auto query = ParseQuery(raw_query, scratch.GetResource());
 
-	if (documents_.count(document_id) == 0)
+	const auto document = documents_.find(document_id);
+	if (document == documents_.end())
 	{
 		throw std::out_of_range("Document out of range");
 	}
 
-	bool isMinus = false;
+	const ResolvedQuery resolved = ResolveQuery(query, scratch.GetResource());
+	std::vector<std::string_view> matched_words(resolved.plus_terms.size());
+	PositionBuffers buffers(scratch.GetResource());
+	matched_words.resize(MatchResolvedQuery(resolved, document->second, buffers, matched_words.data()));
+	return { matched_words, document->second.status };
+}
 
+MatchedDocuments SearchServer::MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+	return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+	return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+	return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(AdaptivePolicy policy, std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+	return MatchDocumentsImpl(policy, raw_query, document_ids);
+}
+
+void SearchServer::SetExecutionThresholds(const ExecutionThresholds& thresholds)
+{
+	execution_thresholds_ = thresholds;
+}
+
+const ExecutionThresholds& SearchServer::GetExecutionThresholds() const
+{
+	return execution_thresholds_ ? *execution_thresholds_ : GetCalibratedExecutionThresholds();
+}
+
+ExecutionPlan SearchServer::PlanExecution(std::string_view raw_query) const
+{
+	const QueryArena::Scope scratch;
+	Query query = ParseQuery(raw_query, scratch.GetResource());
+	ExpandPrefixes(query);
+	return PlanExecution(query);
+}
+
+ExecutionPlan SearchServer::PlanExecution(const Query& query) const
+{
+	ExecutionPlan plan;
+	size_t plus_word_count = 0;
+	for (const std::string_view& word : query.plus_words)
+	{
+		if (const PostingList* postings = FindPostings(query, word))
+		{
+			plan.posting_count += postings->size();
+			++plus_word_count;
+		}
+	}
 	for (const std::string_view& word : query.minus_words)
 	{
-		if (word_to_document_freqs_.count(word) > 0 &&
-			word_to_document_freqs_.at(word).count(document_id) > 0)
+		if (const PostingList* postings = FindPostings(query, word))
 		{
-			matched_words.clear();
-			isMinus = true;
-			break;
+			plan.posting_count += postings->size();
 		}
 	}
-	if (!isMinus)
+
+	// The parallel search splits the work by plus words, a single word would run on one thread anyway
+	const int hardware_threads = static_cast<int>(std::thread::hardware_concurrency());
+	const ExecutionThresholds& thresholds = GetExecutionThresholds();
+	if (hardware_threads <= 1 || plus_word_count < 2 || plan.posting_count < thresholds.parallel_postings)
+	{
+		return plan;
+	}
+	plan.parallel = true;
+	const size_t per_worker = std::max<size_t>(1, thresholds.postings_per_worker);
+	plan.worker_count = static_cast<int>(std::clamp<size_t>(plan.posting_count / per_worker, 2, hardware_threads));
+	return plan;
+}
+
+const ExecutionThresholds& SearchServer::GetCalibratedExecutionThresholds()
+{
+	static const ExecutionThresholds thresholds = CalibrateExecutionThresholds();
+	return thresholds;
+}
+
+void SearchServer::Calibrate()
+{
+	GetCalibratedExecutionThresholds();
+}
+
+ExecutionThresholds SearchServer::CalibrateExecutionThresholds()
+{
+	ExecutionThresholds thresholds;
+	if (std::thread::hardware_concurrency() <= 1)
+	{
+		return thresholds;
+	}
+
+	// Word wN occurs in every (DOCUMENT_COUNT / 2^N)-th document, which gives posting lists from 16 to 16384 long
+	const int DOCUMENT_COUNT = 16384;
+	const int WORD_COUNT = 11;
+	SearchServer server;
+	for (int id = 0; id < DOCUMENT_COUNT; ++id)
 	{
-		for (const std::string_view& word : query.plus_words)
+		std::string text = "d"s + std::to_string(id);
+		for (int word = 0; word < WORD_COUNT; ++word)
 		{
-			if (word_to_document_freqs_.count(word) > 0 &&
-				word_to_document_freqs_.at(word).count(document_id) > 0)
+			if (id % (DOCUMENT_COUNT >> (4 + word)) == 0)
 			{
-				matched_words.push_back(word);
+				text += " w"s + std::to_string(word);
 			}
 		}
+		server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+	}
+	// Explicit thresholds keep the calibration server from calibrating itself
+	server.SetExecutionThresholds(thresholds);
+
+	const auto fastest = [](auto operation)
+	{
+		auto best = std::chrono::steady_clock::duration::max();
+		for (int run = 0; run < 5; ++run)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			operation();
+			best = std::min(best, std::chrono::steady_clock::now() - start);
+		}
+		return best;
+	};
+
+	// Four words of equal length, so both variants see the same number of postings per query
+	for (int word = 0; word + 3 < WORD_COUNT; ++word)
+	{
+		std::string query;
+		for (int offset = 0; offset < 4; ++offset)
+		{
+			query += " w"s + std::to_string(word + offset);
+		}
+		const auto sequential = fastest([&]() { server.FindTopDocuments(std::execution::seq, query); });
+		const auto parallel = fastest([&]() { server.FindTopDocuments(std::execution::par, query); });
+		if (parallel < sequential)
+		{
+			thresholds.parallel_postings = server.PlanExecution(query).posting_count;
+			thresholds.postings_per_worker = std::max<size_t>(1, thresholds.parallel_postings / 2);
+			break;
+		}
+	}
+
+	for (size_t document_count = 16; document_count <= static_cast<size_t>(DOCUMENT_COUNT); document_count *= 4)
+	{
+		std::vector<int> document_ids(document_count);
+		std::iota(document_ids.begin(), document_ids.end(), 0);
+		const std::string query = "w0 w5 w10 -w3"s;
+		const auto sequential = fastest([&]() { server.MatchDocuments(std::execution::seq, query, document_ids); });
+		const auto parallel = fastest([&]() { server.MatchDocuments(std::execution::par, query, document_ids); });
+		if (parallel < sequential)
+		{
+			thresholds.parallel_match_pairs = document_count * 4;
+			break;
+		}
 	}
-	return { matched_words, documents_.at(document_id).status };
+	return thresholds;
 }
 
 [[nodiscard]] bool SearchServer::IsStopWord(const std::string_view& word) const
 {
-	return stop_words_.count(static_cast<std::string>(word)) > 0;
+	return stop_words_.count(word) > 0;
 }
 
 [[nodiscard]] bool SearchServer::IsValidWord(const std::string_view& word) const
@@ -142,39 +442,380 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view& tex
 	}
 	std::string_view word = text;
 	bool is_minus = false;
+	bool is_required = false;
 	if (word[0] == '-')
 	{
 		is_minus = true;
 		word = word.substr(1);
 	}
-	if (word.empty() || word[0] == '-' || !IsValidWord(word))
+	else if (word[0] == '+')
+	{
+		is_required = true;
+		word = word.substr(1);
+	}
+	if (word.empty() || word[0] == '-' || word[0] == '+' || !IsValidWord(word))
+	{
+		throw std::invalid_argument("Query word "s + std::string(text) + " is invalid"s);
+	}
+	const bool is_prefix = word.size() > 1 && word.back() == '*';
+	if (is_prefix && word[word.size() - 2] == '*')
 	{
 		throw std::invalid_argument("Query word "s + std::string(text) + " is invalid"s);
 	}
 
-	return { word, is_minus, IsStopWord(word) };
+	return { word, is_minus, !is_prefix && IsStopWord(word), is_required, is_prefix };
+}
+
+void SearchServer::ParsePositionConstraints(std::pmr::vector<std::string_view>& words, Query& query) const
+{
+	const auto is_phrase_start = [](std::string_view word)
+	{
+		return word.substr(0, 1) == "\"" || word.substr(0, 2) == "-\"";
+	};
+	const auto is_near = [](std::string_view word)
+	{
+		return word.substr(0, 5) == "NEAR/";
+	};
+	if (std::none_of(words.begin(), words.end(), [&](std::string_view word)
+		{
+			return is_phrase_start(word) || is_near(word);
+		}))
+	{
+		return;
+	}
+	if (!positional_index_)
+	{
+		throw std::invalid_argument("Phrase and NEAR queries require the positional index"s);
+	}
+
+	std::pmr::memory_resource* resource = words.get_allocator().resource();
+	std::pmr::vector<std::string_view> plain_words(resource);
+	// The previous word when it was a plain plus word, the left operand of NEAR
+	std::optional<std::string_view> near_operand;
+	for (size_t index = 0; index < words.size(); ++index)
+	{
+		std::string_view word = words[index];
+		if (is_phrase_start(word))
+		{
+			PositionConstraint phrase(resource);
+			phrase.is_minus = word[0] == '-';
+			word.remove_prefix(phrase.is_minus ? 2 : 1);
+			for (uint32_t offset = 0;; ++offset)
+			{
+				const bool is_last = !word.empty() && word.back() == '"';
+				if (is_last)
+				{
+					word.remove_suffix(1);
+				}
+				if (!word.empty())
+				{
+					const QueryWord query_word = ParseQueryWord(word);
+					if (query_word.is_minus || query_word.is_prefix)
+					{
+						throw std::invalid_argument("Query phrase must not contain minus or prefix word "s + std::string(word));
+					}
+					if (!query_word.is_stop)
+					{
+						phrase.words.push_back(query_word.data);
+						phrase.offsets.push_back(offset);
+						if (!phrase.is_minus)
+						{
+							plain_words.push_back(query_word.data);
+						}
+					}
+				}
+				if (is_last)
+				{
+					break;
+				}
+				if (++index == words.size())
+				{
+					throw std::invalid_argument("Query phrase is not closed"s);
+				}
+				word = words[index];
+			}
+			// A phrase of stop words only constrains nothing
+			if (!phrase.words.empty())
+			{
+				const uint32_t first_offset = phrase.offsets.front();
+				for (uint32_t& offset : phrase.offsets)
+				{
+					offset -= first_offset;
+				}
+				query.constraints.push_back(std::move(phrase));
+			}
+			near_operand.reset();
+		}
+		else if (is_near(word))
+		{
+			uint32_t max_distance = 0;
+			const std::string_view distance = word.substr(5);
+			const auto [end, error] = std::from_chars(distance.data(), distance.data() + distance.size(), max_distance);
+			if (error != std::errc() || end != distance.data() + distance.size() || max_distance == 0)
+			{
+				throw std::invalid_argument("Query operator "s + std::string(word) + " is invalid"s);
+			}
+			if (!near_operand || index + 1 == words.size() || is_phrase_start(words[index + 1]) || is_near(words[index + 1]))
+			{
+				throw std::invalid_argument("Query operator "s + std::string(word) + " must stand between two plus words"s);
+			}
+			const QueryWord right = ParseQueryWord(words[++index]);
+			if (right.is_minus)
+			{
+				throw std::invalid_argument("Query operator "s + std::string(word) + " must stand between two plus words"s);
+			}
+			if (right.is_prefix || near_operand->back() == '*')
+			{
+				throw std::invalid_argument("Query operator "s + std::string(word) + " does not accept prefix words"s);
+			}
+			// Stop words are not indexed, a proximity to them is ignored like the stop words themselves
+			if (!IsStopWord(*near_operand) && !right.is_stop)
+			{
+				PositionConstraint near(resource);
+				near.words.push_back(*near_operand);
+				near.words.push_back(right.data);
+				near.max_distance = max_distance;
+				query.constraints.push_back(std::move(near));
+			}
+			plain_words.push_back(right.data);
+			near_operand = right.data;
+		}
+		else
+		{
+			plain_words.push_back(word);
+			if (word[0] == '-')
+			{
+				near_operand.reset();
+			}
+			else
+			{
+				near_operand = word[0] == '+' ? word.substr(1) : word;
+			}
+		}
+	}
+	words = std::move(plain_words);
+}
+
+SearchServer::Query SearchServer::ParseQuery(const std::string_view& text, std::pmr::memory_resource* resource) const
+{
+	return ParseQuery(std::execution::seq, text, resource);
+}
+
+void SearchServer::TraceQuery(const std::string_view& raw_query, const Query& query, QueryTrace& trace) const
+{
+	for (const std::string_view& word : SplitIntoWords(raw_query))
+	{
+		const QueryWord query_word = ParseQueryWord(word);
+		if (query_word.is_stop)
+		{
+			trace.stop_words.emplace_back(query_word.data);
+		}
+	}
+	std::sort(trace.stop_words.begin(), trace.stop_words.end());
+	trace.stop_words.erase(std::unique(trace.stop_words.begin(), trace.stop_words.end()), trace.stop_words.end());
+
+	for (const std::string_view& word : query.plus_words)
+	{
+		trace.plus_terms.push_back({ std::string(word) });
+	}
+	for (const std::string_view& word : query.minus_words)
+	{
+		trace.minus_terms.push_back({ std::string(word) });
+	}
+}
+
+void SearchServer::TracePlusTerm(QueryTrace::Term& term, size_t posting_count, double weight, size_t scored_count, size_t filtered_count)
+{
+	term.posting_count = posting_count;
+	term.weight = weight;
+	term.documents_scored = scored_count;
+	term.documents_filtered = filtered_count;
+	term.documents_skipped = posting_count - scored_count - filtered_count;
+}
+
+void SearchServer::TraceMinusTerm(QueryTrace::Term& term, size_t posting_count, size_t excluded_count)
+{
+	term.posting_count = posting_count;
+	term.documents_excluded = excluded_count;
+}
+
+void SearchServer::SumTrace(QueryTrace& trace)
+{
+	for (const QueryTrace::Term& term : trace.plus_terms)
+	{
+		trace.documents_scored += term.documents_scored;
+		trace.documents_filtered += term.documents_filtered;
+		trace.documents_skipped += term.documents_skipped;
+	}
+	for (const QueryTrace::Term& term : trace.minus_terms)
+	{
+		trace.documents_excluded += term.documents_excluded;
+	}
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, QueryTrace& trace) const
+{
+	return FindTopDocuments(std::execution::seq, raw_query, [](int document_id, DocumentStatus document_status, int rating)
+		{
+			return document_status == DocumentStatus::ACTUAL;
+		}, trace);
+}
+
+QueryStatistics SearchServer::GetQueryStatistics(const std::string_view& raw_query) const
+{
+	const QueryArena::Scope scratch;
+	Query query = ParseQuery(raw_query, scratch.GetResource());
+	ExpandPrefixes(query);
+	QueryStatistics statistics;
+	statistics.document_count = GetDocumentCount();
+	statistics.word_count = total_word_count_;
+	// Words missing from this server are listed too, they may occur in the others
+	for (const std::string_view& word : query.plus_words)
+	{
+		const PostingList* postings = FindPostings(query, word);
+		statistics.document_freqs.emplace(word, postings == nullptr ? 0 : postings->size());
+	}
+	return statistics;
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs)
+{
+	if (std::abs(lhs.relevance - rhs.relevance) < DEVIATION)
+	{
+		return lhs.rating > rhs.rating;
+	}
+	else
+	{
+		return lhs.relevance > rhs.relevance;
+	}
+}
+
+std::pmr::vector<int> SearchServer::IntersectPostings(std::pmr::vector<const PostingList*>& postings, std::pmr::memory_resource* resource)
+{
+	std::sort(postings.begin(), postings.end(), [](const PostingList* lhs, const PostingList* rhs)
+		{
+			return lhs->size() < rhs->size();
+		});
+	std::pmr::vector<PostingList::ConstIterator> iterators(resource);
+	iterators.reserve(postings.size());
+	for (const PostingList* posting_list : postings)
+	{
+		iterators.push_back(posting_list->begin());
+	}
+
+	// Every longer list is skipped to the candidate of the shortest one. A list passing over it gives a new candidate
+	// to skip the shortest list to, so the work is bounded by the shortest list and skips go through block bounds
+	std::pmr::vector<int> document_ids(resource);
+	document_ids.reserve(postings.front()->size());
+	PostingList::ConstIterator& shortest = iterators.front();
+	const PostingList::ConstIterator shortest_end = postings.front()->end();
+	while (shortest != shortest_end)
+	{
+		const int candidate = shortest->document_id;
+		bool is_common = true;
+		for (size_t index = 1; index < iterators.size(); ++index)
+		{
+			iterators[index].SkipTo(candidate);
+			if (iterators[index] == postings[index]->end())
+			{
+				return document_ids;
+			}
+			if (iterators[index]->document_id != candidate)
+			{
+				shortest.SkipTo(iterators[index]->document_id);
+				is_common = false;
+				break;
+			}
+		}
+		if (is_common)
+		{
+			document_ids.push_back(candidate);
+			++shortest;
+		}
+	}
+	return document_ids;
+}
+
+CorpusStatistics SearchServer::GetCorpusStatistics(const QueryStatistics* statistics) const
+{
+	return statistics == nullptr ? GetCorpusStatistics() : statistics->GetCorpusStatistics();
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const
+size_t SearchServer::GetDocumentFreq(std::string_view word, const PostingList& postings, const QueryStatistics* statistics)
 {
-	return ParseQuery(std::execution::seq, text);
+	// Statistics gathered for another query or before this server grew must not yield a zero frequency
+	return statistics == nullptr ? postings.size() : std::max(postings.size(), statistics->GetDocumentFreq(word));
 }
 
-void SearchServer::SortAndUnique(std::vector<std::string_view>& vec_to_normalize) const
+uint64_t SearchServer::ComputeFingerprint(const std::vector<std::string_view>& unique_words)
 {
-	if (vec_to_normalize.size() > 1)
+	// FNV-1a over the sorted words, each followed by a separator that can't appear inside a word
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::string_view& word : unique_words)
 	{
-		const auto& begin_iter = vec_to_normalize.begin();
-		const auto& end_iter = vec_to_normalize.end();
-		std::sort(begin_iter, end_iter);
-		auto it_pl = std::unique(begin_iter, end_iter);
-		vec_to_normalize.resize(it_pl - begin_iter);
+		for (const char c : word)
+		{
+			hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		}
+		hash = (hash ^ static_cast<unsigned char>(' ')) * 1099511628211ull;
 	}
+	return hash;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word) const
+std::optional<int> SearchServer::FindDuplicate(uint64_t fingerprint, const std::vector<std::string_view>& unique_words) const
 {
-	return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+	const auto candidates = fingerprint_to_documents_.find(fingerprint);
+	if (candidates == fingerprint_to_documents_.end())
+	{
+		return std::nullopt;
+	}
+
+	// Equal fingerprints may still be a hash collision, so compare the word sets themselves
+	std::vector<int> term_ids;
+	for (const std::string_view& word : unique_words)
+	{
+		const int term_id = FindTermId(word);
+		if (term_id < 0)
+		{
+			return std::nullopt;
+		}
+		term_ids.push_back(term_id);
+	}
+	std::sort(term_ids.begin(), term_ids.end());
+
+	for (const int candidate_id : candidates->second)
+	{
+		const auto& candidate_terms = documents_.at(candidate_id).terms;
+		if (std::equal(term_ids.begin(), term_ids.end(), candidate_terms.begin(), candidate_terms.end(),
+			[](int term_id, const TermCount& term)
+			{
+				return term_id == term.term_id;
+			}))
+		{
+			return candidate_id;
+		}
+	}
+	return std::nullopt;
+}
+
+void SearchServer::AddFingerprint(int document_id, uint64_t fingerprint)
+{
+	fingerprint_to_documents_[fingerprint].push_back(document_id);
+}
+
+void SearchServer::RemoveFingerprint(int document_id, uint64_t fingerprint)
+{
+	const auto candidates = fingerprint_to_documents_.find(fingerprint);
+	if (candidates == fingerprint_to_documents_.end())
+	{
+		return;
+	}
+	auto& ids = candidates->second;
+	ids.erase(std::remove(ids.begin(), ids.end(), document_id), ids.end());
+	if (ids.empty())
+	{
+		fingerprint_to_documents_.erase(candidates);
+	}
 }
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status,
@@ -206,19 +847,17 @@ void FindTopDocuments(const SearchServer& search_server, const std::string_view&
 	}
 }
 
-void MatchDocuments(const SearchServer& search_server, const std::string_view& query) //TODO Check if we didn't find the document with index, maybe throw exeption
+void MatchDocuments(const SearchServer& search_server, const std::string_view& query)
 {
 	try
 	{
 		std::cout << "Матчинг документов по запросу: "s << query << std::endl;
-		const size_t document_count = search_server.GetDocumentCount();
-		for (size_t index = 0; index < document_count; ++index)
+		const std::vector<int> document_ids(search_server.begin(), search_server.end());
+		const MatchedDocuments matched = search_server.MatchDocuments(query, document_ids);
+		for (size_t index = 0; index < matched.size(); ++index)
 		{
-			const auto end_iter = search_server.end();
-			const auto iter = std::find(search_server.begin(), end_iter, index);
-			const int document_id = iter != end_iter ? *iter : -1;
-			const auto [words, status] = search_server.MatchDocument(query, document_id);
-			PrintMatchDocumentResult(document_id, words, status);
+			const auto words = matched.GetWords(index);
+			PrintMatchDocumentResult(matched.GetDocumentId(index), { words.begin(), words.end() }, matched.GetStatus(index));
 		}
 	}
 	catch (const std::invalid_argument& e)
@@ -237,14 +876,44 @@ std::set<int>::const_iterator SearchServer::end() const
 	return document_ids_.cend();
 }
 
-const std::map<std::string, double>& SearchServer::GetWordFrequencies(int document_id) const
+std::map<std::string, double> SearchServer::GetWordFrequencies(int document_id) const
+{
+	std::map<std::string, double> word_frequencies;
+	const auto iter_to_doc = documents_.find(document_id);
+	if (iter_to_doc != documents_.end())
+	{
+		const double inv_word_count = 1.0 / iter_to_doc->second.word_count;
+		for (const TermCount& term : iter_to_doc->second.terms)
+		{
+			word_frequencies.emplace(term_words_[term.term_id], term.count * inv_word_count);
+		}
+	}
+	return word_frequencies;
+}
+
+std::map<std::string_view, uint32_t> SearchServer::GetWordCounts(int document_id) const
 {
-	const auto iter_to_doc = document_to_word_freqs_.find(document_id);
+	std::map<std::string_view, uint32_t> word_counts;
+	for (const TermCount& term : GetDocumentTerms(document_id))
+	{
+		word_counts.emplace(term_words_[term.term_id], term.count);
+	}
+	return word_counts;
+}
 
-	const static std::map<std::string, double> dummy;
-	if (iter_to_doc == document_to_word_freqs_.end())
+const SearchServer::DocumentTerms& SearchServer::GetDocumentTerms(int document_id) const
+{
+	const auto iter_to_doc = documents_.find(document_id);
+
+	const static DocumentTerms dummy;
+	if (iter_to_doc == documents_.end())
 		return dummy;
-	return iter_to_doc->second;
+	return iter_to_doc->second.terms;
+}
+
+std::string_view SearchServer::GetTermWord(int term_id) const
+{
+	return term_words_.at(term_id);
 }
 
 void SearchServer::RemoveDocument(int document_id)
@@ -252,44 +921,376 @@ void SearchServer::RemoveDocument(int document_id)
 	RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::Clear()
+{
+	// The containers only return their nodes to the pool, the pool returns whole chunks upstream
+	documents_.clear();
+	document_ids_.clear();
+	term_postings_.clear();
+	term_postings_.shrink_to_fit();
+	term_words_.clear();
+	term_words_.shrink_to_fit();
+	word_to_term_id_.clear();
+	term_dictionary_.clear();
+	fingerprint_to_documents_.clear();
+	total_word_count_ = 0;
+	index_resource_->release();
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const
 {
 	return MatchDocument(raw_query, document_id);
 }
 
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(AdaptivePolicy, std::string_view raw_query, int document_id) const
+{
+	return MatchDocument(raw_query, document_id);
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy, std::string_view raw_query, int document_id) const
 {
-	if (documents_.count(document_id) == 0)
+	// Matching touches only the query words and the forward index of one document,
+	// that is far too little work to split between threads
+	return MatchDocument(raw_query, document_id);
+}
+
+int SearchServer::FindTermId(std::string_view word) const
+{
+	const auto term = word_to_term_id_.find(word);
+	return term == word_to_term_id_.end() ? -1 : term->second;
+}
+
+int SearchServer::AddTerm(std::string_view word)
+{
+	const int term_id = FindTermId(word);
+	if (term_id >= 0)
+	{
+		return term_id;
+	}
+
+	const auto term = word_to_term_id_.emplace(word, static_cast<int>(term_words_.size())).first;
+	term_words_.push_back(term->first);
+	term_postings_.emplace_back();
+	term_dictionary_.Add(term->first, term->second);
+	return term->second;
+}
+
+const PostingList* SearchServer::FindPostings(std::string_view word) const
+{
+	const int term_id = FindTermId(word);
+	if (term_id < 0 || term_postings_[term_id].empty())
+	{
+		return nullptr;
+	}
+	return &term_postings_[term_id];
+}
+
+const PostingList* SearchServer::FindPostings(const Query& query, std::string_view word) const
+{
+	const PrefixTerm* prefix = FindPrefixTerm(query, word);
+	if (prefix == nullptr)
+	{
+		return FindPostings(word);
+	}
+	return prefix->postings.empty() ? nullptr : &prefix->postings;
+}
+
+const SearchServer::PrefixTerm* SearchServer::FindPrefixTerm(const Query& query, std::string_view word)
+{
+	if (word.empty() || word.back() != '*')
+	{
+		return nullptr;
+	}
+	const auto prefix = std::find_if(query.prefixes.begin(), query.prefixes.end(), [word](const PrefixTerm& prefix)
+		{
+			return prefix.word == word;
+		});
+	return prefix == query.prefixes.end() ? nullptr : &*prefix;
+}
+
+void SearchServer::AddPrefixTerm(Query& query, std::string_view word, bool is_minus) const
+{
+	const auto existing = std::find_if(query.prefixes.begin(), query.prefixes.end(), [word](const PrefixTerm& prefix)
+		{
+			return prefix.word == word;
+		});
+	// A minus word must exclude every document having any of its terms, the cap only applies to plus words
+	if (existing != query.prefixes.end() && (!is_minus || existing->is_complete))
+	{
+		return;
+	}
+	std::pmr::vector<int> term_ids(query.prefixes.get_allocator().resource());
+	term_dictionary_.FindPrefix(word.substr(0, word.size() - 1), term_ids);
+	// Terms are kept after their last document is removed
+	term_ids.erase(std::remove_if(term_ids.begin(), term_ids.end(), [this](int term_id)
+		{
+			return term_postings_[term_id].empty();
+		}), term_ids.end());
+	const bool is_complete = is_minus || term_ids.size() <= max_prefix_expansions_;
+	if (!is_complete)
 	{
-		throw std::out_of_range("Wrong document id");
+		std::nth_element(term_ids.begin(), term_ids.begin() + max_prefix_expansions_, term_ids.end(), [this](int lhs, int rhs)
+			{
+				return term_postings_[lhs].size() > term_postings_[rhs].size();
+			});
+		term_ids.resize(max_prefix_expansions_);
 	}
+	std::sort(term_ids.begin(), term_ids.end());
 
-	auto query = ParseQuery(policy, raw_query);
+	PrefixTerm& prefix = existing != query.prefixes.end()
+		? *existing
+		: query.prefixes.emplace_back(word, query.prefixes.get_allocator().resource());
+	prefix.term_ids.assign(term_ids.begin(), term_ids.end());
+	prefix.is_complete = is_complete;
+}
 
-	const auto pred = [this, document_id](std::string_view word) {
-		const auto it = word_to_document_freqs_.find(word);
-		return it != word_to_document_freqs_.end() && it->second.count(document_id);
+void SearchServer::ExpandPrefixes(Query& query) const
+{
+	for (PrefixTerm& prefix : query.prefixes)
+	{
+		// K-way merge over a heap of the current postings of every term, a document gets the sum of their counts
+		struct Cursor
+		{
+			PostingList::ConstIterator position;
+			PostingList::ConstIterator end;
+		};
+		std::pmr::vector<Cursor> cursors(query.prefixes.get_allocator().resource());
+		cursors.reserve(prefix.term_ids.size());
+		for (const int term_id : prefix.term_ids)
+		{
+			cursors.push_back({ term_postings_[term_id].begin(), term_postings_[term_id].end() });
+		}
+		const auto is_later = [](const Cursor& lhs, const Cursor& rhs)
+		{
+			return lhs.position->document_id > rhs.position->document_id;
+		};
+		std::make_heap(cursors.begin(), cursors.end(), is_later);
+		while (!cursors.empty())
+		{
+			const int document_id = cursors.front().position->document_id;
+			uint32_t term_count = 0;
+			while (!cursors.empty() && cursors.front().position->document_id == document_id)
+			{
+				std::pop_heap(cursors.begin(), cursors.end(), is_later);
+				Cursor& cursor = cursors.back();
+				term_count += cursor.position->term_count;
+				if (++cursor.position == cursor.end)
+				{
+					cursors.pop_back();
+				}
+				else
+				{
+					std::push_heap(cursors.begin(), cursors.end(), is_later);
+				}
+			}
+			prefix.postings.Add(document_id, term_count);
+		}
+	}
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query, std::pmr::memory_resource* resource) const
+{
+	ResolvedQuery resolved(resource);
+	const auto resolve = [this, &query](const std::pmr::vector<std::string_view>& words, std::pmr::vector<int>& term_ids)
+	{
+		term_ids.reserve(words.size());
+		for (const std::string_view& word : words)
+		{
+			// A prefix word matches through the words it stands for
+			if (const PrefixTerm* prefix = FindPrefixTerm(query, word))
+			{
+				term_ids.insert(term_ids.end(), prefix->term_ids.begin(), prefix->term_ids.end());
+				continue;
+			}
+			const int term_id = FindTermId(word);
+			if (term_id >= 0)
+			{
+				term_ids.push_back(term_id);
+			}
+		}
+		std::sort(term_ids.begin(), term_ids.end());
+		term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
 	};
+	resolve(query.plus_words, resolved.plus_terms);
+	resolve(query.minus_words, resolved.minus_terms);
+	resolved.required_terms.reserve(query.required_words.size());
+	for (const std::string_view& word : query.required_words)
+	{
+		if (const PrefixTerm* prefix = FindPrefixTerm(query, word))
+		{
+			resolved.required_prefix_terms.emplace_back(prefix->term_ids.begin(), prefix->term_ids.end());
+		}
+		else
+		{
+			resolved.required_terms.push_back(FindTermId(word));
+		}
+	}
+	std::sort(resolved.required_terms.begin(), resolved.required_terms.end());
+	resolved.constraints = ResolveConstraints(query, resource);
+	return resolved;
+}
 
-	const auto& status = documents_.at(document_id).status;
+std::pmr::vector<SearchServer::ResolvedConstraint> SearchServer::ResolveConstraints(const Query& query, std::pmr::memory_resource* resource) const
+{
+	std::pmr::vector<ResolvedConstraint> resolved(resource);
+	resolved.reserve(query.constraints.size());
+	for (const PositionConstraint& constraint : query.constraints)
+	{
+		ResolvedConstraint& resolved_constraint = resolved.emplace_back(resource);
+		resolved_constraint.offsets.assign(constraint.offsets.begin(), constraint.offsets.end());
+		resolved_constraint.max_distance = constraint.max_distance;
+		resolved_constraint.is_minus = constraint.is_minus;
+		for (const std::string_view& word : constraint.words)
+		{
+			const int term_id = FindTermId(word);
+			if (term_id < 0)
+			{
+				resolved_constraint.term_ids.clear();
+				break;
+			}
+			resolved_constraint.term_ids.push_back(term_id);
+		}
+	}
+	return resolved;
+}
 
-	if (std::any_of(policy,
-		query.minus_words.begin(),
-		query.minus_words.end(),
-		pred))
+bool SearchServer::SatisfiesConstraints(const std::pmr::vector<ResolvedConstraint>& constraints, const DocumentData& document, PositionBuffers& buffers)
+{
+	return std::all_of(constraints.begin(), constraints.end(), [&document, &buffers](const ResolvedConstraint& constraint)
+		{
+			return ContainsConstraint(constraint, document, buffers) != constraint.is_minus;
+		});
+}
+
+bool SearchServer::ContainsConstraint(const ResolvedConstraint& constraint, const DocumentData& document, PositionBuffers& buffers)
+{
+	if (constraint.term_ids.empty())
 	{
-		return { std::vector<std::string_view>{}, status };
+		return false;
+	}
+	// The buffers only grow, so their capacity carries over from one document to the next
+	if (buffers.size() < constraint.term_ids.size())
+	{
+		buffers.resize(constraint.term_ids.size());
+	}
+	for (size_t index = 0; index < constraint.term_ids.size(); ++index)
+	{
+		const auto term = std::lower_bound(document.terms.begin(), document.terms.end(), constraint.term_ids[index], [](const TermCount& term, int term_id)
+			{
+				return term.term_id < term_id;
+			});
+		if (term == document.terms.end() || term->term_id != constraint.term_ids[index])
+		{
+			return false;
+		}
+		document.positions.GetPositions(term - document.terms.begin(), buffers[index]);
 	}
 
-	std::vector<std::string_view> matched_words(query.plus_words.size());
+	if (constraint.offsets.empty())
+	{
+		// NEAR: both position lists are increasing, so the closest pair is found in one merge pass
+		const auto& left = buffers[0];
+		const auto& right = buffers[1];
+		for (size_t left_index = 0, right_index = 0; left_index < left.size() && right_index < right.size();)
+		{
+			const uint32_t distance = left[left_index] > right[right_index] ? left[left_index] - right[right_index] : right[right_index] - left[left_index];
+			if (distance <= constraint.max_distance)
+			{
+				return true;
+			}
+			if (left[left_index] < right[right_index])
+			{
+				++left_index;
+			}
+			else
+			{
+				++right_index;
+			}
+		}
+		return false;
+	}
 
-	auto it = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(),
-		matched_words.begin(),
-		pred
-	);
+	// Phrase: every occurrence of the first word is a possible start
+	return std::any_of(buffers[0].begin(), buffers[0].end(), [&](uint32_t start)
+		{
+			for (size_t index = 1; index < constraint.term_ids.size(); ++index)
+			{
+				if (!std::binary_search(buffers[index].begin(), buffers[index].end(), start + constraint.offsets[index]))
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+}
 
-	matched_words.erase(it, matched_words.end());
-	SortAndUnique(matched_words);
+size_t SearchServer::MatchResolvedQuery(const ResolvedQuery& query, const DocumentData& document, PositionBuffers& buffers, std::string_view* output) const
+{
+	if (!SatisfiesConstraints(query.constraints, document, buffers))
+	{
+		return 0;
+	}
+
+	const auto& terms = document.terms;
+	const auto by_term_id = [](const TermCount& term, int term_id)
+	{
+		return term.term_id < term_id;
+	};
 
-	return { matched_words, status };
-}
\ No newline at end of file
+	// Both sides are sorted by term id, so every search continues from where the previous one stopped
+	auto position = terms.begin();
+	for (const int term_id : query.required_terms)
+	{
+		position = std::lower_bound(position, terms.end(), term_id, by_term_id);
+		if (position == terms.end() || position->term_id != term_id)
+		{
+			return 0;
+		}
+	}
+
+	for (const auto& prefix_terms : query.required_prefix_terms)
+	{
+		const bool contains_any = std::any_of(prefix_terms.begin(), prefix_terms.end(), [&](int term_id)
+			{
+				return std::binary_search(terms.begin(), terms.end(), TermCount{ term_id, 0 }, [](const TermCount& lhs, const TermCount& rhs)
+					{
+						return lhs.term_id < rhs.term_id;
+					});
+			});
+		if (!contains_any)
+		{
+			return 0;
+		}
+	}
+
+	position = terms.begin();
+	for (const int term_id : query.minus_terms)
+	{
+		position = std::lower_bound(position, terms.end(), term_id, by_term_id);
+		if (position == terms.end())
+		{
+			break;
+		}
+		if (position->term_id == term_id)
+		{
+			return 0;
+		}
+	}
+
+	size_t matched_count = 0;
+	position = terms.begin();
+	for (const int term_id : query.plus_terms)
+	{
+		position = std::lower_bound(position, terms.end(), term_id, by_term_id);
+		if (position == terms.end())
+		{
+			break;
+		}
+		if (position->term_id == term_id)
+		{
+			output[matched_count++] = term_words_[term_id];
+		}
+	}
+	std::sort(output, output + matched_count);
+	return matched_count;
+}
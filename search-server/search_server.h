@@ -1,16 +1,27 @@
 #pragma once
 
+#include "adaptive_execution.h"
 #include "document.h"
+#include "document_positions.h"
+#include "matched_documents.h"
+#include "posting_list.h"
+#include "ranking.h"
+#include "term_dictionary.h"
 #include "paginator.h"
 #include "read_input_functions.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
 #include "log_duration.h"
+#include "query_arena.h"
+#include "query_trace.h"
 
 #include <vector>
 #include <string>
 #include <set>
+#include <functional>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <iterator>
 #include <algorithm>
 #include <iostream>
@@ -18,22 +29,80 @@
 #include <cmath>
 #include <execution>
 #include <future>
+#include <optional>
+#include <stdexcept>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t MAX_PREFIX_EXPANSIONS = 64;
 const double DEVIATION = 1e-6;
 
+// How AddDocument treats a document whose set of words matches an already indexed one
+enum class DuplicateMode
+{
+	OFF,
+	TRACK,
+	REJECT,
+};
+
+class DuplicateDocumentError : public std::invalid_argument
+{
+public:
+	DuplicateDocumentError(int document_id, int original_id);
+
+	int GetDocumentId() const;
+	int GetOriginalId() const;
+
+private:
+	int document_id_;
+	int original_id_;
+};
+
 class SearchServer
 {
 public:
+	struct TermCount
+	{
+		int term_id;
+		uint32_t count;
+	};
+
+	using DocumentTerms = std::pmr::vector<TermCount>;
+
 	SearchServer()
+		: SearchServer(std::pmr::get_default_resource())
 	{}
 
+	// Terms, postings and forward index entries are served by a pool drawing on the given resource.
+	// The pool serializes its own calls to the resource, which therefore does not need to be thread-safe
+	explicit SearchServer(std::pmr::memory_resource* resource);
 	template <typename StringCollection>
-	explicit SearchServer(const StringCollection& stop_words);
-	explicit SearchServer(const std::string& stop_words);
+	explicit SearchServer(const StringCollection& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	explicit SearchServer(const std::string& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Index containers are bound to the pool of their server, so a server can be moved but not reassigned
+	SearchServer(SearchServer&& other) = default;
+	SearchServer& operator=(SearchServer&& other) = delete;
 
 	void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
+	void SetDuplicateMode(DuplicateMode mode);
+	DuplicateMode GetDuplicateMode() const;
+	std::optional<int> FindDuplicate(const std::string_view& document) const;
+
+	// Keeps the word positions of every added document, which quoted phrases ("curly hair") and proximity
+	// operators (cat NEAR/3 dog) in queries require. Can only be switched while the server has no documents
+	void SetPositionalIndex(bool enabled);
+	bool HasPositionalIndex() const;
+
+	// A plus prefix word of a query (word*) stands for at most this many of the most frequent terms starting with it,
+	// a minus prefix word excludes the documents having any of them
+	void SetMaxPrefixExpansions(size_t count);
+	size_t GetMaxPrefixExpansions() const;
+
+	void SetRankingFunction(RankingFunction ranking_function);
+	RankingFunction GetRankingFunction() const;
+	CorpusStatistics GetCorpusStatistics() const;
+
 	template <typename DocumentPredicate>
 	std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const;
 	std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
@@ -46,6 +115,25 @@ public:
 	template <typename ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query) const;
 
+	// Ranks with the given policy instead of the one selected by SetRankingFunction, see ranking.h
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking) const;
+
+	// Explain mode: also fills the trace with the parsed query, statistics of every term and the time of every phase
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, QueryTrace& trace) const;
+	std::vector<Document> FindTopDocuments(const std::string_view& raw_query, QueryTrace& trace) const;
+
+	// Document frequencies of the plus words of the query in this server, see QueryStatistics
+	QueryStatistics GetQueryStatistics(const std::string_view& raw_query) const;
+	// Ranks with the corpus size and document frequencies merged from several servers instead of the local ones
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking, const QueryStatistics& statistics) const;
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const QueryStatistics& statistics) const;
+	// The order of FindTopDocuments results: by relevance, equally relevant documents by rating
+	static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
 	std::set<int>::const_iterator begin() const;
 	std::set<int>::const_iterator end() const;
 
@@ -54,17 +142,45 @@ public:
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(AdaptivePolicy, std::string_view raw_query, int document_id) const;
+
+	// Parses the query once and matches it against every listed document
+	MatchedDocuments MatchDocuments(std::execution::parallel_policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+	MatchedDocuments MatchDocuments(std::execution::sequenced_policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+	MatchedDocuments MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+	MatchedDocuments MatchDocuments(AdaptivePolicy policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+	// Thresholds used by adaptive_policy, the calibrated ones unless set explicitly
+	void SetExecutionThresholds(const ExecutionThresholds& thresholds);
+	const ExecutionThresholds& GetExecutionThresholds() const;
+	// What adaptive_policy would do with the query
+	ExecutionPlan PlanExecution(std::string_view raw_query) const;
+	// Measured once per process, on first use or by Calibrate, by timing sequential and parallel searches over a synthetic index
+	static const ExecutionThresholds& GetCalibratedExecutionThresholds();
+	// Measures the thresholds now, so that servers don't spend the first adaptive query on it
+	static void Calibrate();
 	
-	const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
+	std::map<std::string, double> GetWordFrequencies(int document_id) const;
+	std::map<std::string_view, uint32_t> GetWordCounts(int document_id) const;
+	// Forward index of a document ordered by term id
+	const DocumentTerms& GetDocumentTerms(int document_id) const;
+	std::string_view GetTermWord(int term_id) const;
 	template <class ExecutionPolicy>
 	void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 	void RemoveDocument(int document_id);
+	// Removes every document and hands the index memory back to the upstream resource at once.
+	// Stop words and settings are kept, term ids are assigned anew
+	void Clear();
 private:
 	struct DocumentData
 	{
 		int rating;
 		DocumentStatus status;
-		std::vector<std::string> doc_words;
+		int word_count;
+		uint64_t fingerprint;
+		DocumentTerms terms;
+		// Empty without the positional index
+		DocumentPositions positions;
 	};
 
 	struct QueryWord
@@ -72,19 +188,120 @@ private:
 		std::string_view data;
 		bool is_minus;
 		bool is_stop;
+		// Marked with a plus: +word
+		bool is_required;
+		// Ends with an asterisk: word*
+		bool is_prefix;
+	};
+
+	// The words of a quoted phrase at fixed distances from each other or two words joined by NEAR/k.
+	// A document must contain every plus constraint and none of the minus ones
+	struct PositionConstraint
+	{
+		explicit PositionConstraint(std::pmr::memory_resource* resource)
+			: words(resource)
+			, offsets(resource)
+		{}
+
+		std::pmr::vector<std::string_view> words;
+		// Phrase: the position of every word relative to the first one, stop words leave gaps. Empty for NEAR
+		std::pmr::vector<uint32_t> offsets;
+		// NEAR: the largest distance between the positions of the two words
+		uint32_t max_distance = 0;
+		bool is_minus = false;
+	};
+
+	// The terms a prefix word stands for, ranked as one term occurring wherever any of them occurs
+	struct PrefixTerm
+	{
+		PrefixTerm(std::string_view word, std::pmr::memory_resource* resource)
+			: word(word)
+			, term_ids(resource)
+			, postings(PostingList::allocator_type(resource))
+		{}
+
+		// With the asterisk, as among the plus and minus words
+		std::string_view word;
+		std::pmr::vector<int> term_ids;
+		// False when the expansion cap left some of the terms out
+		bool is_complete = true;
+		// The postings of the terms merged by ExpandPrefixes
+		PostingList postings;
 	};
 
 	struct Query
 	{
-		std::vector<std::string_view> plus_words;
-		std::vector<std::string_view> minus_words;
+		explicit Query(std::pmr::memory_resource* resource)
+			: plus_words(resource)
+			, minus_words(resource)
+			, required_words(resource)
+			, constraints(resource)
+			, prefixes(resource)
+		{}
+
+		// The words of plus constraints are plus words too and take part in ranking
+		std::pmr::vector<std::string_view> plus_words;
+		std::pmr::vector<std::string_view> minus_words;
+		// Plus words every found document must contain, a query with any of them is conjunctive
+		std::pmr::vector<std::string_view> required_words;
+		std::pmr::vector<PositionConstraint> constraints;
+		std::pmr::vector<PrefixTerm> prefixes;
+	};
+
+	struct ResolvedConstraint
+	{
+		explicit ResolvedConstraint(std::pmr::memory_resource* resource)
+			: term_ids(resource)
+			, offsets(resource)
+		{}
+
+		// Empty when a word of the constraint is missing from the index
+		std::pmr::vector<int> term_ids;
+		std::pmr::vector<uint32_t> offsets;
+		uint32_t max_distance = 0;
+		bool is_minus = false;
+	};
+
+	// Decoded positions of the words of one constraint, reused for every document a query checks
+	using PositionBuffers = std::pmr::vector<std::pmr::vector<uint32_t>>;
+
+	// Query words replaced by term ids, sorted and without words missing from the index
+	struct ResolvedQuery
+	{
+		explicit ResolvedQuery(std::pmr::memory_resource* resource)
+			: plus_terms(resource)
+			, minus_terms(resource)
+			, required_terms(resource)
+			, required_prefix_terms(resource)
+			, constraints(resource)
+		{}
+
+		std::pmr::vector<int> plus_terms;
+		std::pmr::vector<int> minus_terms;
+		// A required word missing from the index stays as -1, which no document contains
+		std::pmr::vector<int> required_terms;
+		// The sorted terms of every required prefix word, a document must contain one of each group
+		std::pmr::vector<std::pmr::vector<int>> required_prefix_terms;
+		std::pmr::vector<ResolvedConstraint> constraints;
 	};
 
-	std::set<std::string> stop_words_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-	std::map<int, std::map<std::string, double>> document_to_word_freqs_;
-	std::map<int, DocumentData> documents_;
-	std::set<int> document_ids_;
+	std::set<std::string, std::less<>> stop_words_;
+	// Declared before the index so that the containers release their memory into it before it is destroyed
+	std::unique_ptr<std::pmr::synchronized_pool_resource> index_resource_;
+	// Term ids are only erased all at once by Clear, so views of term words stay valid until then
+	std::pmr::map<std::pmr::string, int, std::less<>> word_to_term_id_;
+	std::pmr::vector<std::string_view> term_words_;
+	std::pmr::vector<PostingList> term_postings_;
+	TermDictionary term_dictionary_;
+	std::pmr::map<int, DocumentData> documents_;
+	std::pmr::set<int> document_ids_;
+	uint64_t total_word_count_ = 0;
+	RankingFunction ranking_function_ = RankingFunction::TF_IDF;
+	DuplicateMode duplicate_mode_ = DuplicateMode::OFF;
+	bool positional_index_ = false;
+	size_t max_prefix_expansions_ = MAX_PREFIX_EXPANSIONS;
+	std::map<uint64_t, std::vector<int>> fingerprint_to_documents_;
+	std::optional<ExecutionThresholds> execution_thresholds_;
 
 	template <typename StringCollection>
 	void SetStopWords(const StringCollection& stop_words);
@@ -94,18 +311,75 @@ private:
 	std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
 	static int ComputeAverageRating(const std::vector<int>& ratings);
 	QueryWord ParseQueryWord(const std::string_view& text) const;
+	// Moves quoted phrases and NEAR operators of the query words into constraints and leaves plain words in their place
+	void ParsePositionConstraints(std::pmr::vector<std::string_view>& words, Query& query) const;
 
 	template <class ExecutionPolicy>
-	Query ParseQuery(const ExecutionPolicy& policy, const std::string_view& text) const;
-	Query ParseQuery(const std::string_view& text) const;
-	double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
+	Query ParseQuery(const ExecutionPolicy& policy, const std::string_view& text, std::pmr::memory_resource* resource) const;
+	Query ParseQuery(const std::string_view& text, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const;
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+	template <typename Function>
+	auto WithRanking(Function function) const;
+
+	ExecutionPlan PlanExecution(const Query& query) const;
+	static ExecutionThresholds CalibrateExecutionThresholds();
+
+	// Passed instead of a QueryTrace when explain mode is off, the tracing code is then discarded at compile time
+	struct NoQueryTrace
+	{};
+	template <typename Trace>
+	static constexpr bool IS_TRACING = std::is_same_v<Trace, QueryTrace>;
+
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking, typename Trace>
+	std::vector<Document> FindTopDocumentsImpl(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking, const QueryStatistics* statistics, Trace& trace) const;
+	void TraceQuery(const std::string_view& raw_query, const Query& query, QueryTrace& trace) const;
+	static void TracePlusTerm(QueryTrace::Term& term, size_t posting_count, double weight, size_t scored_count, size_t filtered_count);
+	static void TraceMinusTerm(QueryTrace::Term& term, size_t posting_count, size_t excluded_count);
+	static void SumTrace(QueryTrace& trace);
 
-	void SortAndUnique(std::vector<std::string_view>& vec_to_normalize) const;
+	// Statistics are null when the server ranks with its own ones.
+	// The parallel variant splits the relevance map between worker_count buckets, one per hardware thread by default
+	template <typename Ranking, typename DocumentPredicate, typename Trace>
+	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace, int worker_count = 0) const;
+	template <typename Ranking, typename DocumentPredicate, typename Trace>
+	std::vector<Document> FindAllDocuments(const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace) const;
+	// Conjunctive search: intersects the postings of the required words and ranks the documents left by the plus words
+	// of their forward index, so the cost follows the rarest required word rather than the most common plus word
+	template <typename Ranking, typename DocumentPredicate, typename Trace>
+	std::vector<Document> FindRequiredDocuments(const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace) const;
+	// Ids contained in every list in increasing order. The lists are taken from the shortest up
+	static std::pmr::vector<int> IntersectPostings(std::pmr::vector<const PostingList*>& postings, std::pmr::memory_resource* resource);
+	CorpusStatistics GetCorpusStatistics(const QueryStatistics* statistics) const;
+	static size_t GetDocumentFreq(std::string_view word, const PostingList& postings, const QueryStatistics* statistics);
+
+	template <typename Container>
+	static void SortAndUnique(Container& vec_to_normalize);
+
+	int FindTermId(std::string_view word) const;
+	int AddTerm(std::string_view word);
+	const PostingList* FindPostings(std::string_view word) const;
+	// The merged postings for a prefix word
+	const PostingList* FindPostings(const Query& query, std::string_view word) const;
+	static const PrefixTerm* FindPrefixTerm(const Query& query, std::string_view word);
+	// Looks the terms of a prefix word up in the dictionary. A plus word keeps the ones with the longest postings,
+	// a minus word keeps them all
+	void AddPrefixTerm(Query& query, std::string_view word, bool is_minus) const;
+	// Merges the postings of the terms of every prefix word, which the searches need but matching doesn't
+	void ExpandPrefixes(Query& query) const;
+	ResolvedQuery ResolveQuery(const Query& query, std::pmr::memory_resource* resource) const;
+	std::pmr::vector<ResolvedConstraint> ResolveConstraints(const Query& query, std::pmr::memory_resource* resource) const;
+	static bool SatisfiesConstraints(const std::pmr::vector<ResolvedConstraint>& constraints, const DocumentData& document, PositionBuffers& buffers);
+	static bool ContainsConstraint(const ResolvedConstraint& constraint, const DocumentData& document, PositionBuffers& buffers);
+	// Writes the matched words in lexicographic order to output, which must have room for all plus terms
+	size_t MatchResolvedQuery(const ResolvedQuery& query, const DocumentData& document, PositionBuffers& buffers, std::string_view* output) const;
+
+	template <typename ExecutionPolicy>
+	MatchedDocuments MatchDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+	static uint64_t ComputeFingerprint(const std::vector<std::string_view>& unique_words);
+	std::optional<int> FindDuplicate(uint64_t fingerprint, const std::vector<std::string_view>& unique_words) const;
+	void AddFingerprint(int document_id, uint64_t fingerprint);
+	void RemoveFingerprint(int document_id, uint64_t fingerprint);
 };
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
@@ -139,45 +413,153 @@ void SearchServer::SetStopWords(const StringCollection& stop_words)
 }
 
 template <typename StringCollection>
-SearchServer::SearchServer(const StringCollection& stop_words)
+SearchServer::SearchServer(const StringCollection& stop_words, std::pmr::memory_resource* resource)
+	: SearchServer(resource)
 {
 	SetStopWords(stop_words);
 }
 
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking) const
+{
+	NoQueryTrace no_trace;
+	return FindTopDocumentsImpl(policy, raw_query, document_predicate, ranking, nullptr, no_trace);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking, const QueryStatistics& statistics) const
+{
+	NoQueryTrace no_trace;
+	return FindTopDocumentsImpl(policy, raw_query, document_predicate, ranking, &statistics, no_trace);
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const QueryStatistics& statistics) const
 {
-	if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>)
+	return WithRanking([&](const auto& ranking)
+		{
+			return FindTopDocuments(policy, raw_query, document_predicate, ranking, statistics);
+		});
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, QueryTrace& trace) const
+{
+	return WithRanking([&](const auto& ranking)
+		{
+			return FindTopDocumentsImpl(policy, raw_query, document_predicate, ranking, nullptr, trace);
+		});
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking, typename Trace>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking, const QueryStatistics* statistics, Trace& trace) const
+{
+	PROFILE_SCOPE("FindTopDocuments");
+	[[maybe_unused]] QueryTrace::Clock::time_point phase_start;
+	if constexpr (IS_TRACING<Trace>)
 	{
-		return FindTopDocuments(raw_query, document_predicate);
+		trace = QueryTrace{};
+		phase_start = QueryTrace::Clock::now();
 	}
-	else
-	{
-		const Query& query = ParseQuery(raw_query);
 
-		std::vector<Document> matched_documents = FindAllDocuments(policy, query, document_predicate);
+	const QueryArena::Scope scratch;
+	Query query = ParseQuery(raw_query, scratch.GetResource());
+	ExpandPrefixes(query);
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.parse_time = QueryTrace::Clock::now() - phase_start;
+		TraceQuery(raw_query, query, trace);
+	}
 
+	std::vector<Document> matched_documents;
+	[[maybe_unused]] bool run_in_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+	if (!query.required_words.empty())
+	{
+		// The intersection is bounded by the rarest required word, that is too little work to split between threads
+		run_in_parallel = false;
+		matched_documents = FindRequiredDocuments(ranking, query, document_predicate, statistics, scratch, trace);
+	}
+	else if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptivePolicy>)
+	{
+		const ExecutionPlan plan = PlanExecution(query);
+		run_in_parallel = plan.parallel;
+		if (plan.parallel)
+		{
+			matched_documents = FindAllDocuments(std::execution::par, ranking, query, document_predicate, statistics, scratch, trace, plan.worker_count);
+		}
+		else
+		{
+			matched_documents = FindAllDocuments(ranking, query, document_predicate, statistics, scratch, trace);
+		}
+	}
+	else if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>)
+	{
+		matched_documents = FindAllDocuments(ranking, query, document_predicate, statistics, scratch, trace);
+	}
+	else
+	{
+		matched_documents = FindAllDocuments(policy, ranking, query, document_predicate, statistics, scratch, trace);
+	}
 
-		sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs)
+	if (!query.constraints.empty())
+	{
+		// Only the candidates found by the words are verified against the positions
+		const auto constraints = ResolveConstraints(query, scratch.GetResource());
+		PositionBuffers buffers(scratch.GetResource());
+		const size_t candidate_count = matched_documents.size();
+		matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [&](const Document& document)
 			{
-				if (std::abs(lhs.relevance - rhs.relevance) < DEVIATION)
-				{
-					return lhs.rating > rhs.rating;
-				}
-				else
-				{
-					return lhs.relevance > rhs.relevance;
-				}
-			});
+				return !SatisfiesConstraints(constraints, documents_.at(document.id), buffers);
+			}), matched_documents.end());
+		if constexpr (IS_TRACING<Trace>)
+		{
+			trace.documents_constrained = candidate_count - matched_documents.size();
+		}
+	}
 
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.candidate_count = matched_documents.size();
+		phase_start = QueryTrace::Clock::now();
+	}
 
-		if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+	const auto by_relevance = &IsMoreRelevant;
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptivePolicy>)
+	{
+		if (run_in_parallel)
+		{
+			sort(std::execution::par, matched_documents.begin(), matched_documents.end(), by_relevance);
+		}
+		else
 		{
-			matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+			sort(std::execution::seq, matched_documents.begin(), matched_documents.end(), by_relevance);
 		}
+	}
+	else
+	{
+		sort(policy, matched_documents.begin(), matched_documents.end(), by_relevance);
+	}
+
+	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+	{
+		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	}
 
-		return matched_documents;
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.sort_time = QueryTrace::Clock::now() - phase_start;
+		trace.result_count = matched_documents.size();
 	}
+	return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const
+{
+	return WithRanking([&](const auto& ranking)
+		{
+			return FindTopDocuments(policy, raw_query, document_predicate, ranking);
+		});
 }
 
 template <typename ExecutionPolicy>
@@ -198,157 +580,291 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const
 {
-	const auto query = ParseQuery(raw_query);
+	return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+}
 
-	auto matched_documents = FindAllDocuments(query, document_predicate);
+template <typename ExecutionPolicy>
+MatchedDocuments SearchServer::MatchDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+	PROFILE_SCOPE("MatchDocuments");
+	const QueryArena::Scope scratch;
+	const ResolvedQuery query = ResolveQuery(ParseQuery(raw_query, scratch.GetResource()), scratch.GetResource());
 
-	sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs)
+	std::pmr::vector<const DocumentData*> documents(scratch.GetResource());
+	documents.reserve(document_ids.size());
+	for (const int document_id : document_ids)
+	{
+		const auto document = documents_.find(document_id);
+		if (document == documents_.end())
 		{
-			if (std::abs(lhs.relevance - rhs.relevance) < DEVIATION)
-			{
-				return lhs.rating > rhs.rating;
-			}
-			else
+			throw std::out_of_range("Document out of range");
+		}
+		documents.push_back(&document->second);
+	}
+
+	// Every document gets a slot large enough for all plus words, the slots are compacted afterwards
+	const size_t slot_size = query.plus_terms.size();
+	std::pmr::vector<std::string_view> words(documents.size() * slot_size, scratch.GetResource());
+	std::pmr::vector<size_t> word_counts(documents.size(), scratch.GetResource());
+	// Every range of documents decodes the positions of the constraints into one set of buffers
+	const auto match_range = [&](size_t begin, size_t end, std::pmr::memory_resource* resource)
+	{
+		PositionBuffers buffers(resource);
+		for (size_t index = begin; index < end; ++index)
+		{
+			word_counts[index] = MatchResolvedQuery(query, *documents[index], buffers, words.data() + index * slot_size);
+		}
+	};
+	const auto match_in_parallel = [&]()
+	{
+		const size_t range_count = std::min<size_t>(documents.size(), std::max(1u, std::thread::hardware_concurrency()) * 4);
+		std::pmr::vector<size_t> ranges(range_count, scratch.GetResource());
+		std::iota(ranges.begin(), ranges.end(), 0);
+		std::for_each(std::execution::par, ranges.begin(), ranges.end(), [&](size_t range)
 			{
-				return lhs.relevance > rhs.relevance;
-			}
-		});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+				match_range(range * documents.size() / range_count, (range + 1) * documents.size() / range_count, scratch.GetSharedResource());
+			});
+	};
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptivePolicy>)
 	{
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+		const size_t pairs = documents.size() * (query.plus_terms.size() + query.minus_terms.size());
+		if (std::thread::hardware_concurrency() > 1 && pairs >= GetExecutionThresholds().parallel_match_pairs)
+		{
+			match_in_parallel();
+		}
+		else
+		{
+			match_range(0, documents.size(), scratch.GetResource());
+		}
+	}
+	else if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>)
+	{
+		match_in_parallel();
+	}
+	else
+	{
+		match_range(0, documents.size(), scratch.GetResource());
 	}
 
-	return matched_documents;
+	std::vector<MatchedDocuments::Entry> entries;
+	entries.reserve(documents.size());
+	std::vector<std::string_view> matched_words;
+	matched_words.reserve(std::accumulate(word_counts.begin(), word_counts.end(), size_t{ 0 }));
+	for (size_t index = 0; index < documents.size(); ++index)
+	{
+		const auto slot_begin = words.begin() + index * slot_size;
+		const size_t words_begin = matched_words.size();
+		matched_words.insert(matched_words.end(), slot_begin, slot_begin + word_counts[index]);
+		entries.push_back({ document_ids[index], documents[index]->status, words_begin, matched_words.size() });
+	}
+
+	return MatchedDocuments(std::move(entries), std::move(matched_words));
 }
 
 template <class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id)
 {
+	PROFILE_SCOPE("RemoveDocument");
 	{
 		document_ids_.erase(document_id);
 	}
 
 	{
-		const auto& doc_to_freq = document_to_word_freqs_.find(document_id);
-		if (doc_to_freq != document_to_word_freqs_.end())
+		const auto doc_iter = documents_.find(document_id);
+		if (doc_iter != documents_.end())
 		{
-			const auto& words_freq = doc_to_freq->second;
-			std::vector<const std::string*> words_to_remove(words_freq.size());
-
-			std::transform(policy,
-				words_freq.begin(),
-				words_freq.end(),
-				words_to_remove.begin(),
-				[](const auto& word_to_freq)
-				{
-					return &word_to_freq.first;
-				});
-
+			const auto& terms = doc_iter->second.terms;
 			std::for_each(policy,
-				words_to_remove.begin(),
-				words_to_remove.end(),
-				[this, document_id](const auto& word_to_remove)
+				terms.begin(),
+				terms.end(),
+				[this, document_id](const TermCount& term)
 				{
-					word_to_document_freqs_.at(*word_to_remove).erase(document_id);
+					term_postings_[term.term_id].Remove(document_id);
 				});
 
-			document_to_word_freqs_.erase(doc_to_freq);
+			if (duplicate_mode_ != DuplicateMode::OFF)
+			{
+				RemoveFingerprint(document_id, doc_iter->second.fingerprint);
+			}
+			total_word_count_ -= doc_iter->second.word_count;
+			documents_.erase(doc_iter);
 		}
 	}
+}
 
+template <typename Function>
+auto SearchServer::WithRanking(Function function) const
+{
+	// The switch is taken once per query, so every ranking gets its own fully inlined scoring loop
+	switch (ranking_function_)
 	{
-		documents_.erase(document_id);
+	case RankingFunction::BM25:
+		return function(Bm25Ranking{});
+	case RankingFunction::BM25_PLUS:
+		return function(Bm25PlusRanking{});
+	case RankingFunction::TF_IDF:
+	default:
+		return function(TfIdfRanking{});
 	}
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const
+template <typename Ranking, typename DocumentPredicate, typename Trace>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace, int worker_count) const
 {
-	int num_of_threads = std::thread::hardware_concurrency();
+	const int num_of_threads = worker_count > 0 ? worker_count : static_cast<int>(std::thread::hardware_concurrency());
 	if (num_of_threads <= 1)
 	{
-		return FindAllDocuments(query, document_predicate);
+		return FindAllDocuments(ranking, query, document_predicate, statistics, scratch, trace);
 	}
 
-	ConcurrentMap<int, double> document_to_relevance(num_of_threads);
+	[[maybe_unused]] QueryTrace::Clock::time_point phase_start;
+	if constexpr (IS_TRACING<Trace>)
+	{
+		phase_start = QueryTrace::Clock::now();
+	}
+	const CorpusStatistics corpus = GetCorpusStatistics(statistics);
+	ConcurrentMap<int, double> document_to_relevance(num_of_threads, scratch.GetSharedResource());
 	std::for_each(policy,
 		query.plus_words.begin(),
 		query.plus_words.end(),
-		[&](std::string_view word)
+		[&](const std::string_view& word)
 		{
-			if (word_to_document_freqs_.count(word) != 0)
+			const PostingList* postings = FindPostings(query, word);
+			if (postings != nullptr)
 			{
-				const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+				const double term_weight = ranking.ComputeTermWeight(corpus, GetDocumentFreq(word, *postings, statistics));
 
-				for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+				[[maybe_unused]] size_t scored_count = 0;
+				for (const auto [document_id, term_count] : *postings)
 				{
 					const auto& document_data = documents_.at(document_id);
 					if (document_predicate(document_id, document_data.status, document_data.rating))
 					{
 						ConcurrentMap<int, double>::Access val = document_to_relevance[document_id];
-						val.ref_to_value += term_freq * inverse_document_freq;
+						val.ref_to_value += ranking.ComputeScore(corpus, term_weight, term_count, document_data.word_count, document_data.rating);
+						++scored_count;
 					}
 				}
+				PROFILE_COUNT("postings scanned", postings->size());
+				PROFILE_COUNT("documents scored", scored_count);
+				if constexpr (IS_TRACING<Trace>)
+				{
+					TracePlusTerm(trace.plus_terms[&word - query.plus_words.data()], postings->size(), term_weight, scored_count, postings->size() - scored_count);
+				}
 			}
 		});
 
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.score_time = QueryTrace::Clock::now() - phase_start;
+		phase_start = QueryTrace::Clock::now();
+	}
 	std::for_each(policy,
 		query.minus_words.begin(),
 		query.minus_words.end(),
-		[&](std::string_view word)
+		[&](const std::string_view& word)
 		{
-			if (word_to_document_freqs_.count(word) != 0)
+			const PostingList* postings = FindPostings(query, word);
+			if (postings != nullptr)
 			{
-				for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+				[[maybe_unused]] size_t excluded_count = 0;
+				for (const auto [document_id, _] : *postings)
 				{
-					document_to_relevance.erase(document_id);
+					excluded_count += document_to_relevance.erase(document_id);
+				}
+				PROFILE_COUNT("postings scanned", postings->size());
+				PROFILE_COUNT("documents excluded by minus words", excluded_count);
+				if constexpr (IS_TRACING<Trace>)
+				{
+					TraceMinusTerm(trace.minus_terms[&word - query.minus_words.data()], postings->size(), excluded_count);
 				}
 			}
 		});
 
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.exclude_time = QueryTrace::Clock::now() - phase_start;
+		SumTrace(trace);
+	}
+	const auto ordinary_map = document_to_relevance.BuildOrdinaryMap();
 	std::vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap())
+	matched_documents.reserve(ordinary_map.size());
+	for (const auto [document_id, relevance] : ordinary_map)
 	{
 		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
 	}
 	return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const
+template <typename Ranking, typename DocumentPredicate, typename Trace>
+std::vector<Document> SearchServer::FindAllDocuments(const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace) const
 {
-	std::map<int, double> document_to_relevance;
+	[[maybe_unused]] QueryTrace::Clock::time_point phase_start;
+	if constexpr (IS_TRACING<Trace>)
+	{
+		phase_start = QueryTrace::Clock::now();
+	}
+	const CorpusStatistics corpus = GetCorpusStatistics(statistics);
+	std::pmr::map<int, double> document_to_relevance(scratch.GetResource());
 
 	for (const std::string_view& word : query.plus_words)
 	{
-		if (word_to_document_freqs_.count(word) == 0)
+		const PostingList* postings = FindPostings(query, word);
+		if (postings == nullptr)
 		{
 			continue;
 		}
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+		const double term_weight = ranking.ComputeTermWeight(corpus, GetDocumentFreq(word, *postings, statistics));
+		[[maybe_unused]] size_t scored_count = 0;
+		for (const auto [document_id, term_count] : *postings)
 		{
 			const auto& document_data = documents_.at(document_id);
 			if (document_predicate(document_id, document_data.status, document_data.rating))
 			{
-				document_to_relevance[document_id] += term_freq * inverse_document_freq;
+				document_to_relevance[document_id] += ranking.ComputeScore(corpus, term_weight, term_count, document_data.word_count, document_data.rating);
+				++scored_count;
 			}
 		}
+		PROFILE_COUNT("postings scanned", postings->size());
+		PROFILE_COUNT("documents scored", scored_count);
+		if constexpr (IS_TRACING<Trace>)
+		{
+			TracePlusTerm(trace.plus_terms[&word - query.plus_words.data()], postings->size(), term_weight, scored_count, postings->size() - scored_count);
+		}
 	}
 
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.score_time = QueryTrace::Clock::now() - phase_start;
+		phase_start = QueryTrace::Clock::now();
+	}
 	for (const std::string_view& word : query.minus_words)
 	{
-		if (word_to_document_freqs_.count(word) == 0)
+		const PostingList* postings = FindPostings(query, word);
+		if (postings == nullptr)
 		{
 			continue;
 		}
-		for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+		[[maybe_unused]] size_t excluded_count = 0;
+		for (const auto [document_id, _] : *postings)
+		{
+			excluded_count += document_to_relevance.erase(document_id);
+		}
+		PROFILE_COUNT("postings scanned", postings->size());
+		PROFILE_COUNT("documents excluded by minus words", excluded_count);
+		if constexpr (IS_TRACING<Trace>)
 		{
-			document_to_relevance.erase(document_id);
+			TraceMinusTerm(trace.minus_terms[&word - query.minus_words.data()], postings->size(), excluded_count);
 		}
 	}
 
+	if constexpr (IS_TRACING<Trace>)
+	{
+		trace.exclude_time = QueryTrace::Clock::now() - phase_start;
+		SumTrace(trace);
+	}
 	std::vector<Document> matched_documents;
+	matched_documents.reserve(document_to_relevance.size());
 	for (const auto [document_id, relevance] : document_to_relevance)
 	{
 		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
@@ -356,14 +872,164 @@ std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Documen
 	return matched_documents;
 }
 
+template <typename Ranking, typename DocumentPredicate, typename Trace>
+std::vector<Document> SearchServer::FindRequiredDocuments(const Ranking& ranking, const Query& query, DocumentPredicate document_predicate, const QueryStatistics* statistics, const QueryArena::Scope& scratch, Trace& trace) const
+{
+	[[maybe_unused]] QueryTrace::Clock::time_point phase_start;
+	if constexpr (IS_TRACING<Trace>)
+	{
+		phase_start = QueryTrace::Clock::now();
+	}
+	struct QueryTerm
+	{
+		int term_id;
+		// Index of the word in the query
+		size_t index;
+		size_t posting_count;
+		double weight;
+		size_t document_count;
+		// The merged postings of a prefix word, which has no term id
+		const PostingList* prefix_postings;
+		// Documents with the word rejected by the predicate, only counted for a trace
+		size_t filtered_count;
+	};
+	const auto by_term_id = [](const auto& lhs, const auto& rhs)
+	{
+		return lhs.term_id < rhs.term_id;
+	};
+	const CorpusStatistics corpus = GetCorpusStatistics(statistics);
+
+	std::pmr::vector<const PostingList*> required_postings(scratch.GetResource());
+	for (const std::string_view& word : query.required_words)
+	{
+		const PostingList* postings = FindPostings(query, word);
+		if (postings == nullptr)
+		{
+			required_postings.clear();
+			break;
+		}
+		required_postings.push_back(postings);
+	}
+	const std::pmr::vector<int> document_ids = required_postings.empty()
+		? std::pmr::vector<int>(scratch.GetResource())
+		: IntersectPostings(required_postings, scratch.GetResource());
+	PROFILE_COUNT("documents intersected", document_ids.size());
+
+	// Ordered by term id as the forward index, so every document is matched in one pass
+	const auto resolve = [&](const std::pmr::vector<std::string_view>& words, bool is_plus)
+	{
+		std::pmr::vector<QueryTerm> terms(scratch.GetResource());
+		for (size_t index = 0; index < words.size(); ++index)
+		{
+			const PostingList* postings = FindPostings(query, words[index]);
+			if (postings != nullptr)
+			{
+				const double weight = is_plus ? ranking.ComputeTermWeight(corpus, GetDocumentFreq(words[index], *postings, statistics)) : 0.0;
+				const bool is_prefix = FindPrefixTerm(query, words[index]) != nullptr;
+				terms.push_back({ is_prefix ? -1 : FindTermId(words[index]), index, postings->size(), weight, 0, is_prefix ? postings : nullptr, 0 });
+			}
+		}
+		std::sort(terms.begin(), terms.end(), by_term_id);
+		return terms;
+	};
+	std::pmr::vector<QueryTerm> plus_terms = resolve(query.plus_words, true);
+	std::pmr::vector<QueryTerm> minus_terms = resolve(query.minus_words, false);
+
+	std::vector<Document> matched_documents;
+	for (const int document_id : document_ids)
+	{
+		const auto& document_data = documents_.at(document_id);
+		const auto& terms = document_data.terms;
+		const auto has_term = [&](const QueryTerm& term)
+		{
+			return term.prefix_postings != nullptr
+				? term.prefix_postings->Contains(document_id)
+				: std::binary_search(terms.begin(), terms.end(), TermCount{ term.term_id, 0 }, by_term_id);
+		};
+		if (!document_predicate(document_id, document_data.status, document_data.rating))
+		{
+			if constexpr (IS_TRACING<Trace>)
+			{
+				for (QueryTerm& plus_term : plus_terms)
+				{
+					plus_term.filtered_count += has_term(plus_term) ? 1 : 0;
+				}
+			}
+			continue;
+		}
+		const auto excluded = std::find_if(minus_terms.begin(), minus_terms.end(), has_term);
+		if (excluded != minus_terms.end())
+		{
+			++excluded->document_count;
+			continue;
+		}
+
+		double relevance = 0.0;
+		auto position = terms.begin();
+		for (QueryTerm& plus_term : plus_terms)
+		{
+			if (plus_term.prefix_postings != nullptr)
+			{
+				const uint32_t term_count = plus_term.prefix_postings->GetTermCount(document_id);
+				if (term_count > 0)
+				{
+					relevance += ranking.ComputeScore(corpus, plus_term.weight, term_count, document_data.word_count, document_data.rating);
+					++plus_term.document_count;
+				}
+				continue;
+			}
+			position = std::lower_bound(position, terms.end(), TermCount{ plus_term.term_id, 0 }, by_term_id);
+			if (position == terms.end())
+			{
+				break;
+			}
+			if (position->term_id == plus_term.term_id)
+			{
+				relevance += ranking.ComputeScore(corpus, plus_term.weight, position->count, document_data.word_count, document_data.rating);
+				++plus_term.document_count;
+			}
+		}
+		matched_documents.push_back({ document_id, relevance, document_data.rating });
+	}
+
+	if constexpr (IS_TRACING<Trace>)
+	{
+		for (const QueryTerm& plus_term : plus_terms)
+		{
+			TracePlusTerm(trace.plus_terms[plus_term.index], plus_term.posting_count, plus_term.weight, plus_term.document_count, plus_term.filtered_count);
+		}
+		for (const QueryTerm& minus_term : minus_terms)
+		{
+			TraceMinusTerm(trace.minus_terms[minus_term.index], minus_term.posting_count, minus_term.document_count);
+		}
+		trace.score_time = QueryTrace::Clock::now() - phase_start;
+		SumTrace(trace);
+	}
+	return matched_documents;
+}
+
+template <typename Container>
+void SearchServer::SortAndUnique(Container& vec_to_normalize)
+{
+	if (vec_to_normalize.size() > 1)
+	{
+		const auto& begin_iter = vec_to_normalize.begin();
+		const auto& end_iter = vec_to_normalize.end();
+		std::sort(begin_iter, end_iter);
+		auto it_pl = std::unique(begin_iter, end_iter);
+		vec_to_normalize.resize(it_pl - begin_iter);
+	}
+}
+
 template <typename ExecutionPolicy>
-SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy& policy, const std::string_view& text) const
+SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy& policy, const std::string_view& text, std::pmr::memory_resource* resource) const
 {
-	Query result;
+	Query result(resource);
 	auto& min_words = result.minus_words;
 	auto& pls_words = result.plus_words;
 
-	auto words = SplitIntoWords(text);
+	auto words = SplitIntoWords(text, resource);
+	ParsePositionConstraints(words, result);
 
 	if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>)
 	{
@@ -382,7 +1048,24 @@ SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy& policy, cons
 			else
 			{
 				pls_words.push_back(query_word.data);
+				if (query_word.is_required)
+				{
+					result.required_words.push_back(query_word.data);
+				}
 			}
+			if (query_word.is_prefix)
+			{
+				AddPrefixTerm(result, query_word.data, query_word.is_minus);
+			}
+		}
+	}
+
+	if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>)
+	{
+		// A word given both with and without the plus is one plus word
+		if (!result.required_words.empty())
+		{
+			SortAndUnique(pls_words);
 		}
 	}
 
@@ -0,0 +1,181 @@
+#include "shard_coordinator.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+using std::string_literals::operator""s;
+
+ShardCoordinator::ShardCoordinator(std::vector<std::string> socket_paths)
+	: socket_paths_(std::move(socket_paths))
+	, connections_(socket_paths_.size())
+{
+	if (socket_paths_.empty())
+	{
+		throw std::invalid_argument("Координатору не передано ни одного сегмента"s);
+	}
+}
+
+void ShardCoordinator::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings)
+{
+	MessageWriter request(ShardMessageType::ADD_DOCUMENT_REQUEST);
+	request.PutSigned(document_id).PutStatus(status).PutUnsigned(ratings.size());
+	for (const int rating : ratings)
+	{
+		request.PutSigned(rating);
+	}
+	request.PutString(document);
+	Call(ShardedSearchServer::GetShardIndex(document_id, GetShardCount()), request.GetData(), ShardMessageType::OK_RESPONSE);
+}
+
+void ShardCoordinator::RemoveDocument(int document_id)
+{
+	const std::string request = MessageWriter(ShardMessageType::REMOVE_DOCUMENT_REQUEST).PutSigned(document_id).GetData();
+	Call(ShardedSearchServer::GetShardIndex(document_id, GetShardCount()), request, ShardMessageType::OK_RESPONSE);
+}
+
+std::vector<Document> ShardCoordinator::FindTopDocuments(std::string_view raw_query, DocumentStatus status)
+{
+	const std::string statistics_request = MessageWriter(ShardMessageType::STATISTICS_REQUEST).PutString(raw_query).GetData();
+	QueryStatistics statistics;
+	for (const std::string& response : Scatter(std::vector<std::string>(GetShardCount(), statistics_request), ShardMessageType::STATISTICS_RESPONSE))
+	{
+		MessageReader reader(response);
+		statistics.Merge(reader.GetStatistics());
+		reader.ExpectEnd();
+	}
+
+	const std::string search_request = MessageWriter(ShardMessageType::SEARCH_REQUEST).PutString(raw_query).PutStatus(status).PutStatistics(statistics).GetData();
+	std::vector<Document> matched_documents;
+	for (const std::string& response : Scatter(std::vector<std::string>(GetShardCount(), search_request), ShardMessageType::SEARCH_RESPONSE))
+	{
+		MessageReader reader(response);
+		const std::vector<Document> shard_documents = reader.GetDocuments();
+		reader.ExpectEnd();
+		matched_documents.insert(matched_documents.end(), shard_documents.begin(), shard_documents.end());
+	}
+
+	std::sort(matched_documents.begin(), matched_documents.end(), &SearchServer::IsMoreRelevant);
+	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+	{
+		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	}
+	return matched_documents;
+}
+
+size_t ShardCoordinator::GetDocumentCount()
+{
+	const std::string request = MessageWriter(ShardMessageType::DOCUMENT_COUNT_REQUEST).GetData();
+	size_t document_count = 0;
+	for (const std::string& response : Scatter(std::vector<std::string>(GetShardCount(), request), ShardMessageType::DOCUMENT_COUNT_RESPONSE))
+	{
+		MessageReader reader(response);
+		document_count += reader.GetUnsigned();
+		reader.ExpectEnd();
+	}
+	return document_count;
+}
+
+size_t ShardCoordinator::GetShardCount() const
+{
+	return socket_paths_.size();
+}
+
+std::vector<std::string> ShardCoordinator::Scatter(const std::vector<std::string>& requests, ShardMessageType response_type)
+{
+	std::exception_ptr error;
+	const auto keep_first_error = [&error]()
+	{
+		if (!error)
+		{
+			error = std::current_exception();
+		}
+	};
+
+	std::vector<bool> sent(requests.size());
+	for (size_t shard = 0; shard < requests.size(); ++shard)
+	{
+		try
+		{
+			Send(shard, requests[shard]);
+			sent[shard] = true;
+		}
+		catch (...)
+		{
+			keep_first_error();
+		}
+	}
+	// Every sent request is answered even after a failure, otherwise the answer would be taken for that of the next request
+	std::vector<std::string> responses(requests.size());
+	for (size_t shard = 0; shard < requests.size(); ++shard)
+	{
+		try
+		{
+			if (sent[shard])
+			{
+				responses[shard] = Receive(shard, response_type);
+			}
+		}
+		catch (...)
+		{
+			keep_first_error();
+		}
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return responses;
+}
+
+std::string ShardCoordinator::Call(size_t shard, const std::string& request, ShardMessageType response_type)
+{
+	Send(shard, request);
+	return Receive(shard, response_type);
+}
+
+void ShardCoordinator::Send(size_t shard, const std::string& request)
+{
+	UnixSocket& connection = connections_[shard];
+	if (connection)
+	{
+		try
+		{
+			connection.WriteFrame(request);
+			return;
+		}
+		catch (const std::exception&)
+		{
+			// The shard closed the connection, most likely it was restarted
+			connection.Close();
+		}
+	}
+	connection = UnixSocket::Connect(socket_paths_[shard]);
+	connection.WriteFrame(request);
+}
+
+std::string ShardCoordinator::Receive(size_t shard, ShardMessageType response_type)
+{
+	UnixSocket& connection = connections_[shard];
+	std::optional<std::string> response;
+	try
+	{
+		response = connection.ReadFrame();
+	}
+	catch (const std::exception&)
+	{
+		connection.Close();
+		throw;
+	}
+	if (!response)
+	{
+		connection.Close();
+		throw std::runtime_error("Сегмент "s + socket_paths_[shard] + " закрыл соединение, не ответив на запрос"s);
+	}
+	MessageReader(*response).ExpectType(response_type);
+	return std::move(*response);
+}
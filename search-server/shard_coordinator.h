@@ -0,0 +1,39 @@
+#pragma once
+
+#include "document.h"
+#include "shard_protocol.h"
+#include "unix_socket.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Front of several shard server processes, see ShardService. A query is scattered to all shards twice:
+// first for the document frequencies of its words, then with the summed frequencies for the top documents
+// of every shard, which are merged as in ShardedSearchServer. Documents are routed to the shard
+// ShardedSearchServer would give them, so the same shard count splits a collection in the same way.
+//
+// One connection per shard is kept and reopened after the shard restarts. A request that fails
+// on the way back throws, the next one reconnects. The coordinator itself is not thread-safe
+class ShardCoordinator
+{
+public:
+	explicit ShardCoordinator(std::vector<std::string> socket_paths);
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+	void RemoveDocument(int document_id);
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+	size_t GetDocumentCount();
+	size_t GetShardCount() const;
+
+private:
+	std::vector<std::string> socket_paths_;
+	std::vector<UnixSocket> connections_;
+
+	// Sends every request to its shard before reading the first response, so that the shards work at the same time.
+	// The responses are checked to have the expected type
+	std::vector<std::string> Scatter(const std::vector<std::string>& requests, ShardMessageType response_type);
+	std::string Call(size_t shard, const std::string& request, ShardMessageType response_type);
+	void Send(size_t shard, const std::string& request);
+	std::string Receive(size_t shard, ShardMessageType response_type);
+};
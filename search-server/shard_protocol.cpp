@@ -0,0 +1,228 @@
+#include "shard_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using std::string_literals::operator""s;
+
+MessageWriter::MessageWriter(ShardMessageType type)
+	: data_(1, static_cast<char>(type))
+{}
+
+MessageWriter& MessageWriter::PutUnsigned(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		data_ += static_cast<char>((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	data_ += static_cast<char>(value);
+	return *this;
+}
+
+MessageWriter& MessageWriter::PutSigned(int64_t value)
+{
+	// Zigzag keeps small negative numbers short
+	return PutUnsigned((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+MessageWriter& MessageWriter::PutDouble(double value)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		data_ += static_cast<char>((bits >> (byte * 8)) & 0xFF);
+	}
+	return *this;
+}
+
+MessageWriter& MessageWriter::PutString(std::string_view value)
+{
+	PutUnsigned(value.size());
+	data_.append(value.data(), value.size());
+	return *this;
+}
+
+MessageWriter& MessageWriter::PutStatus(DocumentStatus status)
+{
+	return PutUnsigned(static_cast<uint64_t>(status));
+}
+
+MessageWriter& MessageWriter::PutStatistics(const QueryStatistics& statistics)
+{
+	PutUnsigned(statistics.document_count);
+	PutUnsigned(statistics.word_count);
+	PutUnsigned(statistics.document_freqs.size());
+	for (const auto& [word, document_freq] : statistics.document_freqs)
+	{
+		PutString(word);
+		PutUnsigned(document_freq);
+	}
+	return *this;
+}
+
+MessageWriter& MessageWriter::PutDocuments(const std::vector<Document>& documents)
+{
+	PutUnsigned(documents.size());
+	for (const Document& document : documents)
+	{
+		PutSigned(document.id);
+		PutDouble(document.relevance);
+		PutSigned(document.rating);
+	}
+	return *this;
+}
+
+const std::string& MessageWriter::GetData() const
+{
+	return data_;
+}
+
+MessageReader::MessageReader(std::string_view data)
+	: data_(data)
+{
+	if (data_.empty())
+	{
+		throw std::runtime_error("Пустое сообщение сегмента"s);
+	}
+	type_ = static_cast<ShardMessageType>(data_[0]);
+}
+
+ShardMessageType MessageReader::GetType() const
+{
+	return type_;
+}
+
+uint64_t MessageReader::GetUnsigned()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		Require(1);
+		const uint8_t byte = static_cast<uint8_t>(data_[position_++]);
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	throw std::runtime_error("Слишком длинное число в сообщении сегмента"s);
+}
+
+int64_t MessageReader::GetSigned()
+{
+	const uint64_t value = GetUnsigned();
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+double MessageReader::GetDouble()
+{
+	Require(8);
+	uint64_t bits = 0;
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[position_++])) << (byte * 8);
+	}
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+std::string_view MessageReader::GetString()
+{
+	const uint64_t size = GetUnsigned();
+	Require(size);
+	const std::string_view value = data_.substr(position_, size);
+	position_ += size;
+	return value;
+}
+
+DocumentStatus MessageReader::GetStatus()
+{
+	const uint64_t status = GetUnsigned();
+	if (status > static_cast<uint64_t>(DocumentStatus::REMOVED))
+	{
+		throw std::runtime_error("Неизвестный статус документа в сообщении сегмента"s);
+	}
+	return static_cast<DocumentStatus>(status);
+}
+
+QueryStatistics MessageReader::GetStatistics()
+{
+	QueryStatistics statistics;
+	statistics.document_count = GetUnsigned();
+	statistics.word_count = GetUnsigned();
+	const uint64_t word_count = GetUnsigned();
+	for (uint64_t index = 0; index < word_count; ++index)
+	{
+		const std::string_view word = GetString();
+		statistics.document_freqs.emplace(word, GetUnsigned());
+	}
+	return statistics;
+}
+
+std::vector<Document> MessageReader::GetDocuments()
+{
+	const uint64_t count = GetUnsigned();
+	// Every document takes at least ten bytes, which bounds the reservation by the message size
+	if (count > (data_.size() - position_) / 10)
+	{
+		throw std::runtime_error("Сообщение сегмента обрезано"s);
+	}
+	std::vector<Document> documents;
+	documents.reserve(count);
+	for (uint64_t index = 0; index < count; ++index)
+	{
+		const int id = static_cast<int>(GetSigned());
+		const double relevance = GetDouble();
+		documents.emplace_back(id, relevance, static_cast<int>(GetSigned()));
+	}
+	return documents;
+}
+
+std::vector<int> MessageReader::GetRatings()
+{
+	const uint64_t count = GetUnsigned();
+	// Every rating takes at least one byte
+	if (count > data_.size() - position_)
+	{
+		throw std::runtime_error("Сообщение сегмента обрезано"s);
+	}
+	std::vector<int> ratings(count);
+	for (int& rating : ratings)
+	{
+		rating = static_cast<int>(GetSigned());
+	}
+	return ratings;
+}
+
+void MessageReader::ExpectEnd() const
+{
+	if (position_ != data_.size())
+	{
+		throw std::runtime_error("Лишние данные в конце сообщения сегмента"s);
+	}
+}
+
+void MessageReader::ExpectType(ShardMessageType type) const
+{
+	if (type_ == type)
+	{
+		return;
+	}
+	if (type_ == ShardMessageType::ERROR_RESPONSE)
+	{
+		MessageReader error(data_);
+		throw std::runtime_error(std::string(error.GetString()));
+	}
+	throw std::runtime_error("Неожиданный тип сообщения сегмента: "s + std::to_string(static_cast<int>(type_)));
+}
+
+void MessageReader::Require(size_t size) const
+{
+	if (size > data_.size() - position_)
+	{
+		throw std::runtime_error("Сообщение сегмента обрезано"s);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "document.h"
+#include "ranking.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Messages between a shard coordinator and shard servers. Every message is one frame (see UnixSocket)
+// whose payload starts with the message type. Integers are LEB128 varints, signed ones zigzag-encoded,
+// doubles are 8 little-endian bytes and strings are a varint length followed by the bytes.
+//
+//     STATISTICS_REQUEST       query                          -> STATISTICS_RESPONSE  statistics
+//     SEARCH_REQUEST           query, status, statistics      -> SEARCH_RESPONSE      documents
+//     ADD_DOCUMENT_REQUEST     id, status, ratings, text      -> OK_RESPONSE
+//     REMOVE_DOCUMENT_REQUEST  id                             -> OK_RESPONSE
+//     DOCUMENT_COUNT_REQUEST                                  -> DOCUMENT_COUNT_RESPONSE  count
+//
+// Any request may be answered with ERROR_RESPONSE carrying the text of the exception thrown by the shard
+enum class ShardMessageType : uint8_t
+{
+	STATISTICS_REQUEST = 1,
+	STATISTICS_RESPONSE,
+	SEARCH_REQUEST,
+	SEARCH_RESPONSE,
+	ADD_DOCUMENT_REQUEST,
+	REMOVE_DOCUMENT_REQUEST,
+	DOCUMENT_COUNT_REQUEST,
+	DOCUMENT_COUNT_RESPONSE,
+	OK_RESPONSE,
+	ERROR_RESPONSE,
+};
+
+class MessageWriter
+{
+public:
+	explicit MessageWriter(ShardMessageType type);
+
+	MessageWriter& PutUnsigned(uint64_t value);
+	MessageWriter& PutSigned(int64_t value);
+	MessageWriter& PutDouble(double value);
+	MessageWriter& PutString(std::string_view value);
+	MessageWriter& PutStatus(DocumentStatus status);
+	MessageWriter& PutStatistics(const QueryStatistics& statistics);
+	MessageWriter& PutDocuments(const std::vector<Document>& documents);
+
+	const std::string& GetData() const;
+
+private:
+	std::string data_;
+};
+
+// Reads the fields in the order they were written, a truncated or malformed message throws std::runtime_error
+class MessageReader
+{
+public:
+	explicit MessageReader(std::string_view data);
+
+	ShardMessageType GetType() const;
+
+	uint64_t GetUnsigned();
+	int64_t GetSigned();
+	double GetDouble();
+	// Points into the message
+	std::string_view GetString();
+	DocumentStatus GetStatus();
+	QueryStatistics GetStatistics();
+	std::vector<Document> GetDocuments();
+	// A count followed by signed values
+	std::vector<int> GetRatings();
+
+	// Throws when unread bytes are left
+	void ExpectEnd() const;
+	// Throws the text of an ERROR_RESPONSE as std::runtime_error and any other unexpected type as well
+	void ExpectType(ShardMessageType type) const;
+
+private:
+	std::string_view data_;
+	size_t position_ = 1;
+	ShardMessageType type_;
+
+	void Require(size_t size) const;
+};
@@ -0,0 +1,116 @@
+// Shard server: owns one SearchServer and answers a ShardCoordinator over a Unix domain socket.
+//
+// Build from the search-server directory:
+//   g++ -std=c++17 -O2 -DNDEBUG shard_server/main.cpp $(ls *.cpp | grep -v '^main.cpp$') -ltbb -lpthread -o search_shard_server
+// Run:
+//   ./search_shard_server --socket /tmp/shard0.sock [--stop-words "and in on"] [--documents shard0.tsv]
+//
+// The documents file is loaded by LoadDocuments, see document_loader.h. SIGINT and SIGTERM stop the server
+
+#include "../document_loader.h"
+#include "../search_server.h"
+#include "../shard_service.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <pthread.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	struct Options
+	{
+		std::string socket_path;
+		std::string stop_words;
+		std::string documents_path;
+	};
+
+	Options ParseOptions(int argc, char* argv[])
+	{
+		Options options;
+		for (int index = 1; index + 1 < argc; index += 2)
+		{
+			const std::string_view name = argv[index];
+			if (name == "--socket")
+			{
+				options.socket_path = argv[index + 1];
+			}
+			else if (name == "--stop-words")
+			{
+				options.stop_words = argv[index + 1];
+			}
+			else if (name == "--documents")
+			{
+				options.documents_path = argv[index + 1];
+			}
+			else
+			{
+				throw std::invalid_argument("Неизвестный параметр "s + std::string(name));
+			}
+		}
+		if (argc % 2 == 0 || options.socket_path.empty())
+		{
+			throw std::invalid_argument("Использование: search_shard_server --socket PATH [--stop-words WORDS] [--documents FILE]"s);
+		}
+		return options;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+
+		// The signals are taken by a dedicated thread, the other threads inherit the blocked mask
+		sigset_t stop_signals;
+		sigemptyset(&stop_signals);
+		sigaddset(&stop_signals, SIGINT);
+		sigaddset(&stop_signals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+		SearchServer server(options.stop_words);
+		if (!options.documents_path.empty())
+		{
+			LoadDocuments(server, options.documents_path);
+		}
+		std::cerr << "Shard " << options.socket_path << ": " << server.GetDocumentCount() << " documents" << std::endl;
+
+		ShardService service(server);
+		std::thread signal_thread([&service, &stop_signals]()
+			{
+				int signal = 0;
+				sigwait(&stop_signals, &signal);
+				service.Stop();
+			});
+		// The thread uses the service, it is woken and joined before the service is destroyed
+		const auto stop_signal_thread = [&signal_thread]()
+			{
+				pthread_kill(signal_thread.native_handle(), SIGTERM);
+				signal_thread.join();
+			};
+		try
+		{
+			service.Serve(options.socket_path);
+		}
+		catch (...)
+		{
+			stop_signal_thread();
+			throw;
+		}
+		stop_signal_thread();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
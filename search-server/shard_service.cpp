@@ -0,0 +1,166 @@
+#include "shard_service.h"
+
+#include <execution>
+#include <stdexcept>
+
+using std::string_literals::operator""s;
+
+ShardService::ShardService(SearchServer& server)
+	: server_(server)
+{}
+
+ShardService::~ShardService()
+{
+	Stop();
+	JoinConnections(true);
+}
+
+std::string ShardService::HandleRequest(std::string_view request)
+{
+	try
+	{
+		MessageReader reader(request);
+		return HandleRequest(reader);
+	}
+	catch (const std::exception& e)
+	{
+		return MessageWriter(ShardMessageType::ERROR_RESPONSE).PutString(e.what()).GetData();
+	}
+}
+
+std::string ShardService::HandleRequest(MessageReader& request)
+{
+	switch (request.GetType())
+	{
+	case ShardMessageType::STATISTICS_REQUEST:
+	{
+		const std::string_view query = request.GetString();
+		request.ExpectEnd();
+		std::shared_lock lock(server_mutex_);
+		return MessageWriter(ShardMessageType::STATISTICS_RESPONSE).PutStatistics(server_.GetQueryStatistics(query)).GetData();
+	}
+	case ShardMessageType::SEARCH_REQUEST:
+	{
+		const std::string_view query = request.GetString();
+		const DocumentStatus status = request.GetStatus();
+		const QueryStatistics statistics = request.GetStatistics();
+		request.ExpectEnd();
+		std::shared_lock lock(server_mutex_);
+		const std::vector<Document> documents = server_.FindTopDocuments(std::execution::seq, query, [status](int document_id, DocumentStatus document_status, int rating)
+			{
+				return document_status == status;
+			}, statistics);
+		return MessageWriter(ShardMessageType::SEARCH_RESPONSE).PutDocuments(documents).GetData();
+	}
+	case ShardMessageType::ADD_DOCUMENT_REQUEST:
+	{
+		const int document_id = static_cast<int>(request.GetSigned());
+		const DocumentStatus status = request.GetStatus();
+		const std::vector<int> ratings = request.GetRatings();
+		const std::string_view text = request.GetString();
+		request.ExpectEnd();
+		std::lock_guard guard(server_mutex_);
+		server_.AddDocument(document_id, text, status, ratings);
+		return MessageWriter(ShardMessageType::OK_RESPONSE).GetData();
+	}
+	case ShardMessageType::REMOVE_DOCUMENT_REQUEST:
+	{
+		const int document_id = static_cast<int>(request.GetSigned());
+		request.ExpectEnd();
+		std::lock_guard guard(server_mutex_);
+		server_.RemoveDocument(document_id);
+		return MessageWriter(ShardMessageType::OK_RESPONSE).GetData();
+	}
+	case ShardMessageType::DOCUMENT_COUNT_REQUEST:
+	{
+		request.ExpectEnd();
+		std::shared_lock lock(server_mutex_);
+		return MessageWriter(ShardMessageType::DOCUMENT_COUNT_RESPONSE).PutUnsigned(server_.GetDocumentCount()).GetData();
+	}
+	default:
+		throw std::runtime_error("Неизвестный запрос к сегменту: "s + std::to_string(static_cast<int>(request.GetType())));
+	}
+}
+
+void ShardService::Serve(const std::string& socket_path)
+{
+	{
+		std::lock_guard guard(connections_mutex_);
+		if (stopping_)
+		{
+			return;
+		}
+		listener_ = UnixSocket::Listen(socket_path);
+	}
+
+	while (true)
+	{
+		UnixSocket socket = listener_.Accept();
+		JoinConnections(false);
+		std::lock_guard guard(connections_mutex_);
+		if (!socket || stopping_)
+		{
+			break;
+		}
+		Connection& connection = connections_.emplace_back();
+		connection.socket = std::move(socket);
+		connection.thread = std::thread([this, &connection]()
+			{
+				ServeConnection(connection);
+			});
+	}
+	JoinConnections(true);
+	std::lock_guard guard(connections_mutex_);
+	listener_.Close();
+}
+
+void ShardService::Stop()
+{
+	std::lock_guard guard(connections_mutex_);
+	stopping_ = true;
+	listener_.Shutdown();
+	for (const Connection& connection : connections_)
+	{
+		connection.socket.Shutdown();
+	}
+}
+
+void ShardService::ServeConnection(Connection& connection)
+{
+	try
+	{
+		while (const auto request = connection.socket.ReadFrame())
+		{
+			connection.socket.WriteFrame(HandleRequest(*request));
+		}
+	}
+	catch (const std::exception&)
+	{
+		// A broken connection only ends itself, the coordinator reconnects
+	}
+	connection.finished = true;
+}
+
+void ShardService::JoinConnections(bool all)
+{
+	std::list<Connection> finished;
+	{
+		std::lock_guard guard(connections_mutex_);
+		for (auto connection = connections_.begin(); connection != connections_.end();)
+		{
+			const auto next = std::next(connection);
+			if (all || connection->finished)
+			{
+				finished.splice(finished.end(), connections_, connection);
+			}
+			connection = next;
+		}
+	}
+	for (Connection& connection : finished)
+	{
+		if (connection.thread.joinable())
+		{
+			connection.thread.join();
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "search_server.h"
+#include "shard_protocol.h"
+#include "unix_socket.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Serves one SearchServer to shard coordinators over a Unix domain socket, see shard_protocol.h.
+// Every connection is handled by its own thread; searches share the server, updates lock it exclusively
+class ShardService
+{
+public:
+	explicit ShardService(SearchServer& server);
+	~ShardService();
+
+	// Answers one request, exceptions of the server become an ERROR_RESPONSE
+	std::string HandleRequest(std::string_view request);
+
+	// Accepts connections until Stop is called
+	void Serve(const std::string& socket_path);
+	// Called from another thread: closes the listening socket and all connections, Serve then returns
+	void Stop();
+
+private:
+	struct Connection
+	{
+		UnixSocket socket;
+		std::thread thread;
+		std::atomic<bool> finished{ false };
+	};
+
+	SearchServer& server_;
+	std::shared_mutex server_mutex_;
+
+	std::mutex connections_mutex_;
+	UnixSocket listener_;
+	std::list<Connection> connections_;
+	std::atomic<bool> stopping_{ false };
+
+	std::string HandleRequest(MessageReader& request);
+	void ServeConnection(Connection& connection);
+	// Joins the threads of closed connections, or of all of them
+	void JoinConnections(bool all);
+};
@@ -0,0 +1,205 @@
+#include "sharded_search_server.h"
+
+using std::string_literals::operator""s;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count)
+{
+	CreateShards(shard_count);
+}
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words, size_t shard_count)
+{
+	CreateShards(shard_count, stop_words);
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings)
+{
+	Shard& shard = shards_[GetShardIndex(document_id, shards_.size())];
+	{
+		std::lock_guard guard(shard.mutex);
+		shard.server.AddDocument(document_id, document, status, ratings);
+	}
+	std::lock_guard guard(document_ids_mutex_);
+	document_ids_.insert(document_id);
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<NewDocument>& documents)
+{
+	std::vector<std::vector<const NewDocument*>> shard_documents(shards_.size());
+	for (const NewDocument& document : documents)
+	{
+		shard_documents[GetShardIndex(document.id, shards_.size())].push_back(&document);
+	}
+
+	ForEachShard(std::execution::par, [&](size_t index)
+		{
+			std::exception_ptr error;
+			std::vector<int> added_ids;
+			{
+				std::lock_guard guard(shards_[index].mutex);
+				for (const NewDocument* document : shard_documents[index])
+				{
+					try
+					{
+						shards_[index].server.AddDocument(document->id, document->text, document->status, document->ratings);
+						added_ids.push_back(document->id);
+					}
+					catch (...)
+					{
+						if (!error)
+						{
+							error = std::current_exception();
+						}
+					}
+				}
+			}
+			{
+				std::lock_guard guard(document_ids_mutex_);
+				document_ids_.insert(added_ids.begin(), added_ids.end());
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		});
+}
+
+void ShardedSearchServer::SetRankingFunction(RankingFunction ranking_function)
+{
+	for (Shard& shard : shards_)
+	{
+		std::lock_guard guard(shard.mutex);
+		shard.server.SetRankingFunction(ranking_function);
+	}
+	ranking_function_ = ranking_function;
+}
+
+RankingFunction ShardedSearchServer::GetRankingFunction() const
+{
+	return ranking_function_;
+}
+
+void ShardedSearchServer::SetPositionalIndex(bool enabled)
+{
+	for (Shard& shard : shards_)
+	{
+		std::lock_guard guard(shard.mutex);
+		shard.server.SetPositionalIndex(enabled);
+	}
+}
+
+bool ShardedSearchServer::HasPositionalIndex() const
+{
+	return shards_.front().server.HasPositionalIndex();
+}
+
+void ShardedSearchServer::SetMaxPrefixExpansions(size_t count)
+{
+	for (Shard& shard : shards_)
+	{
+		std::lock_guard guard(shard.mutex);
+		shard.server.SetMaxPrefixExpansions(count);
+	}
+}
+
+size_t ShardedSearchServer::GetMaxPrefixExpansions() const
+{
+	return shards_.front().server.GetMaxPrefixExpansions();
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const
+{
+	return FindTopDocuments(std::execution::par, raw_query, status);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query) const
+{
+	return FindTopDocuments(std::execution::par, raw_query);
+}
+
+std::set<int>::const_iterator ShardedSearchServer::begin() const
+{
+	return document_ids_.begin();
+}
+
+std::set<int>::const_iterator ShardedSearchServer::end() const
+{
+	return document_ids_.end();
+}
+
+size_t ShardedSearchServer::GetDocumentCount() const
+{
+	std::lock_guard guard(document_ids_mutex_);
+	return document_ids_.size();
+}
+
+size_t ShardedSearchServer::GetShardCount() const
+{
+	return shards_.size();
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const
+{
+	return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const
+{
+	return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const
+{
+	// The matched words point into the term dictionary of the shard, which keeps them until it is cleared
+	const Shard& shard = shards_[GetShardIndex(document_id, shards_.size())];
+	std::shared_lock lock(shard.mutex);
+	return shard.server.MatchDocument(raw_query, document_id);
+}
+
+std::map<std::string, double> ShardedSearchServer::GetWordFrequencies(int document_id) const
+{
+	const Shard& shard = shards_[GetShardIndex(document_id, shards_.size())];
+	std::shared_lock lock(shard.mutex);
+	return shard.server.GetWordFrequencies(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id)
+{
+	RemoveDocument(std::execution::seq, document_id);
+}
+
+void ShardedSearchServer::RemoveDocuments(const std::vector<int>& document_ids)
+{
+	std::vector<std::vector<int>> shard_document_ids(shards_.size());
+	for (const int document_id : document_ids)
+	{
+		shard_document_ids[GetShardIndex(document_id, shards_.size())].push_back(document_id);
+	}
+
+	ForEachShard(std::execution::par, [&](size_t index)
+		{
+			std::lock_guard guard(shards_[index].mutex);
+			for (const int document_id : shard_document_ids[index])
+			{
+				shards_[index].server.RemoveDocument(document_id);
+			}
+		});
+
+	std::lock_guard guard(document_ids_mutex_);
+	for (const int document_id : document_ids)
+	{
+		document_ids_.erase(document_id);
+	}
+}
+
+size_t ShardedSearchServer::GetDefaultShardCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id, size_t shard_count)
+{
+	// Fibonacci hashing, so that ids sharing a stride still spread over all shards
+	const uint64_t hash = static_cast<uint64_t>(static_cast<uint32_t>(document_id)) * 11400714819323198485ull;
+	return static_cast<size_t>((hash >> 32) % shard_count);
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Documents hash-partitioned by id between several SearchServer shards, each with its own index and lock.
+// Writers lock only the shard of their document, so documents are added and removed on different shards
+// at the same time. A query is answered in two rounds over all shards: the document frequencies of its words
+// are collected and summed first, then every shard ranks its documents with these global numbers and the best
+// results of all shards are merged. Relevance is therefore the same as in one server holding all documents
+class ShardedSearchServer
+{
+public:
+	struct NewDocument
+	{
+		int id;
+		std::string_view text;
+		DocumentStatus status;
+		std::vector<int> ratings;
+	};
+
+	explicit ShardedSearchServer(size_t shard_count = GetDefaultShardCount());
+	// Not chosen for a lone shard count
+	template <typename StringCollection, typename = std::enable_if_t<!std::is_arithmetic_v<StringCollection>>>
+	explicit ShardedSearchServer(const StringCollection& stop_words, size_t shard_count = GetDefaultShardCount());
+	explicit ShardedSearchServer(const std::string& stop_words, size_t shard_count = GetDefaultShardCount());
+
+	void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+	// Indexes the shards in parallel. A rejected document doesn't stop the others, the first error is rethrown afterwards
+	void AddDocuments(const std::vector<NewDocument>& documents);
+
+	void SetRankingFunction(RankingFunction ranking_function);
+	RankingFunction GetRankingFunction() const;
+	// See SearchServer::SetPositionalIndex
+	void SetPositionalIndex(bool enabled);
+	bool HasPositionalIndex() const;
+	void SetMaxPrefixExpansions(size_t count);
+	size_t GetMaxPrefixExpansions() const;
+
+	// The shards are searched in parallel unless a sequential policy is given
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const;
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentStatus status) const;
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query) const;
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking) const;
+
+	// Iteration over the ids of all shards in ascending order, not safe while documents are added or removed
+	std::set<int>::const_iterator begin() const;
+	std::set<int>::const_iterator end() const;
+
+	size_t GetDocumentCount() const;
+	size_t GetShardCount() const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	std::map<std::string, double> GetWordFrequencies(int document_id) const;
+
+	template <class ExecutionPolicy>
+	void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+	void RemoveDocument(int document_id);
+	// Removes the documents of different shards in parallel
+	void RemoveDocuments(const std::vector<int>& document_ids);
+
+	static size_t GetDefaultShardCount();
+	// The shard a document belongs to, also used to route documents between shard server processes
+	static size_t GetShardIndex(int document_id, size_t shard_count);
+
+private:
+	struct Shard
+	{
+		template <typename... StopWords>
+		explicit Shard(const StopWords&... stop_words)
+			: server(stop_words...)
+		{}
+
+		SearchServer server;
+		mutable std::shared_mutex mutex;
+	};
+
+	// A deque because shards hold a mutex and cannot be moved
+	std::deque<Shard> shards_;
+	std::set<int> document_ids_;
+	mutable std::mutex document_ids_mutex_;
+	RankingFunction ranking_function_ = RankingFunction::TF_IDF;
+
+	template <typename... StopWords>
+	void CreateShards(size_t shard_count, const StopWords&... stop_words);
+	// Calls function(shard_index) for every shard. Exceptions are collected and the first one is rethrown
+	// after all shards are done, a parallel algorithm would terminate the program instead
+	template <typename ExecutionPolicy, typename Function>
+	void ForEachShard(const ExecutionPolicy& policy, Function function) const;
+	// search(server, statistics) returns the top documents of one shard ranked with the merged statistics
+	template <typename ExecutionPolicy, typename Search>
+	std::vector<Document> SearchShards(const ExecutionPolicy& policy, const std::string_view& raw_query, Search search) const;
+};
+
+template <typename StringCollection, typename>
+ShardedSearchServer::ShardedSearchServer(const StringCollection& stop_words, size_t shard_count)
+{
+	CreateShards(shard_count, stop_words);
+}
+
+template <typename... StopWords>
+void ShardedSearchServer::CreateShards(size_t shard_count, const StopWords&... stop_words)
+{
+	using std::string_literals::operator""s;
+
+	if (shard_count == 0)
+	{
+		throw std::invalid_argument("Число сегментов поискового сервера должно быть положительным"s);
+	}
+	for (size_t index = 0; index < shard_count; ++index)
+	{
+		shards_.emplace_back(stop_words...);
+	}
+}
+
+template <typename ExecutionPolicy, typename Function>
+void ShardedSearchServer::ForEachShard(const ExecutionPolicy& policy, Function function) const
+{
+	std::vector<size_t> indexes(shards_.size());
+	std::iota(indexes.begin(), indexes.end(), 0);
+	std::vector<std::exception_ptr> errors(shards_.size());
+	std::for_each(policy, indexes.begin(), indexes.end(), [&function, &errors](size_t index)
+		{
+			try
+			{
+				function(index);
+			}
+			catch (...)
+			{
+				errors[index] = std::current_exception();
+			}
+		});
+	for (const std::exception_ptr& error : errors)
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+}
+
+template <typename ExecutionPolicy, typename Search>
+std::vector<Document> ShardedSearchServer::SearchShards(const ExecutionPolicy& policy, const std::string_view& raw_query, Search search) const
+{
+	// The shards stay locked between the rounds, so that the statistics describe the indexes that are searched.
+	// Writers take a single lock, which rules out a deadlock with the ordered locking here
+	std::vector<std::shared_lock<std::shared_mutex>> locks;
+	locks.reserve(shards_.size());
+	for (const Shard& shard : shards_)
+	{
+		locks.emplace_back(shard.mutex);
+	}
+
+	std::vector<QueryStatistics> shard_statistics(shards_.size());
+	ForEachShard(policy, [&](size_t index)
+		{
+			shard_statistics[index] = shards_[index].server.GetQueryStatistics(raw_query);
+		});
+	QueryStatistics statistics;
+	for (const QueryStatistics& shard : shard_statistics)
+	{
+		statistics.Merge(shard);
+	}
+
+	std::vector<std::vector<Document>> shard_results(shards_.size());
+	ForEachShard(policy, [&](size_t index)
+		{
+			shard_results[index] = search(shards_[index].server, statistics);
+		});
+
+	// Every shard returns its best documents, the best of the whole collection are among them
+	std::vector<Document> matched_documents;
+	for (const std::vector<Document>& shard : shard_results)
+	{
+		matched_documents.insert(matched_documents.end(), shard.begin(), shard.end());
+	}
+	std::sort(matched_documents.begin(), matched_documents.end(), &SearchServer::IsMoreRelevant);
+	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+	{
+		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	}
+	return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranking>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate, const Ranking& ranking) const
+{
+	return SearchShards(policy, raw_query, [&](const SearchServer& server, const QueryStatistics& statistics)
+		{
+			return server.FindTopDocuments(std::execution::seq, raw_query, document_predicate, ranking, statistics);
+		});
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const
+{
+	return SearchShards(policy, raw_query, [&](const SearchServer& server, const QueryStatistics& statistics)
+		{
+			return server.FindTopDocuments(std::execution::seq, raw_query, document_predicate, statistics);
+		});
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentStatus status) const
+{
+	return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating)
+		{
+			return document_status == status;
+		});
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query) const
+{
+	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const
+{
+	return FindTopDocuments(std::execution::par, raw_query, document_predicate);
+}
+
+template <class ExecutionPolicy>
+void ShardedSearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id)
+{
+	Shard& shard = shards_[GetShardIndex(document_id, shards_.size())];
+	{
+		std::lock_guard guard(shard.mutex);
+		shard.server.RemoveDocument(policy, document_id);
+	}
+	std::lock_guard guard(document_ids_mutex_);
+	document_ids_.erase(document_id);
+}
@@ -1,9 +1,8 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text)
+template <typename Container>
+static Container SplitIntoWordsTo(std::string_view text, Container words)
 {
-	std::vector<std::string_view> words;
-
 	auto word_begin_iter = text.begin();
 	auto word_end_iter = text.end();
 
@@ -28,4 +27,14 @@ std::vector<std::string_view> SplitIntoWords(std::string_view text)
 			std::distance(word_begin_iter, word_end_iter)));
 	}
 	return words;
-}
\ No newline at end of file
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text)
+{
+	return SplitIntoWordsTo(text, std::vector<std::string_view>());
+}
+
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource)
+{
+	return SplitIntoWordsTo(text, std::pmr::vector<std::string_view>(resource));
+}
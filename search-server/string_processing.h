@@ -1,5 +1,7 @@
 #pragma once
+#include <memory_resource>
 #include <string>
 #include <vector>
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource);
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "term_dictionary.h"
+#include "varint.h"
+
+#include <algorithm>
+
+TermDictionary::TermDictionary(const allocator_type& allocator)
+	: bytes_(allocator)
+	, block_offsets_(allocator)
+	, pending_(allocator)
+{}
+
+void TermDictionary::Add(std::string_view word, int term_id)
+{
+	pending_.emplace(word, term_id);
+	// Every merge rewrites the whole dictionary, so the words waiting for it grow with the dictionary
+	if (pending_.size() > std::max(BLOCK_SIZE * 4, coded_count_ / 8))
+	{
+		Merge();
+	}
+}
+
+void TermDictionary::FindPrefix(std::string_view prefix, std::pmr::vector<int>& term_ids) const
+{
+	const auto has_prefix = [prefix](std::string_view word)
+	{
+		return word.substr(0, prefix.size()) == prefix;
+	};
+
+	if (!block_offsets_.empty())
+	{
+		// The block before the first one starting at or after the prefix may end with words having it
+		size_t low = 0;
+		size_t high = block_offsets_.size();
+		while (low < high)
+		{
+			const size_t middle = (low + high) / 2;
+			if (GetBlockHead(middle) < prefix)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		std::string word;
+		size_t position = block_offsets_[low == 0 ? 0 : low - 1];
+		while (position < bytes_.size())
+		{
+			const uint32_t shared_size = ReadVarint(bytes_.data(), position);
+			const uint32_t suffix_size = ReadVarint(bytes_.data(), position);
+			word.resize(shared_size);
+			word.append(reinterpret_cast<const char*>(bytes_.data() + position), suffix_size);
+			position += suffix_size;
+			const int term_id = static_cast<int>(ReadVarint(bytes_.data(), position));
+			if (has_prefix(word))
+			{
+				term_ids.push_back(term_id);
+			}
+			else if (word > prefix)
+			{
+				break;
+			}
+		}
+	}
+
+	for (auto pending = pending_.lower_bound(prefix); pending != pending_.end() && has_prefix(pending->first); ++pending)
+	{
+		term_ids.push_back(pending->second);
+	}
+}
+
+size_t TermDictionary::size() const
+{
+	return coded_count_ + pending_.size();
+}
+
+void TermDictionary::clear()
+{
+	bytes_.clear();
+	bytes_.shrink_to_fit();
+	block_offsets_.clear();
+	block_offsets_.shrink_to_fit();
+	coded_count_ = 0;
+	pending_.clear();
+}
+
+void TermDictionary::Merge()
+{
+	std::pmr::vector<uint8_t> bytes(bytes_.get_allocator());
+	std::pmr::vector<uint32_t> block_offsets(block_offsets_.get_allocator());
+	bytes.reserve(bytes_.size() + bytes_.size() / 4);
+	std::string previous;
+	size_t count = 0;
+	const auto append = [&](std::string_view word, int term_id)
+	{
+		size_t shared_size = 0;
+		if (count % BLOCK_SIZE == 0)
+		{
+			block_offsets.push_back(static_cast<uint32_t>(bytes.size()));
+		}
+		else
+		{
+			const size_t limit = std::min(previous.size(), word.size());
+			while (shared_size < limit && previous[shared_size] == word[shared_size])
+			{
+				++shared_size;
+			}
+		}
+		WriteVarint(bytes, static_cast<uint32_t>(shared_size));
+		WriteVarint(bytes, static_cast<uint32_t>(word.size() - shared_size));
+		bytes.insert(bytes.end(), word.begin() + shared_size, word.end());
+		WriteVarint(bytes, static_cast<uint32_t>(term_id));
+		previous.assign(word);
+		++count;
+	};
+
+	// Both the coded words and the waiting ones are sorted, so one pass merges them
+	auto pending = pending_.begin();
+	std::string word;
+	size_t position = 0;
+	for (size_t index = 0; index < coded_count_; ++index)
+	{
+		const uint32_t shared_size = ReadVarint(bytes_.data(), position);
+		const uint32_t suffix_size = ReadVarint(bytes_.data(), position);
+		word.resize(shared_size);
+		word.append(reinterpret_cast<const char*>(bytes_.data() + position), suffix_size);
+		position += suffix_size;
+		const int term_id = static_cast<int>(ReadVarint(bytes_.data(), position));
+		for (; pending != pending_.end() && pending->first < word; ++pending)
+		{
+			append(pending->first, pending->second);
+		}
+		append(word, term_id);
+	}
+	for (; pending != pending_.end(); ++pending)
+	{
+		append(pending->first, pending->second);
+	}
+
+	bytes_.swap(bytes);
+	block_offsets_.swap(block_offsets);
+	coded_count_ = count;
+	pending_.clear();
+}
+
+std::string_view TermDictionary::GetBlockHead(size_t block_index) const
+{
+	size_t position = block_offsets_[block_index];
+	// The head shares nothing with a previous word
+	ReadVarint(bytes_.data(), position);
+	const uint32_t size = ReadVarint(bytes_.data(), position);
+	return std::string_view(reinterpret_cast<const char*>(bytes_.data() + position), size);
+}
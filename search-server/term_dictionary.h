@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sorted dictionary of term words answering prefix lookups. The words are front coded: they are stored in blocks of
+// BLOCK_SIZE, the first word of a block in full and every other one as the length of the prefix it shares with the
+// previous word followed by the rest, so a lookup binary searches the block heads and decodes a contiguous run of bytes.
+// New words wait in a small sorted map and are merged into the coded blocks once it grows past a share of them,
+// which keeps the cost of adding a word constant on average
+class TermDictionary
+{
+public:
+	static const size_t BLOCK_SIZE = 16;
+
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	TermDictionary() = default;
+	explicit TermDictionary(const allocator_type& allocator);
+
+	// The word must not be in the dictionary yet and must stay valid until it is merged
+	void Add(std::string_view word, int term_id);
+	// Appends the ids of all words starting with the prefix
+	void FindPrefix(std::string_view prefix, std::pmr::vector<int>& term_ids) const;
+
+	size_t size() const;
+	void clear();
+
+private:
+	std::pmr::vector<uint8_t> bytes_;
+	std::pmr::vector<uint32_t> block_offsets_;
+	size_t coded_count_ = 0;
+	std::pmr::map<std::string_view, int> pending_;
+
+	void Merge();
+	std::string_view GetBlockHead(size_t block_index) const;
+};
@@ -1,6 +1,7 @@
 #include "test_example_functions.h"
 
 using std::string_literals::operator""s;
+using std::string_view_literals::operator""sv;
 
 void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
 	const std::string& hint)
@@ -724,6 +725,1667 @@ void TestRemoveDuplicates(void)
 	RemoveDuplicates(search_server);
 }
 
+void TestDuplicateDetectionAtIngest(void)
+{
+	SearchServer search_server("and with"s);
+	search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+
+	// индекс отпечатков строится по уже добавленным документам при включении режима
+	search_server.SetDuplicateMode(DuplicateMode::REJECT);
+	search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+	ASSERT(search_server.FindDuplicate("funny funny pet and nasty nasty rat"s) == std::optional<int>(1));
+	ASSERT(search_server.FindDuplicate("curly hair with funny pet"s) == std::optional<int>(2));
+	ASSERT(!search_server.FindDuplicate("funny pet and not very nasty rat"s));
+
+	try
+	{
+		search_server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+		ASSERT_HINT(false, "Должно было сработать исключение при добавлении дубликата"s);
+	}
+	catch (const DuplicateDocumentError& e)
+	{
+		ASSERT_EQUAL(e.GetDocumentId(), 4);
+		ASSERT_EQUAL(e.GetOriginalId(), 2);
+	}
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+	ASSERT(search_server.FindTopDocuments("curly"s).size() == 1);
+
+	// после удаления оригинала документ с тем же набором слов снова может быть добавлен
+	search_server.RemoveDocument(2);
+	ASSERT(!search_server.FindDuplicate("funny pet with curly hair"s));
+	search_server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+
+	// в режиме TRACK дубликаты индексируются, но находятся
+	search_server.SetDuplicateMode(DuplicateMode::TRACK);
+	search_server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+	ASSERT(search_server.FindDuplicate("nasty rat funny pet"s) == std::optional<int>(1));
+
+	search_server.SetDuplicateMode(DuplicateMode::OFF);
+	search_server.AddDocument(6, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 4);
+}
+
+void TestNearDuplicates(void)
+{
+	SearchServer search_server("and with"s);
+
+	AddDocument(search_server, 1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	AddDocument(search_server, 2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	AddDocument(search_server, 5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	// 4 общих слова из 6, похож на документ 1
+	AddDocument(search_server, 6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	// 2 общих слова из 6, не похож ни на один документ
+	AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+	{
+		const auto near_duplicates = FindNearDuplicates(search_server, 1.0);
+		ASSERT_EQUAL(near_duplicates.size(), 1u);
+		ASSERT_EQUAL(near_duplicates[0].document_id, 5);
+		ASSERT_EQUAL(near_duplicates[0].original_id, 1);
+	}
+
+	{
+		const auto near_duplicates = FindNearDuplicates(std::execution::par, search_server, 0.6);
+		ASSERT_EQUAL(near_duplicates.size(), 3u);
+		for (const NearDuplicate& near_duplicate : near_duplicates)
+		{
+			ASSERT(near_duplicate.similarity >= 0.6);
+			ASSERT(near_duplicate.original_id < near_duplicate.document_id);
+			ASSERT(near_duplicate.document_id != 2 && near_duplicate.document_id != 9);
+		}
+	}
+
+	try
+	{
+		FindNearDuplicates(search_server, 0.0);
+		ASSERT_HINT(false, "Должно было сработать исключение при нулевом пороге"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+
+	const std::vector<int> removed = RemoveNearDuplicates(std::execution::par, search_server, 0.6);
+	ASSERT(removed == std::vector<int>({ 5, 6 }));
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+}
+
+void TestPostingList(void)
+{
+	PostingList postings;
+	std::map<int, uint32_t> expected;
+
+	// сначала возрастающие id, как при обычной индексации, затем вставки в середину и удаления
+	for (int document_id = 0; document_id < 1000; document_id += 3)
+	{
+		postings.Add(document_id, document_id % 7 + 1);
+		expected[document_id] = document_id % 7 + 1;
+	}
+	for (int document_id = 1000; document_id > 0; document_id -= 5)
+	{
+		postings.Add(document_id, 100000);
+		expected[document_id] = 100000;
+	}
+	for (int document_id = 0; document_id < 1000; document_id += 4)
+	{
+		ASSERT_EQUAL(postings.Remove(document_id), expected.erase(document_id) > 0);
+	}
+	ASSERT(!postings.Remove(5000));
+
+	ASSERT_EQUAL(postings.size(), expected.size());
+	auto expected_iter = expected.begin();
+	for (const auto [document_id, term_count] : postings)
+	{
+		ASSERT_EQUAL(document_id, expected_iter->first);
+		ASSERT_EQUAL(term_count, expected_iter->second);
+		++expected_iter;
+	}
+	ASSERT(expected_iter == expected.end());
+
+	for (int document_id = 0; document_id <= 1001; ++document_id)
+	{
+		ASSERT_EQUAL(postings.Contains(document_id), expected.count(document_id) > 0);
+	}
+	ASSERT_EQUAL(postings.GetTermCount(3), 4u);
+	ASSERT_EQUAL(postings.GetTermCount(995), 100000u);
+	ASSERT(postings.GetMemoryUsage() < expected.size() * (sizeof(int) + sizeof(double)));
+
+	// Удаление всех записей освобождает блоки, после чего список снова пополняется
+	for (const auto& [document_id, term_count] : expected)
+	{
+		ASSERT(postings.Remove(document_id));
+	}
+	ASSERT(postings.empty() && postings.begin() == postings.end());
+	postings.Add(5, 2);
+	postings.Add(3, 1);
+	ASSERT_EQUAL(postings.GetTermCount(5), 2u);
+	ASSERT_EQUAL(postings.begin()->document_id, 3);
+}
+
+void TestBm25Ranking(void)
+{
+	SearchServer server;
+	server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(1, "black dog with long tail"s, DocumentStatus::ACTUAL, { 2 });
+	server.AddDocument(2, "white white dog"s, DocumentStatus::ACTUAL, { 3 });
+
+	const CorpusStatistics corpus = server.GetCorpusStatistics();
+	ASSERT_EQUAL(corpus.document_count, 3u);
+	ASSERT(std::abs(corpus.average_document_length - 10.0 / 3.0) < DEVIATION);
+
+	ASSERT(server.GetRankingFunction() == RankingFunction::TF_IDF);
+	server.SetRankingFunction(RankingFunction::BM25);
+
+	const double term_weight = std::log(1.0 + 1.5 / 2.5);
+	for (const auto& result : { server.FindTopDocuments("white"s), server.FindTopDocuments(std::execution::par, "white"s) })
+	{
+		ASSERT_EQUAL(result.size(), 2u);
+		ASSERT_EQUAL(result[0].id, 2);
+		ASSERT(std::abs(result[0].relevance - term_weight * 4.4 / 3.11) < DEVIATION);
+		ASSERT_EQUAL(result[1].id, 0);
+		ASSERT(std::abs(result[1].relevance - term_weight * 2.2 / 1.84) < DEVIATION);
+	}
+
+	// длина документа учитывается после удаления
+	server.RemoveDocument(1);
+	ASSERT(std::abs(server.GetCorpusStatistics().average_document_length - 2.5) < DEVIATION);
+
+	const std::map<std::string_view, uint32_t> expected_counts = { { "dog"sv, 1u }, { "white"sv, 2u } };
+	ASSERT(server.GetWordCounts(2) == expected_counts);
+}
+
+// Ранжирование только по числу вхождений слов запроса, для проверки пользовательской политики
+struct TermCountRanking
+{
+	double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const
+	{
+		return 1.0;
+	}
+
+	double ComputeScore(const CorpusStatistics& corpus, double term_weight, uint32_t term_count, int document_length, int rating) const
+	{
+		return term_count * term_weight;
+	}
+};
+
+void TestRankingPolicies(void)
+{
+	SearchServer server;
+	server.AddDocument(0, "white cat with long white tail"s, DocumentStatus::ACTUAL, { -5 });
+	server.AddDocument(1, "white dog"s, DocumentStatus::ACTUAL, { 9 });
+	server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, { 1 });
+	const auto actual = [](int document_id, DocumentStatus status, int rating)
+	{
+		return status == DocumentStatus::ACTUAL;
+	};
+
+	{
+		const auto result = server.FindTopDocuments(std::execution::seq, "white"s, actual, TermCountRanking{});
+		ASSERT_EQUAL(result.size(), 2u);
+		ASSERT_EQUAL(result[0].id, 0);
+		ASSERT_EQUAL(result[0].relevance, 2.0);
+		ASSERT_EQUAL(result[1].relevance, 1.0);
+	}
+
+	{// длинный документ 0 проигрывает по BM25+, буст рейтинга масштабирует релевантность документа
+		const auto result = server.FindTopDocuments(std::execution::par, "white"s, actual, Bm25PlusRanking{});
+		ASSERT_EQUAL(result[0].id, 1);
+		const auto boosted = server.FindTopDocuments(std::execution::par, "white"s, actual, Bm25PlusRanking{ 1.2, 0.75, 1.0, 0.1 });
+		ASSERT_EQUAL(boosted[0].id, 1);
+		ASSERT(std::abs(boosted[0].relevance - result[0].relevance * 1.9) < DEVIATION);
+		ASSERT(std::abs(boosted[1].relevance - result[1].relevance * 0.5) < DEVIATION);
+	}
+
+	server.SetRankingFunction(RankingFunction::BM25_PLUS);
+	const auto result = server.FindTopDocuments("white"s);
+	const auto expected = server.FindTopDocuments(std::execution::seq, "white"s, actual, Bm25PlusRanking{});
+	ASSERT_EQUAL(result.size(), expected.size());
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		ASSERT_EQUAL(result[i].id, expected[i].id);
+		ASSERT_EQUAL(result[i].relevance, expected[i].relevance);
+	}
+}
+
+void TestMatchDocumentUsesForwardIndex(void)
+{
+	SearchServer server("and"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "nasty dog"s, DocumentStatus::BANNED, { 1 });
+
+	std::vector<std::string_view> matched_words;
+	{
+		// найденные слова ссылаются на словарь сервера, а не на текст запроса
+		std::string query = "rat nasty unknown rat -cat"s;
+		matched_words = std::get<0>(server.MatchDocument(query, 1));
+		query.assign(query.size(), 'x');
+	}
+	const std::vector<std::string_view> expected = { "nasty"sv, "rat"sv };
+	ASSERT(matched_words == expected);
+
+	for (const auto& [words, status] : { server.MatchDocument("dog nasty"s, 2), server.MatchDocument(std::execution::par, "nasty dog nasty"s, 2) })
+	{
+		ASSERT((words == std::vector<std::string_view>{ "dog"sv, "nasty"sv }));
+		ASSERT(status == DocumentStatus::BANNED);
+	}
+	ASSERT(std::get<0>(server.MatchDocument("nasty -dog"s, 2)).empty());
+	ASSERT_EQUAL(std::get<0>(server.MatchDocument("nasty -dog"s, 1)).size(), 1u);
+
+	try
+	{
+		server.MatchDocument("nasty"s, 3);
+		ASSERT_HINT(false, "Должно было сработать исключение при несуществующем документе"s);
+	}
+	catch (const std::out_of_range&)
+	{
+	}
+
+	const auto& terms = server.GetDocumentTerms(1);
+	ASSERT_EQUAL(terms.size(), 4u);
+	ASSERT(std::is_sorted(terms.begin(), terms.end(), [](const SearchServer::TermCount& lhs, const SearchServer::TermCount& rhs)
+		{
+			return lhs.term_id < rhs.term_id;
+		}));
+	ASSERT_EQUAL(server.GetTermWord(terms[0].term_id), "funny"sv);
+}
+
+void TestMatchDocumentsBatch(void)
+{
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+	server.AddDocument(4, "big dog"s, DocumentStatus::ACTUAL, { 1, 2 });
+	server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+	const std::string query = "curly rat pet -hair"s;
+	const std::vector<int> document_ids = { 9, 1, 4, 2 };
+	for (const MatchedDocuments& matched : { server.MatchDocuments(query, document_ids), server.MatchDocuments(std::execution::par, query, document_ids) })
+	{
+		ASSERT_EQUAL(matched.size(), document_ids.size());
+		for (size_t index = 0; index < matched.size(); ++index)
+		{
+			const auto [words, status] = server.MatchDocument(query, document_ids[index]);
+			const auto batch_words = matched.GetWords(index);
+			ASSERT_EQUAL(matched.GetDocumentId(index), document_ids[index]);
+			ASSERT(matched.GetStatus(index) == status);
+			ASSERT(std::vector<std::string_view>(batch_words.begin(), batch_words.end()) == words);
+		}
+	}
+	ASSERT_EQUAL(server.MatchDocuments(query, document_ids).GetWords(1).size(), 2u);
+
+	try
+	{
+		server.MatchDocuments(std::execution::par, query, { 1, 3 });
+		ASSERT_HINT(false, "Должно было сработать исключение при несуществующем документе"s);
+	}
+	catch (const std::out_of_range&)
+	{
+	}
+	ASSERT(server.MatchDocuments(query, {}).empty());
+}
+
+void TestQueryArena(void)
+{
+	{
+		// Вложенные области используют один и тот же буфер и освобождают его только на выходе из внешней
+		const QueryArena::Scope outer;
+		std::pmr::vector<int> numbers({ 1, 2, 3 }, outer.GetResource());
+		{
+			const QueryArena::Scope inner;
+			ASSERT(inner.GetResource() == outer.GetResource());
+			std::pmr::vector<int> more_numbers(100, 7, inner.GetResource());
+		}
+		ASSERT_EQUAL(numbers[2], 3);
+	}
+
+	SearchServer server("and with"s);
+	std::string long_document;
+	for (int word = 0; word < 5000; ++word)
+	{
+		long_document += " word"s + std::to_string(word);
+	}
+	server.AddDocument(1, long_document, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+
+	// Запрос, которому не хватило буфера, увеличивает его для следующих запросов
+	const size_t buffer_size = QueryArena::ForCurrentThread().GetBufferSize();
+	const auto first = server.FindTopDocuments(long_document);
+	ASSERT(QueryArena::ForCurrentThread().GetBufferSize() > buffer_size);
+	const auto second = server.FindTopDocuments(long_document);
+	ASSERT_EQUAL(first.size(), second.size());
+	ASSERT_EQUAL(first[0].id, 1);
+	ASSERT(std::abs(first[0].relevance - second[0].relevance) < DEVIATION);
+
+	const auto parallel = server.FindTopDocuments(std::execution::par, "funny rat word7"s);
+	const auto sequential = server.FindTopDocuments("funny rat word7"s);
+	ASSERT_EQUAL(parallel.size(), sequential.size());
+	for (size_t index = 0; index < parallel.size(); ++index)
+	{
+		ASSERT_EQUAL(parallel[index].id, sequential[index].id);
+		ASSERT(std::abs(parallel[index].relevance - sequential[index].relevance) < DEVIATION);
+	}
+
+	const auto [words, status] = server.MatchDocument("nasty rat -pet"s, 2);
+	ASSERT(words.empty());
+	ASSERT(status == DocumentStatus::ACTUAL);
+}
+
+// Ресурс памяти, подсчитывающий выделенные и ещё не возвращённые байты
+class CountingMemoryResource : public std::pmr::memory_resource
+{
+public:
+	size_t outstanding = 0;
+	size_t allocation_count = 0;
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		outstanding += bytes;
+		++allocation_count;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		outstanding -= bytes;
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+void TestIndexMemoryResource(void)
+{
+	CountingMemoryResource resource;
+	SearchServer reference("and with"s);
+	{
+		SearchServer server("and with"s, &resource);
+		// Индекс не должен обращаться к ресурсу по умолчанию
+		std::pmr::memory_resource* default_resource = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+		for (SearchServer* target : { &server, &reference })
+		{
+			target->AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+			target->AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+			target->AddDocument(3, "big cat nasty hair"s, DocumentStatus::ACTUAL, { 1, 2, 8 });
+		}
+		std::pmr::set_default_resource(default_resource);
+		ASSERT(resource.outstanding > 0);
+
+		const auto found = server.FindTopDocuments("curly nasty cat"s);
+		const auto expected = reference.FindTopDocuments("curly nasty cat"s);
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t index = 0; index < found.size(); ++index)
+		{
+			ASSERT_EQUAL(found[index].id, expected[index].id);
+			ASSERT(std::abs(found[index].relevance - expected[index].relevance) < DEVIATION);
+		}
+
+		server.RemoveDocument(std::execution::par, 2);
+		ASSERT_EQUAL(server.FindTopDocuments("curly"s).size(), 0u);
+
+		// После очистки вся память индекса возвращается ресурсу, а сервер остаётся рабочим
+		server.Clear();
+		ASSERT_EQUAL(resource.outstanding, 0u);
+		ASSERT_EQUAL(server.GetDocumentCount(), 0);
+		ASSERT(server.begin() == server.end());
+		ASSERT_EQUAL(server.FindTopDocuments("funny"s).size(), 0u);
+
+		server.AddDocument(5, "funny dog and curly cat"s, DocumentStatus::ACTUAL, { 3 });
+		const SearchServer moved(std::move(server));
+		const auto after_clear = moved.FindTopDocuments("curly"s);
+		ASSERT_EQUAL(after_clear.size(), 1u);
+		ASSERT_EQUAL(after_clear[0].id, 5);
+		ASSERT_EQUAL(moved.GetTermWord(moved.GetDocumentTerms(5).front().term_id), "cat"s);
+	}
+	ASSERT_EQUAL(resource.outstanding, 0u);
+}
+
+void TestRequestQueue(void)
+{
+	SearchServer server("and in at"s);
+	server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::ACTUAL, { 1, 2, 8 });
+
+	{
+		RequestQueue request_queue(server);
+		for (int i = 0; i < 1439; ++i)
+		{
+			request_queue.AddFindRequest("empty request"s);
+		}
+		ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1439);
+		request_queue.AddFindRequest("curly dog"s);
+		request_queue.AddFindRequest("big collar"s);
+		request_queue.AddFindRequest("sparrow"s);
+		ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1438);
+		ASSERT(request_queue.GetStoredQueries().empty());
+	}
+
+	{
+		// Одновременные запросы из нескольких потоков учитываются без потерь
+		RequestQueue request_queue(server);
+		std::vector<std::thread> threads;
+		for (int thread = 0; thread < 4; ++thread)
+		{
+			threads.emplace_back([&request_queue]()
+				{
+					for (int i = 0; i < 1000; ++i)
+					{
+						request_queue.AddFindRequest("sparrow"s);
+					}
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1440);
+		for (int i = 0; i < 1440; ++i)
+		{
+			request_queue.AddFindRequest("curly"s);
+		}
+		ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+	}
+
+	{
+		RequestQueue request_queue(server, RequestQueue::QueryStorage::KEEP);
+		for (int i = 0; i < 1441; ++i)
+		{
+			request_queue.AddFindRequest("query"s + std::to_string(i));
+		}
+		const auto queries = request_queue.GetStoredQueries();
+		ASSERT_EQUAL(queries.size(), 1440u);
+		ASSERT_EQUAL(queries.front(), "query1"s);
+		ASSERT_EQUAL(queries.back(), "query1440"s);
+	}
+}
+
+void TestRequestStatistics(void)
+{
+	Histogram histogram;
+	for (uint64_t value = 1; value <= 1000; ++value)
+	{
+		histogram.Add(value);
+	}
+	ASSERT_EQUAL(histogram.GetCount(), 1000u);
+	ASSERT_EQUAL(histogram.GetValueAtPercentile(0.1), 1u);
+	// Погрешность значения не превышает 1/16
+	ASSERT(histogram.GetValueAtPercentile(50.0) >= 500u && histogram.GetValueAtPercentile(50.0) <= 500u * 17 / 16);
+	ASSERT(histogram.GetValueAtPercentile(99.0) >= 990u && histogram.GetValueAtPercentile(99.0) <= 990u * 17 / 16);
+	for (uint64_t value : { 0ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull })
+	{
+		const uint64_t upper_bound = Histogram::GetBucketUpperBound(Histogram::GetBucketIndex(value));
+		ASSERT(upper_bound >= value && upper_bound - value <= value / 16);
+	}
+	ASSERT_EQUAL(Histogram::GetBucketIndex(~0ull), Histogram::BUCKET_COUNT - 1);
+
+	using namespace std::chrono;
+	using Window = RequestStatistics::Window;
+	RequestStatistics statistics;
+	const RequestStatistics::Clock::time_point start(seconds(1000));
+	for (int request = 1; request <= 100; ++request)
+	{
+		statistics.Record(start, milliseconds(request), request % 5 == 0 ? 0 : 5);
+	}
+	const auto latency = statistics.GetLatencySummary(Window::MINUTE, start);
+	ASSERT_EQUAL(latency.count, 100u);
+	ASSERT(latency.p50 >= 50000u && latency.p50 <= 50000u * 17 / 16);
+	ASSERT(latency.p99 >= 99000u && latency.p99 <= 99000u * 17 / 16);
+	const auto result_count = statistics.GetResultCountSummary(Window::MINUTE, start);
+	ASSERT_EQUAL(result_count.p50, 5u);
+	ASSERT_EQUAL(statistics.GetResultCountHistogram(Window::MINUTE, start).GetBucketCount(0), 20u);
+
+	// Секундные корзины старше минуты не учитываются, а минутные хранятся час
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::MINUTE, start + seconds(60)).count, 0u);
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::HOUR, start + seconds(61)).count, 100u);
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::HOUR, start + minutes(61)).count, 0u);
+
+	// Корзина того же слота кольца очищается новым периодом
+	statistics.Record(start + seconds(60), milliseconds(7), 1);
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::MINUTE, start + seconds(60)).count, 1u);
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::HOUR, start + seconds(60)).count, 101u);
+	// Запоздавший запрос старого периода не портит новую корзину
+	statistics.Record(start, milliseconds(1), 1);
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::MINUTE, start + seconds(60)).count, 1u);
+
+	// Потоки, одновременно начинающие новый период, не теряют запросов
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < 4; ++thread)
+	{
+		threads.emplace_back([&statistics, start]()
+			{
+				for (int request = 0; request < 1000; ++request)
+				{
+					statistics.Record(start + seconds(120 + request / 500), microseconds(request), 1);
+				}
+			});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_EQUAL(statistics.GetLatencySummary(Window::MINUTE, start + seconds(121)).count, 4000u);
+	// Неиспользованная статистика пуста
+	ASSERT_EQUAL(RequestStatistics().GetLatencySummary(Window::HOUR, start).count, 0u);
+
+	SearchServer server("and in at"s);
+	server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	RequestQueue request_queue(server);
+	request_queue.AddFindRequest("curly"s);
+	request_queue.AddFindRequest("sparrow"s);
+	const auto summary = request_queue.GetStatistics().GetResultCountSummary(Window::MINUTE);
+	ASSERT_EQUAL(summary.count, 2u);
+	ASSERT_EQUAL(summary.p99, 1u);
+}
+
+void TestInstrumentation(void)
+{
+	const size_t timer_id = Instrumentation::RegisterTimer("test timer"s);
+	const size_t counter_id = Instrumentation::RegisterCounter("test counter"s);
+	ASSERT_EQUAL(Instrumentation::RegisterTimer("test timer"s), timer_id);
+
+	const auto before = Instrumentation::TakeSnapshot();
+	const uint64_t timer_count = before.timers.count("test timer"s) ? before.timers.at("test timer"s).GetCount() : 0;
+	const uint64_t counter_value = before.counters.at("test counter"s);
+
+	// Данные потоков, в том числе уже завершившихся, объединяются в одном снимке
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < 4; ++thread)
+	{
+		threads.emplace_back([timer_id, counter_id]()
+			{
+				for (uint64_t i = 1; i <= 100; ++i)
+				{
+					Instrumentation::RecordTime(timer_id, i * 1000);
+					Instrumentation::AddToCounter(counter_id, 2);
+				}
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	{
+		const ScopedTimer timer(timer_id);
+	}
+
+	const auto after = Instrumentation::TakeSnapshot();
+	const Histogram& histogram = after.timers.at("test timer"s);
+	ASSERT_EQUAL(histogram.GetCount(), timer_count + 401);
+	ASSERT_EQUAL(after.counters.at("test counter"s), counter_value + 800);
+	ASSERT(histogram.GetValueAtPercentile(50.0) >= 50000u);
+
+	std::ostringstream output;
+	Instrumentation::Dump(output, after);
+	ASSERT(output.str().find("test counter: "s + std::to_string(counter_value + 800)) != std::string::npos);
+	ASSERT(output.str().find("test timer: count="s) != std::string::npos);
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	const auto before_search = Instrumentation::TakeSnapshot();
+	server.FindTopDocuments("funny rat -curly"s);
+	const auto after_search = Instrumentation::TakeSnapshot();
+	ASSERT_EQUAL(after_search.counters.at("postings scanned"s) - before_search.counters.at("postings scanned"s), 4u);
+	ASSERT_EQUAL(after_search.counters.at("documents scored"s) - before_search.counters.at("documents scored"s), 3u);
+	ASSERT_EQUAL(after_search.counters.at("documents excluded by minus words"s) - before_search.counters.at("documents excluded by minus words"s), 1u);
+#endif
+}
+
+void TestExplainQuery(void)
+{
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	server.AddDocument(3, "funny cat with long tail"s, DocumentStatus::BANNED, { 1, 2, 8 });
+	server.AddDocument(4, "nasty dog with big ears"s, DocumentStatus::ACTUAL, { 4 });
+
+	const std::string query = "funny nasty rat and -curly -sparrow"s;
+	for (const bool parallel : { false, true })
+	{
+		QueryTrace trace;
+		const auto found = parallel
+			? server.FindTopDocuments(std::execution::par, query, [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; }, trace)
+			: server.FindTopDocuments(query, trace);
+		// Трассировка не меняет результат поиска
+		const auto expected = server.FindTopDocuments(query);
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t index = 0; index < found.size(); ++index)
+		{
+			ASSERT_EQUAL(found[index].id, expected[index].id);
+		}
+
+		ASSERT_EQUAL(trace.stop_words.size(), 1u);
+		ASSERT_EQUAL(trace.stop_words[0], "and"s);
+		ASSERT_EQUAL(trace.plus_terms.size(), 3u);
+		ASSERT_EQUAL(trace.minus_terms.size(), 2u);
+		for (const QueryTrace::Term& term : trace.plus_terms)
+		{
+			if (term.word == "funny"s)
+			{
+				ASSERT_EQUAL(term.posting_count, 3u);
+				ASSERT(std::abs(term.weight - std::log(4.0 / 3.0)) < DEVIATION);
+				ASSERT_EQUAL(term.documents_scored, 2u);
+				ASSERT_EQUAL(term.documents_filtered, 1u);
+			}
+		}
+		for (const QueryTrace::Term& term : trace.minus_terms)
+		{
+			ASSERT_EQUAL(term.posting_count, term.word == "curly"s ? 1u : 0u);
+		}
+		// funny: 2 документа, nasty: 2, rat: 1
+		ASSERT_EQUAL(trace.documents_scored, 5u);
+		ASSERT_EQUAL(trace.documents_filtered, 1u);
+		ASSERT_EQUAL(trace.documents_excluded, 1u);
+		ASSERT_EQUAL(trace.candidate_count, 2u);
+		ASSERT_EQUAL(trace.result_count, 2u);
+		ASSERT(trace.parse_time.count() > 0);
+	}
+}
+
+void TestAdaptiveExecution(void)
+{
+	SearchServer server("and"s);
+	for (int id = 0; id < 200; ++id)
+	{
+		server.AddDocument(id, "cat"s + (id % 2 == 0 ? " dog"s : ""s) + (id % 10 == 0 ? " rat"s : ""s) + " and d"s + std::to_string(id), DocumentStatus::ACTUAL, { id % 7 });
+	}
+
+	ExecutionThresholds thresholds;
+	thresholds.parallel_postings = 250;
+	thresholds.postings_per_worker = 100;
+	thresholds.parallel_match_pairs = 100;
+	server.SetExecutionThresholds(thresholds);
+	ASSERT_EQUAL(server.GetExecutionThresholds().parallel_postings, 250u);
+
+	// Одно слово не делится между потоками, сколько бы документов его ни содержало
+	const ExecutionPlan single_word = server.PlanExecution("cat"s);
+	ASSERT(!single_word.parallel);
+	ASSERT_EQUAL(single_word.posting_count, 200u);
+	// Узкий запрос остаётся последовательным
+	ASSERT(!server.PlanExecution("rat d1 -nothing"s).parallel);
+	// Широкий запрос из нескольких слов распараллеливается, если есть больше одного потока
+	const ExecutionPlan broad = server.PlanExecution("cat dog -rat"s);
+	ASSERT_EQUAL(broad.posting_count, 320u);
+	if (std::thread::hardware_concurrency() > 1)
+	{
+		ASSERT(broad.parallel);
+		ASSERT(broad.worker_count >= 2 && broad.worker_count <= 3);
+	}
+	else
+	{
+		ASSERT(!broad.parallel);
+	}
+
+	// Результат не зависит от выбранного способа выполнения
+	for (const std::string& query : { "cat"s, "rat d1 -nothing"s, "cat dog -rat"s })
+	{
+		const auto expected = server.FindTopDocuments(std::execution::seq, query);
+		const auto found = server.FindTopDocuments(adaptive_policy, query);
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t index = 0; index < found.size(); ++index)
+		{
+			ASSERT_EQUAL(found[index].id, expected[index].id);
+			ASSERT_EQUAL(found[index].rating, expected[index].rating);
+		}
+
+		const std::vector<int> document_ids(server.begin(), server.end());
+		const MatchedDocuments matched = server.MatchDocuments(adaptive_policy, query, document_ids);
+		const MatchedDocuments expected_matched = server.MatchDocuments(query, document_ids);
+		for (size_t index = 0; index < document_ids.size(); ++index)
+		{
+			const auto words = matched.GetWords(index);
+			const auto expected_words = expected_matched.GetWords(index);
+			ASSERT(std::equal(words.begin(), words.end(), expected_words.begin(), expected_words.end()));
+		}
+		ASSERT(std::get<0>(server.MatchDocument(adaptive_policy, query, 0)) == std::get<0>(server.MatchDocument(query, 0)));
+	}
+
+	// Откалиброванные пороги согласованы между собой и измеряются один раз
+	SearchServer::Calibrate();
+	const ExecutionThresholds& calibrated = SearchServer::GetCalibratedExecutionThresholds();
+	ASSERT(calibrated.postings_per_worker <= calibrated.parallel_postings);
+	ASSERT(&calibrated == &SearchServer::GetCalibratedExecutionThresholds());
+	if (std::thread::hardware_concurrency() <= 1)
+	{
+		ASSERT_EQUAL(calibrated.parallel_postings, std::numeric_limits<size_t>::max());
+	}
+}
+
+void TestShardedSearchServer(void)
+{
+	const std::vector<std::string> texts = {
+		"funny pet and nasty rat"s,
+		"funny pet with curly hair"s,
+		"funny cat with long tail"s,
+		"nasty dog with big ears"s,
+		"big cat and small dog"s,
+		"curly dog and funny rat"s,
+		"long tail of a big rat"s,
+	};
+	SearchServer server("and with"s);
+	ShardedSearchServer sharded("and with"s, 3);
+	ASSERT_EQUAL(sharded.GetShardCount(), 3u);
+	for (size_t index = 0; index < texts.size(); ++index)
+	{
+		const int id = static_cast<int>(index) * 10;
+		const DocumentStatus status = index == 2 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		server.AddDocument(id, texts[index], status, { static_cast<int>(index) });
+		sharded.AddDocument(id, texts[index], status, { static_cast<int>(index) });
+	}
+
+	// Глобальные частоты слов дают ту же релевантность, что и один сервер со всеми документами
+	const auto check_same_results = [&](const std::string& query)
+	{
+		const auto expected = server.FindTopDocuments(query);
+		for (const bool parallel : { false, true })
+		{
+			const auto found = parallel ? sharded.FindTopDocuments(std::execution::par, query) : sharded.FindTopDocuments(std::execution::seq, query);
+			ASSERT_EQUAL(found.size(), expected.size());
+			for (size_t index = 0; index < found.size(); ++index)
+			{
+				ASSERT_EQUAL(found[index].id, expected[index].id);
+				ASSERT(std::abs(found[index].relevance - expected[index].relevance) < DEVIATION);
+			}
+		}
+	};
+	for (const RankingFunction ranking_function : { RankingFunction::TF_IDF, RankingFunction::BM25 })
+	{
+		server.SetRankingFunction(ranking_function);
+		sharded.SetRankingFunction(ranking_function);
+		check_same_results("funny nasty rat -curly"s);
+		check_same_results("big cat dog tail"s);
+	}
+	ASSERT_EQUAL(sharded.FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 1u);
+
+	ASSERT_EQUAL(sharded.GetDocumentCount(), texts.size());
+	ASSERT(std::equal(sharded.begin(), sharded.end(), server.begin(), server.end()));
+	ASSERT(sharded.MatchDocument("funny rat -hair"s, 50) == server.MatchDocument("funny rat -hair"s, 50));
+	ASSERT(sharded.GetWordFrequencies(30) == server.GetWordFrequencies(30));
+
+	// Документ с тем же id попадает в тот же сегмент и отклоняется им
+	try
+	{
+		sharded.AddDocument(10, "another text"s, DocumentStatus::ACTUAL, { 1 });
+		ASSERT_HINT(false, "Документ с существующим id должен быть отклонён"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+
+	// Отклонённый документ пакета не мешает добавлению остальных
+	try
+	{
+		sharded.AddDocuments({ { 100, "curly cat"s, DocumentStatus::ACTUAL, { 5 } }, { -1, "bad id"s, DocumentStatus::ACTUAL, { 1 } }, { 101, "funny hair"s, DocumentStatus::ACTUAL, { 3 } } });
+		ASSERT_HINT(false, "Ошибка документа пакета должна быть передана вызывающему"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+	server.AddDocument(100, "curly cat"s, DocumentStatus::ACTUAL, { 5 });
+	server.AddDocument(101, "funny hair"s, DocumentStatus::ACTUAL, { 3 });
+	ASSERT_EQUAL(sharded.GetDocumentCount(), texts.size() + 2);
+	check_same_results("curly funny cat"s);
+
+	sharded.RemoveDocuments({ 0, 40, 100 });
+	sharded.RemoveDocument(std::execution::par, 101);
+	for (const int id : { 0, 40, 100, 101 })
+	{
+		server.RemoveDocument(id);
+	}
+	ASSERT(std::equal(sharded.begin(), sharded.end(), server.begin(), server.end()));
+	check_same_results("curly funny cat rat"s);
+
+	// Документы добавляются из нескольких потоков одновременно с поиском
+	ShardedSearchServer concurrent(4);
+	std::vector<std::thread> writers;
+	for (int thread = 0; thread < 4; ++thread)
+	{
+		writers.emplace_back([&concurrent, thread]()
+			{
+				for (int index = 0; index < 50; ++index)
+				{
+					concurrent.AddDocument(thread * 1000 + index, "word"s + std::to_string(index % 5) + " common"s, DocumentStatus::ACTUAL, { index });
+				}
+			});
+	}
+	for (int query = 0; query < 20; ++query)
+	{
+		ASSERT(concurrent.FindTopDocuments("common word1"s).size() <= MAX_RESULT_DOCUMENT_COUNT);
+	}
+	for (auto& writer : writers)
+	{
+		writer.join();
+	}
+	ASSERT_EQUAL(concurrent.GetDocumentCount(), 200u);
+	ASSERT_EQUAL(concurrent.FindTopDocuments("word1"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+}
+
+void TestShardCoordinator(void)
+{
+	// Кодирование сообщений обратимо
+	QueryStatistics statistics;
+	statistics.document_count = 300;
+	statistics.word_count = uint64_t{ 1 } << 40;
+	statistics.document_freqs = { { "cat"s, 7 }, { "dog"s, 0 } };
+	const std::vector<Document> documents = { { -5, 0.25, -3 }, { 1 << 30, 1e-9, 7 } };
+	const std::string message = MessageWriter(ShardMessageType::SEARCH_REQUEST).PutString("cat -dog"s).PutStatistics(statistics).PutDocuments(documents).GetData();
+	MessageReader reader(message);
+	ASSERT(reader.GetType() == ShardMessageType::SEARCH_REQUEST);
+	ASSERT_EQUAL(reader.GetString(), "cat -dog"s);
+	const QueryStatistics decoded = reader.GetStatistics();
+	ASSERT_EQUAL(decoded.word_count, statistics.word_count);
+	ASSERT(decoded.document_freqs == statistics.document_freqs);
+	const std::vector<Document> decoded_documents = reader.GetDocuments();
+	ASSERT_EQUAL(decoded_documents[0].id, -5);
+	ASSERT_EQUAL(decoded_documents[1].relevance, 1e-9);
+	reader.ExpectEnd();
+	try
+	{
+		MessageReader truncated(std::string_view(message).substr(0, 5));
+		truncated.GetString();
+		ASSERT_HINT(false, "Обрезанное сообщение должно быть отклонено"s);
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+	// Число оценок не может превышать число оставшихся байтов
+	const std::string huge_message = MessageWriter(ShardMessageType::ADD_DOCUMENT_REQUEST).PutUnsigned(uint64_t{ 1 } << 40).PutSigned(5).GetData();
+	try
+	{
+		MessageReader huge(huge_message);
+		huge.GetRatings();
+		ASSERT_HINT(false, "Слишком большое число оценок должно быть отклонено"s);
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+
+	const std::string socket_prefix = "/tmp/search_server_test_"s + std::to_string(::getpid()) + "_"s;
+	const std::vector<std::string> socket_paths = { socket_prefix + "0.sock"s, socket_prefix + "1.sock"s };
+	std::vector<SearchServer> shard_servers;
+	shard_servers.emplace_back("and with"s);
+	shard_servers.emplace_back("and with"s);
+	auto first_service = std::make_unique<ShardService>(shard_servers[0]);
+	ShardService second_service(shard_servers[1]);
+	std::thread first_thread([&]() { first_service->Serve(socket_paths[0]); });
+	std::thread second_thread([&]() { second_service.Serve(socket_paths[1]); });
+	// Сервис начинает слушать сокет не сразу после запуска потока
+	const auto wait_for_socket = [](const std::string& path)
+	{
+		for (int attempt = 0; attempt < 1000; ++attempt)
+		{
+			try
+			{
+				UnixSocket::Connect(path);
+				return;
+			}
+			catch (const std::system_error&)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	};
+	wait_for_socket(socket_paths[0]);
+	wait_for_socket(socket_paths[1]);
+
+	ShardCoordinator coordinator(socket_paths);
+	SearchServer server("and with"s);
+	const std::vector<std::string> texts = { "funny pet and nasty rat"s, "funny pet with curly hair"s, "funny cat with long tail"s,
+		"nasty dog with big ears"s, "big cat and small dog"s, "curly dog and funny rat"s };
+	for (size_t index = 0; index < texts.size(); ++index)
+	{
+		coordinator.AddDocument(static_cast<int>(index), texts[index], DocumentStatus::ACTUAL, { static_cast<int>(index) });
+		server.AddDocument(static_cast<int>(index), texts[index], DocumentStatus::ACTUAL, { static_cast<int>(index) });
+	}
+	ASSERT_EQUAL(coordinator.GetDocumentCount(), texts.size());
+	ASSERT(shard_servers[0].GetDocumentCount() > 0 && shard_servers[1].GetDocumentCount() > 0);
+
+	const auto check_same_results = [&](const std::string& query)
+	{
+		const auto expected = server.FindTopDocuments(query);
+		const auto found = coordinator.FindTopDocuments(query);
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t index = 0; index < found.size(); ++index)
+		{
+			ASSERT_EQUAL(found[index].id, expected[index].id);
+			ASSERT(std::abs(found[index].relevance - expected[index].relevance) < DEVIATION);
+		}
+	};
+	check_same_results("funny nasty rat -curly"s);
+	check_same_results("big cat dog"s);
+
+	// Ошибка сегмента передаётся вызывающему, соединение остаётся рабочим
+	try
+	{
+		coordinator.FindTopDocuments("funny --rat"s);
+		ASSERT_HINT(false, "Ошибка запроса должна быть передана координатору"s);
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+	coordinator.RemoveDocument(0);
+	server.RemoveDocument(0);
+	check_same_results("funny nasty rat"s);
+
+	// Перезапущенный сегмент снова принимает запросы координатора
+	first_service->Stop();
+	first_thread.join();
+	first_service = std::make_unique<ShardService>(shard_servers[0]);
+	::unlink(socket_paths[0].c_str());
+	first_thread = std::thread([&]() { first_service->Serve(socket_paths[0]); });
+	wait_for_socket(socket_paths[0]);
+	check_same_results("funny pet dog"s);
+
+	first_service->Stop();
+	second_service.Stop();
+	first_thread.join();
+	second_thread.join();
+	for (const std::string& path : socket_paths)
+	{
+		::unlink(path.c_str());
+	}
+}
+
+void TestQueryServer(void)
+{
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+	QueryServer query_server(server, { 2, 4, 1000 });
+
+	ASSERT_EQUAL(query_server.HandleRequest("COUNT"s), "OK\t2"s);
+	ASSERT_EQUAL(query_server.HandleRequest("FIND\tnasty rat"s), "OK\t1 0.346574 5"s);
+	ASSERT_EQUAL(query_server.HandleRequest("FIND\tfunny\tBANNED"s), "OK\t2 0 1"s);
+	ASSERT_EQUAL(query_server.HandleRequest("MATCH\t1\tfunny rat curly"s), "OK\tACTUAL\tfunny rat"s);
+	ASSERT_EQUAL(query_server.HandleRequest("ADD\t3\tACTUAL\t1 -4\tnasty cat"s), "OK"s);
+	ASSERT_EQUAL(query_server.HandleRequest("REMOVE\t2"s), "OK"s);
+	ASSERT_EQUAL(query_server.HandleRequest("COUNT"s), "OK\t2"s);
+	// Ошибки возвращаются одной строкой
+	ASSERT_EQUAL(query_server.HandleRequest("FIND\tcat --dog"s).substr(0, 6), "ERROR\t"s);
+	ASSERT_EQUAL(query_server.HandleRequest("ADD\t3\tACTUAL\t1\tcat"s).find('\n'), std::string::npos);
+	ASSERT_EQUAL(query_server.HandleRequest("SEARCH\tcat"s).substr(0, 6), "ERROR\t"s);
+
+	// Ответы на несколько отправленных подряд запросов приходят в порядке запросов
+	const auto read_lines = [](int descriptor, size_t count)
+	{
+		std::string data;
+		char buffer[4096];
+		while (static_cast<size_t>(std::count(data.begin(), data.end(), '\n')) < count)
+		{
+			const ssize_t received = ::read(descriptor, buffer, sizeof(buffer));
+			if (received <= 0)
+			{
+				break;
+			}
+			data.append(buffer, static_cast<size_t>(received));
+		}
+		return data;
+	};
+	const std::string requests = "COUNT\nFIND\tnasty\nADD\t4\tACTUAL\t2\tcurly dog\nMATCH\t4\tdog\nBAD\nCOUNT"s;
+	const std::string expected = "OK\t2\nOK\t1 0 5\t3 0 -1\nOK\nOK\tACTUAL\tdog\nERROR\tНеизвестная команда: BAD\nOK\t3\n"s;
+
+	const std::string socket_path = "/tmp/search_query_server_test_"s + std::to_string(::getpid()) + ".sock"s;
+	std::thread serving([&]() { query_server.ServeSocket(socket_path); });
+	UnixSocket client;
+	for (int attempt = 0; attempt < 1000 && !client; ++attempt)
+	{
+		try
+		{
+			client = UnixSocket::Connect(socket_path);
+		}
+		catch (const std::system_error&)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	ASSERT(static_cast<bool>(client));
+	const std::string socket_requests = requests + "\n"s;
+	ASSERT_EQUAL(::write(client.GetDescriptor(), socket_requests.data(), socket_requests.size()), static_cast<ssize_t>(socket_requests.size()));
+	ASSERT_EQUAL(read_lines(client.GetDescriptor(), 6), expected);
+	query_server.Stop();
+	serving.join();
+	::unlink(socket_path.c_str());
+
+	// Запросы из потока ввода, последний может быть без перевода строки
+	server.RemoveDocument(4);
+	QueryServer stream_server(server, { 2, 2, 1000 });
+	int input[2];
+	int output[2];
+	ASSERT(::pipe(input) == 0 && ::pipe(output) == 0);
+	std::thread streaming([&]() { stream_server.ServeStreams(input[0], output[1]); });
+	ASSERT_EQUAL(::write(input[1], requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+	::close(input[1]);
+	ASSERT_EQUAL(read_lines(output[0], 6), expected);
+	streaming.join();
+	for (const int descriptor : { input[0], output[0], output[1] })
+	{
+		::close(descriptor);
+	}
+}
+
+void TestLoadDocuments(void)
+{
+	// Файл больше одного фрагмента разбора, чтобы строки разбирались параллельно
+	std::string text;
+	for (int id = 0; id < 40000; ++id)
+	{
+		text += std::to_string(id) + "\t"s + (id % 3 == 0 ? "BANNED"s : "ACTUAL"s) + "\t"s + std::to_string(id) + " -"s + std::to_string(id % 7) + "\tword"s + std::to_string(id % 100) + " common text"s + (id % 2 == 0 ? "\r\n"s : "\n"s);
+	}
+	const std::vector<DocumentRecord> records = ParseDocumentRecords(text);
+	ASSERT_EQUAL(records.size(), 40000u);
+	for (int id = 0; id < 40000; ++id)
+	{
+		ASSERT_EQUAL(records[id].id, id);
+		ASSERT(records[id].ratings == std::vector<int>({ id, -(id % 7) }));
+	}
+	ASSERT_EQUAL(records[12345].text, "word45 common text"s);
+	ASSERT(records[12345].text.data() >= text.data() && records[12345].text.data() < text.data() + text.size());
+
+	const std::string path = "/tmp/search_documents_test_"s + std::to_string(::getpid()) + ".tsv"s;
+	std::ofstream(path) << text;
+	SearchServer loaded("text"s);
+	ASSERT_EQUAL(LoadDocuments(loaded, path), 40000u);
+	SearchServer read("text"s);
+	std::istringstream input(text);
+	ReadDocuments(read, input);
+	ShardedSearchServer sharded("text"s, 3);
+	ASSERT_EQUAL(LoadDocuments(sharded, path), 40000u);
+	ASSERT_EQUAL(loaded.GetDocumentCount(), 40000u);
+	ASSERT_EQUAL(sharded.GetDocumentCount(), 40000u);
+	for (const std::string& query : { "word42 common"s, "word7 -word8"s })
+	{
+		const std::vector<Document> expected = read.FindTopDocuments(query);
+		for (const std::vector<Document>& found : { loaded.FindTopDocuments(query), sharded.FindTopDocuments(query) })
+		{
+			ASSERT_EQUAL(found.size(), expected.size());
+			for (size_t index = 0; index < found.size(); ++index)
+			{
+				ASSERT_EQUAL(found[index].id, expected[index].id);
+				ASSERT(std::abs(found[index].relevance - expected[index].relevance) < DEVIATION);
+			}
+		}
+	}
+
+	// Ошибки называют номер строки файла
+	const auto load_error = [&path](const std::string& content)
+	{
+		std::ofstream(path) << content;
+		SearchServer server;
+		try
+		{
+			LoadDocuments(server, path);
+		}
+		catch (const std::invalid_argument& e)
+		{
+			return std::string(e.what());
+		}
+		return ""s;
+	};
+	ASSERT_EQUAL(load_error(text + "40000\tACTUAL\t1\tfine\n40001\tOLD\t1\tbad status\n"s).rfind("Строка 40002: "s, 0), 0u);
+	ASSERT_EQUAL(load_error("1\tACTUAL\t1\tcat\n1\tACTUAL\t2\tdog\n"s).rfind("Строка 2: "s, 0), 0u);
+	ASSERT_EQUAL(load_error(""s), ""s);
+	::unlink(path.c_str());
+	try
+	{
+		SearchServer server;
+		LoadDocuments(server, path);
+		ASSERT_HINT(false, "Отсутствующий файл должен приводить к исключению"s);
+	}
+	catch (const std::system_error&)
+	{
+	}
+}
+
+void TestDurableSearchServer(void)
+{
+	char directory_template[] = "/tmp/search_durable_test_XXXXXX";
+	ASSERT(::mkdtemp(directory_template) != nullptr);
+	const std::string directory = directory_template;
+	const auto list_files = [&directory](const std::string& prefix)
+	{
+		std::vector<std::string> paths;
+		for (const auto& entry : std::filesystem::directory_iterator(directory))
+		{
+			if (entry.path().filename().string().rfind(prefix, 0) == 0)
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	};
+	const auto check_same = [](const SearchServer& recovered, const SearchServer& expected)
+	{
+		ASSERT_EQUAL(recovered.GetDocumentCount(), expected.GetDocumentCount());
+		for (const int document_id : expected)
+		{
+			ASSERT(recovered.GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id));
+			ASSERT(std::get<DocumentStatus>(recovered.MatchDocument("cat"s, document_id)) == std::get<DocumentStatus>(expected.MatchDocument("cat"s, document_id)));
+		}
+		const std::vector<Document> found = recovered.FindTopDocuments("fluffy cat"s);
+		const std::vector<Document> expected_found = expected.FindTopDocuments("fluffy cat"s);
+		ASSERT_EQUAL(found.size(), expected_found.size());
+		for (size_t index = 0; index < found.size(); ++index)
+		{
+			ASSERT_EQUAL(found[index].id, expected_found[index].id);
+			ASSERT_EQUAL(found[index].rating, expected_found[index].rating);
+		}
+	};
+
+	SearchServer expected("and"s);
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory);
+		uint64_t position = 0;
+		for (int id = 0; id < 20; ++id)
+		{
+			const std::string text = "fluffy cat number"s + std::to_string(id) + (id % 2 == 0 ? " and dog"s : ""s);
+			position = durable.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id, -1 });
+			expected.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id, -1 });
+		}
+		durable.RemoveDocument(4);
+		expected.RemoveDocument(4);
+		durable.Sync(durable.RemoveDocument(100));
+		// Отклонённое сервером изменение не попадает в журнал
+		try
+		{
+			durable.AddDocument(5, "cat"s, DocumentStatus::ACTUAL, {});
+			ASSERT_HINT(false, "Повторный id должен приводить к исключению"s);
+		}
+		catch (const std::invalid_argument&)
+		{
+		}
+		durable.Sync(position);
+	}
+	// Восстановление из одного журнала, без снимка
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory);
+		check_same(server, expected);
+
+		// Первая контрольная точка становится снимком, записанный журнал удаляется
+		durable.Checkpoint();
+		durable.WaitForCheckpoints();
+		ASSERT_EQUAL(list_files("snapshot"s).size(), 1u);
+		ASSERT(list_files("checkpoint."s).empty());
+		ASSERT_EQUAL(list_files("log."s).size(), 1u);
+		ASSERT_EQUAL(std::filesystem::file_size(list_files("log."s).front()), 0u);
+		durable.Sync(durable.AddDocument(4, "cat is back"s, DocumentStatus::ACTUAL, { 9 }));
+		expected.AddDocument(4, "cat is back"s, DocumentStatus::ACTUAL, { 9 });
+		durable.Sync(durable.RemoveDocument(7));
+		expected.RemoveDocument(7);
+	}
+	const std::string log_path = list_files("log."s).front();
+	const size_t log_size = std::filesystem::file_size(log_path);
+	ASSERT(log_size > 0);
+	// Запись, оборванная сбоем, отбрасывается вместе со всем, что за ней
+	std::ofstream(log_path, std::ios::binary | std::ios::app) << "\x30\x00\x00\x00\x01\x02\x03\x04partial"s;
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory);
+		check_same(server, expected);
+		ASSERT_EQUAL(std::filesystem::file_size(log_path), log_size);
+	}
+	// Обнулённый хвост после сбоя не принимается за пустые записи
+	std::ofstream(log_path, std::ios::binary | std::ios::app) << std::string(4096, '\0');
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory);
+		check_same(server, expected);
+		ASSERT_EQUAL(std::filesystem::file_size(log_path), log_size);
+	}
+
+	// Несколько потоков обновляют сервер, ожидание записи на диск идёт без блокировки. Журнал часто
+	// закрывается, контрольные точки копятся и не сливаются со снимком
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory, { 512, 100.0 });
+		std::mutex server_mutex;
+		std::vector<std::thread> writers;
+		for (int thread_index = 0; thread_index < 4; ++thread_index)
+		{
+			writers.emplace_back([&, thread_index]()
+				{
+					for (int id = 100 + thread_index * 25; id < 125 + thread_index * 25; ++id)
+					{
+						uint64_t update_position = 0;
+						{
+							std::lock_guard guard(server_mutex);
+							update_position = durable.AddDocument(id, "fluffy cat from thread"s, DocumentStatus::ACTUAL, { id });
+							if (id % 5 == 0)
+							{
+								durable.RemoveDocument(id - 100);
+							}
+						}
+						durable.Sync(update_position);
+					}
+				});
+		}
+		for (std::thread& writer : writers)
+		{
+			writer.join();
+		}
+		for (int id = 100; id < 200; ++id)
+		{
+			expected.AddDocument(id, "fluffy cat from thread"s, DocumentStatus::ACTUAL, { id });
+			if (id % 5 == 0)
+			{
+				expected.RemoveDocument(id - 100);
+			}
+		}
+		durable.WaitForCheckpoints();
+		ASSERT(list_files("checkpoint."s).size() > 1);
+	}
+	const std::vector<std::string> checkpoint_paths = list_files("checkpoint."s);
+	std::ostringstream stale_checkpoint;
+	stale_checkpoint << std::ifstream(checkpoint_paths.front(), std::ios::binary).rdbuf();
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory, { 0, 0.0 });
+		check_same(server, expected);
+
+		// Слияние контрольных точек в новый снимок
+		durable.Sync(durable.AddDocument(300, "fluffy late cat"s, DocumentStatus::ACTUAL, { 1 }));
+		expected.AddDocument(300, "fluffy late cat"s, DocumentStatus::ACTUAL, { 1 });
+		durable.Checkpoint();
+		durable.WaitForCheckpoints();
+		ASSERT(list_files("checkpoint."s).empty());
+	}
+	// Сбой после записи снимка, но до удаления слитой контрольной точки: она пропускается и удаляется
+	std::ofstream(checkpoint_paths.front(), std::ios::binary) << stale_checkpoint.str();
+	{
+		SearchServer server("and"s);
+		DurableSearchServer durable(server, directory);
+		check_same(server, expected);
+		ASSERT(list_files("checkpoint."s).empty());
+	}
+
+	// Контрольная точка воспроизводится без ложных дубликатов: документ заменён другим с тем же текстом
+	const std::string reject_directory = directory + "/reject"s;
+	std::filesystem::create_directory(reject_directory);
+	{
+		SearchServer server;
+		server.SetDuplicateMode(DuplicateMode::REJECT);
+		DurableSearchServer durable(server, reject_directory, { 0, 100.0 });
+		durable.Sync(durable.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, { 1 }));
+		durable.Checkpoint();
+		durable.WaitForCheckpoints();
+		durable.RemoveDocument(2);
+		durable.Sync(durable.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, { 2 }));
+		durable.Checkpoint();
+		durable.WaitForCheckpoints();
+	}
+	for (int restart = 0; restart < 2; ++restart)
+	{
+		SearchServer server;
+		server.SetDuplicateMode(DuplicateMode::REJECT);
+		DurableSearchServer durable(server, reject_directory, { 0, 100.0 });
+		ASSERT_EQUAL(server.GetDocumentCount(), 1u);
+		ASSERT_EQUAL(*server.begin(), 1);
+	}
+
+	std::filesystem::remove_all(directory);
+}
+
+void TestPositionalQueries(void)
+{
+	const auto find_ids = [](const auto& server, const std::string& query)
+	{
+		std::vector<int> ids;
+		for (const Document& document : server.FindTopDocuments(query))
+		{
+			ids.push_back(document.id);
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+	const auto expect_invalid = [](const SearchServer& server, const std::string& query)
+	{
+		try
+		{
+			server.FindTopDocuments(query);
+			ASSERT_HINT(false, "Должно было сработать исключение для запроса "s + query);
+		}
+		catch (const std::invalid_argument&)
+		{
+		}
+	};
+
+	{
+		// без позиционного индекса фразы не поддерживаются, а включить его можно только у пустого сервера
+		SearchServer server("and"s);
+		server.AddDocument(1, "curly hair"s, DocumentStatus::ACTUAL, { 1 });
+		ASSERT_EQUAL(server.FindTopDocuments("curly hair"s).size(), 1u);
+		expect_invalid(server, "\"curly hair\""s);
+		expect_invalid(server, "curly NEAR/1 hair"s);
+		try
+		{
+			server.SetPositionalIndex(true);
+			ASSERT_HINT(false, "Позиционный индекс нельзя включить у непустого сервера"s);
+		}
+		catch (const std::logic_error&)
+		{
+		}
+		ASSERT(!server.HasPositionalIndex());
+	}
+
+	SearchServer server("and the with"s);
+	server.SetPositionalIndex(true);
+	ASSERT(server.HasPositionalIndex());
+	server.AddDocument(1, "curly hair and long tail"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "hair curly dog"s, DocumentStatus::ACTUAL, { 2 });
+	server.AddDocument(3, "curly the hair cat"s, DocumentStatus::ACTUAL, { 3 });
+	server.AddDocument(4, "cat with curly long hair"s, DocumentStatus::ACTUAL, { 4 });
+	server.AddDocument(5, "curly cat"s, DocumentStatus::ACTUAL, { 5 });
+
+	// стоп-слово внутри фразы совпадает с любым словом на своей позиции
+	ASSERT((find_ids(server, "\"curly hair\""s) == std::vector<int>{ 1 }));
+	ASSERT((find_ids(server, "\"curly the hair\""s) == std::vector<int>{ 3, 4 }));
+	ASSERT((find_ids(server, "\"curly and hair\" -\"cat\""s).empty()));
+	ASSERT((find_ids(server, "\"curly hair\" cat"s) == std::vector<int>{ 1 }));
+	ASSERT((find_ids(server, "curly -\"curly hair\""s) == std::vector<int>{ 2, 3, 4, 5 }));
+	ASSERT((find_ids(server, "\"curly unknown\" cat"s).empty()));
+	ASSERT((find_ids(server, "\" long tail \""s) == std::vector<int>{ 1 }));
+
+	// NEAR не зависит от порядка слов
+	ASSERT((find_ids(server, "curly NEAR/1 hair"s) == std::vector<int>{ 1, 2 }));
+	ASSERT((find_ids(server, "curly NEAR/2 hair"s) == std::vector<int>{ 1, 2, 3, 4 }));
+	ASSERT((find_ids(server, "curly NEAR/2 hair NEAR/1 long"s) == std::vector<int>{ 4 }));
+	ASSERT((find_ids(server, "cat NEAR/1 the"s) == std::vector<int>{ 3, 4, 5 }));
+	{
+		// кандидаты, отброшенные проверкой позиций, видны в трассировке
+		QueryTrace trace;
+		server.FindTopDocuments("curly NEAR/1 hair"s, trace);
+		ASSERT_EQUAL(trace.documents_constrained, 3u);
+		ASSERT_EQUAL(trace.candidate_count, 2u);
+	}
+
+	// фразовые слова участвуют в ранжировании, параллельный поиск даёт тот же результат
+	const auto sequential = server.FindTopDocuments("\"curly hair\" long"s);
+	const auto parallel = server.FindTopDocuments(std::execution::par, "\"curly hair\" long"s);
+	ASSERT_EQUAL(sequential.size(), 1u);
+	ASSERT_EQUAL(parallel.size(), 1u);
+	ASSERT_EQUAL(sequential[0].id, parallel[0].id);
+	ASSERT(std::abs(sequential[0].relevance - parallel[0].relevance) < DEVIATION);
+
+	ASSERT((std::get<0>(server.MatchDocument("\"hair curly\" tail"s, 2)) == std::vector<std::string_view>{ "curly"sv, "hair"sv }));
+	ASSERT(std::get<0>(server.MatchDocument("\"hair curly\" tail"s, 1)).empty());
+	ASSERT(std::get<0>(server.MatchDocument("tail -\"curly hair\""s, 1)).empty());
+	const MatchedDocuments matched = server.MatchDocuments("cat NEAR/2 curly"s, { 3, 4, 5 });
+	ASSERT_EQUAL(matched.GetWords(0).size(), 0u);
+	ASSERT_EQUAL(matched.GetWords(1).size(), 2u);
+	ASSERT_EQUAL(matched.GetWords(2).size(), 2u);
+
+	expect_invalid(server, "\"curly hair"s);
+	expect_invalid(server, "\"curly -hair\""s);
+	expect_invalid(server, "NEAR/2 cat"s);
+	expect_invalid(server, "cat NEAR/2"s);
+	expect_invalid(server, "-cat NEAR/2 dog"s);
+	expect_invalid(server, "cat NEAR/0 dog"s);
+	expect_invalid(server, "cat NEAR/x dog"s);
+
+	// позиции удаляются вместе с документом, повторяющиеся слова дают несколько позиций
+	server.RemoveDocument(1);
+	ASSERT(find_ids(server, "\"curly hair\""s).empty());
+	server.AddDocument(6, "hair hair curly hair"s, DocumentStatus::ACTUAL, { 6 });
+	ASSERT((find_ids(server, "\"curly hair\""s) == std::vector<int>{ 6 }));
+	ASSERT((find_ids(server, "\"hair hair curly\""s) == std::vector<int>{ 6 }));
+
+	ShardedSearchServer sharded("and"s, 3);
+	sharded.SetPositionalIndex(true);
+	for (int id = 0; id < 9; ++id)
+	{
+		sharded.AddDocument(id, id % 2 == 0 ? "black cat"s : "cat black"s, DocumentStatus::ACTUAL, { id });
+	}
+	ASSERT((find_ids(sharded, "\"black cat\""s) == std::vector<int>{ 0, 2, 4, 6, 8 }));
+}
+
+void TestConjunctiveQueries(void)
+{
+	{
+		// SkipTo перескакивает блоки и не двигается назад
+		PostingList postings;
+		std::set<int> expected;
+		for (int document_id = 0; document_id < 5000; document_id += 3)
+		{
+			postings.Add(document_id, 1);
+			expected.insert(document_id);
+		}
+		for (int document_id = 0; document_id < 5000; document_id += 7)
+		{
+			postings.Remove(document_id);
+			expected.erase(document_id);
+		}
+		auto iter = postings.begin();
+		int reached = 0;
+		for (const int target : { 1, 2, 400, 401, 402, 3000, 2000, 4990, 4995 })
+		{
+			iter.SkipTo(target);
+			reached = std::max(reached, target);
+			ASSERT_EQUAL(iter->document_id, *expected.lower_bound(reached));
+		}
+		iter.SkipTo(5000);
+		ASSERT(iter == postings.end());
+	}
+
+	SearchServer server("and"s);
+	server.AddDocument(1, "white cat and black dog"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "white cat"s, DocumentStatus::ACTUAL, { 2 });
+	server.AddDocument(3, "black dog"s, DocumentStatus::ACTUAL, { 3 });
+	server.AddDocument(4, "black cat with white collar"s, DocumentStatus::ACTUAL, { 4 });
+	server.AddDocument(5, "cat cat dog"s, DocumentStatus::BANNED, { 5 });
+
+	const auto find_ids = [&server](const std::string& query)
+	{
+		std::vector<int> ids;
+		for (const Document& document : server.FindTopDocuments(query))
+		{
+			ids.push_back(document.id);
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+	ASSERT((find_ids("+cat +dog"s) == std::vector<int>{ 1 }));
+	ASSERT((find_ids("+cat +white"s) == std::vector<int>{ 1, 2, 4 }));
+	ASSERT((find_ids("+cat +white -collar"s) == std::vector<int>{ 1, 2 }));
+	ASSERT((find_ids("+cat dog"s) == std::vector<int>{ 1, 2, 4 }));
+	ASSERT((find_ids("+cat cat"s) == std::vector<int>{ 1, 2, 4 }));
+	ASSERT((find_ids("+cat +mouse"s).empty()));
+	ASSERT((find_ids("+and cat"s) == std::vector<int>{ 1, 2, 4 }));
+
+	// обязательные слова не меняют релевантность найденных документов
+	const auto conjunctive = server.FindTopDocuments("+cat +white dog"s);
+	const auto disjunctive = server.FindTopDocuments("cat white dog"s);
+	for (const Document& document : conjunctive)
+	{
+		const auto same = std::find_if(disjunctive.begin(), disjunctive.end(), [&document](const Document& other)
+			{
+				return other.id == document.id;
+			});
+		ASSERT(same != disjunctive.end());
+		ASSERT(std::abs(same->relevance - document.relevance) < DEVIATION);
+	}
+	ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "+cat +white dog"s).size(), conjunctive.size());
+	ASSERT_EQUAL(server.FindTopDocuments("+cat +dog"s, DocumentStatus::BANNED)[0].id, 5);
+
+	ASSERT((std::get<0>(server.MatchDocument("+cat dog"s, 3)).empty()));
+	ASSERT((std::get<0>(server.MatchDocument("+cat +mouse"s, 1)).empty()));
+	ASSERT((std::get<0>(server.MatchDocument("+cat dog"s, 1)) == std::vector<std::string_view>{ "cat"sv, "dog"sv }));
+	const MatchedDocuments matched = server.MatchDocuments("+white black"s, { 1, 3, 4 });
+	ASSERT_EQUAL(matched.GetWords(0).size(), 2u);
+	ASSERT_EQUAL(matched.GetWords(1).size(), 0u);
+	ASSERT_EQUAL(matched.GetWords(2).size(), 2u);
+
+	for (const std::string& query : { "+"s, "++cat"s, "-+cat"s, "+-cat"s })
+	{
+		try
+		{
+			server.FindTopDocuments(query);
+			ASSERT_HINT(false, "Должно было сработать исключение для запроса "s + query);
+		}
+		catch (const std::invalid_argument&)
+		{
+		}
+	}
+
+	// пересечение длинных списков проверяется по числу кандидатов в трассировке
+	SearchServer large;
+	for (int id = 0; id < 3000; ++id)
+	{
+		std::string text = "word"s;
+		for (const auto& [divisor, word] : { std::pair{ 2, "two"s }, std::pair{ 3, "three"s }, std::pair{ 5, "five"s } })
+		{
+			if (id % divisor == 0)
+			{
+				text += " "s + word;
+			}
+		}
+		large.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+	}
+	QueryTrace trace;
+	const auto all = [](int document_id, DocumentStatus status, int rating)
+	{
+		return true;
+	};
+	const auto top = large.FindTopDocuments(std::execution::seq, "+five +two +three word"s, all, trace);
+	ASSERT_EQUAL(trace.candidate_count, 100u);
+	ASSERT_EQUAL(top[0].id, 2970);
+	ASSERT_EQUAL(trace.plus_terms.size(), 4u);
+	large.FindTopDocuments(std::execution::seq, "+two +five -three"s, all, trace);
+	ASSERT_EQUAL(trace.candidate_count, 200u);
+	ASSERT_EQUAL(trace.documents_excluded, 100u);
+
+	// предикат отбрасывает половину пересечения, остальные записи списков до оценки не доходят
+	large.FindTopDocuments(std::execution::seq, "+two +five"s, [](int document_id, DocumentStatus status, int rating)
+		{
+			return document_id < 1500;
+		}, trace);
+	ASSERT_EQUAL(trace.candidate_count, 150u);
+	ASSERT_EQUAL(trace.documents_scored, 300u);
+	ASSERT_EQUAL(trace.documents_filtered, 300u);
+	ASSERT_EQUAL(trace.documents_skipped, 1500u);
+	for (const QueryTrace::Term& term : trace.plus_terms)
+	{
+		ASSERT_EQUAL(term.documents_scored + term.documents_filtered + term.documents_skipped, term.posting_count);
+	}
+}
+
+void TestPrefixQueries(void)
+{
+	{
+		// словарь находит слова с префиксом и среди сжатых блоков, и среди ещё не слитых слов
+		std::vector<std::string> words;
+		for (int index = 0; index < 1000; ++index)
+		{
+			words.push_back("w"s + std::to_string((index * 7919) % 1000));
+		}
+		words.push_back("w"s);
+		words.push_back("v"s);
+		TermDictionary dictionary;
+		for (size_t index = 0; index < words.size(); ++index)
+		{
+			dictionary.Add(words[index], static_cast<int>(index));
+		}
+		ASSERT_EQUAL(dictionary.size(), words.size());
+		for (const std::string& prefix : { "w1"s, "w99"s, "w"s, "w500"s, "x"s, ""s, "u"s })
+		{
+			std::pmr::vector<int> found;
+			dictionary.FindPrefix(prefix, found);
+			std::sort(found.begin(), found.end());
+			std::pmr::vector<int> expected;
+			for (size_t index = 0; index < words.size(); ++index)
+			{
+				if (words[index].rfind(prefix, 0) == 0)
+				{
+					expected.push_back(static_cast<int>(index));
+				}
+			}
+			ASSERT(found == expected);
+		}
+	}
+
+	const std::vector<std::pair<int, std::string>> documents = {
+		{ 1, "curly hair"s },
+		{ 2, "curtain call"s },
+		{ 3, "cure for cat"s },
+		{ 4, "dog"s },
+		{ 5, "curly curly cur"s },
+	};
+	SearchServer server("for"s);
+	ShardedSearchServer sharded("for"s, 2);
+	for (const auto& [id, text] : documents)
+	{
+		server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+		sharded.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+	}
+	const auto find_ids = [](const auto& server, const std::string& query)
+	{
+		std::vector<int> ids;
+		for (const Document& document : server.FindTopDocuments(query))
+		{
+			ids.push_back(document.id);
+		}
+		return ids;
+	};
+
+	ASSERT((find_ids(server, "cur*"s) == find_ids(sharded, "cur*"s)));
+	std::vector<int> ids = find_ids(server, "cur*"s);
+	std::sort(ids.begin(), ids.end());
+	ASSERT((ids == std::vector<int>{ 1, 2, 3, 5 }));
+	ASSERT((find_ids(server, "curl*"s) == std::vector<int>{ 5, 1 }));
+	ASSERT((find_ids(server, "dog cat -cur*"s) == std::vector<int>{ 4 }));
+	ASSERT((find_ids(server, "+cur* +hair"s) == std::vector<int>{ 1 }));
+	ASSERT((find_ids(server, "+cur* dog"s).size() == 4u));
+	ASSERT(find_ids(server, "bird*"s).empty());
+	ASSERT_EQUAL(server.GetQueryStatistics("cur* dog"s).document_freqs.at("cur*"s), 4u);
+
+	ASSERT((std::get<0>(server.MatchDocument("cur* hair"s, 5)) == std::vector<std::string_view>{ "cur"sv, "curly"sv }));
+	ASSERT(std::get<0>(server.MatchDocument("+cur* dog"s, 4)).empty());
+	ASSERT(std::get<0>(server.MatchDocument("hair -cur*"s, 1)).empty());
+	ASSERT_EQUAL(server.MatchDocuments("+cure* call"s, { 2, 3 }).GetWords(1).size(), 1u);
+	ASSERT_EQUAL(server.MatchDocuments("+cure* call"s, { 2, 3 }).GetWords(0).size(), 0u);
+
+	// при ограничении остаются самые частые слова
+	server.SetMaxPrefixExpansions(1);
+	ASSERT_EQUAL(server.GetMaxPrefixExpansions(), 1u);
+	ASSERT((find_ids(server, "cur*"s) == std::vector<int>{ 5, 1 }));
+	server.SetMaxPrefixExpansions(MAX_PREFIX_EXPANSIONS);
+
+	{
+		// минус-слово с префиксом исключает документы со всеми своими словами, несмотря на ограничение
+		SearchServer minus_server(""s);
+		minus_server.AddDocument(1, "curly hair cat"s, DocumentStatus::ACTUAL, { 1 });
+		minus_server.AddDocument(2, "curly dog cat"s, DocumentStatus::ACTUAL, { 2 });
+		minus_server.AddDocument(3, "cure cat"s, DocumentStatus::ACTUAL, { 3 });
+		minus_server.SetMaxPrefixExpansions(1);
+		ASSERT(find_ids(minus_server, "cat -cur*"s).empty());
+		ASSERT(find_ids(minus_server, "cur* -cur*"s).empty());
+		ASSERT(std::get<0>(minus_server.MatchDocument("cat -cur*"s, 3)).empty());
+		ASSERT((find_ids(minus_server, "cur*"s) == std::vector<int>{ 2, 1 }));
+	}
+
+	server.RemoveDocument(2);
+	ASSERT(find_ids(server, "curt*"s).empty());
+	server.AddDocument(6, "curtain"s, DocumentStatus::ACTUAL, { 6 });
+	ASSERT((find_ids(server, "curt*"s) == std::vector<int>{ 6 }));
+
+	try
+	{
+		server.FindTopDocuments("cur**"s);
+		ASSERT_HINT(false, "Должно было сработать исключение для запроса cur**"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer()
 {
@@ -743,5 +2405,27 @@ void TestSearchServer()
 	RUN_TEST(TestGetWordFrequencies);
 	RUN_TEST(TestRemoveDocument);
 	RUN_TEST(TestRemoveDuplicates);
+	RUN_TEST(TestDuplicateDetectionAtIngest);
+	RUN_TEST(TestNearDuplicates);
+	RUN_TEST(TestPostingList);
+	RUN_TEST(TestBm25Ranking);
+	RUN_TEST(TestRankingPolicies);
+	RUN_TEST(TestMatchDocumentUsesForwardIndex);
+	RUN_TEST(TestMatchDocumentsBatch);
+	RUN_TEST(TestQueryArena);
+	RUN_TEST(TestIndexMemoryResource);
+	RUN_TEST(TestRequestQueue);
+	RUN_TEST(TestRequestStatistics);
+	RUN_TEST(TestInstrumentation);
+	RUN_TEST(TestExplainQuery);
+	RUN_TEST(TestAdaptiveExecution);
+	RUN_TEST(TestShardedSearchServer);
+	RUN_TEST(TestShardCoordinator);
+	RUN_TEST(TestQueryServer);
+	RUN_TEST(TestLoadDocuments);
+	RUN_TEST(TestDurableSearchServer);
+	RUN_TEST(TestPositionalQueries);
+	RUN_TEST(TestConjunctiveQueries);
+	RUN_TEST(TestPrefixQueries);
 }
 // --------- Окончание модульных тестов поисковой системы -----------
\ No newline at end of file
@@ -3,12 +3,30 @@
 #include "paginator.h"
 #include "document.h"
 #include "remove_duplicates.h"
+#include "near_duplicates.h"
+#include "request_queue.h"
+#include "instrumentation.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "shard_coordinator.h"
+#include "shard_service.h"
+#include "query_server.h"
+#include "document_loader.h"
+#include "durable_search_server.h"
 
 #include <vector>
 #include <string>
 #include <iostream>
 #include <tuple>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <memory>
+#include <system_error>
+
+#include <unistd.h>
 
 using std::string_literals::operator""s;
 
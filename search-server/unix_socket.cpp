@@ -0,0 +1,223 @@
+#include "unix_socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	sockaddr_un MakeAddress(const std::string& path)
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(address.sun_path))
+		{
+			throw std::invalid_argument("Недопустимый путь к сокету: "s + path);
+		}
+		std::memcpy(address.sun_path, path.data(), path.size());
+		return address;
+	}
+
+	[[noreturn]] void ThrowSystemError(const std::string& what)
+	{
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+}
+
+UnixSocket::UnixSocket(int descriptor)
+	: descriptor_(descriptor)
+{}
+
+UnixSocket::UnixSocket(UnixSocket&& other) noexcept
+	: descriptor_(std::exchange(other.descriptor_, -1))
+{}
+
+UnixSocket& UnixSocket::operator=(UnixSocket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		descriptor_ = std::exchange(other.descriptor_, -1);
+	}
+	return *this;
+}
+
+UnixSocket::~UnixSocket()
+{
+	Close();
+}
+
+UnixSocket UnixSocket::Listen(const std::string& path, int backlog)
+{
+	const sockaddr_un address = MakeAddress(path);
+	UnixSocket result(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	if (!result)
+	{
+		ThrowSystemError("socket"s);
+	}
+	::unlink(path.c_str());
+	if (::bind(result.descriptor_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		ThrowSystemError("bind "s + path);
+	}
+	if (::listen(result.descriptor_, backlog) != 0)
+	{
+		ThrowSystemError("listen "s + path);
+	}
+	return result;
+}
+
+UnixSocket UnixSocket::Connect(const std::string& path)
+{
+	const sockaddr_un address = MakeAddress(path);
+	UnixSocket result(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	if (!result)
+	{
+		ThrowSystemError("socket"s);
+	}
+	if (::connect(result.descriptor_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		ThrowSystemError("connect "s + path);
+	}
+	return result;
+}
+
+UnixSocket UnixSocket::Accept() const
+{
+	while (true)
+	{
+		const int descriptor = ::accept4(descriptor_, nullptr, nullptr, SOCK_CLOEXEC);
+		if (descriptor >= 0)
+		{
+			return UnixSocket(descriptor);
+		}
+		if (errno == EINTR || errno == ECONNABORTED)
+		{
+			continue;
+		}
+		if (errno == EINVAL)
+		{
+			// The listening socket was shut down
+			return UnixSocket();
+		}
+		ThrowSystemError("accept"s);
+	}
+}
+
+void UnixSocket::WriteFrame(std::string_view payload) const
+{
+	if (payload.size() > MAX_FRAME_SIZE)
+	{
+		throw std::length_error("Слишком большое сообщение: "s + std::to_string(payload.size()) + " байт"s);
+	}
+	const uint32_t size = static_cast<uint32_t>(payload.size());
+	const char header[4] = {
+		static_cast<char>(size & 0xFF),
+		static_cast<char>((size >> 8) & 0xFF),
+		static_cast<char>((size >> 16) & 0xFF),
+		static_cast<char>(size >> 24),
+	};
+	WriteAll(header, sizeof(header));
+	WriteAll(payload.data(), payload.size());
+}
+
+std::optional<std::string> UnixSocket::ReadFrame() const
+{
+	unsigned char header[4];
+	if (!ReadAll(reinterpret_cast<char*>(header), sizeof(header)))
+	{
+		return std::nullopt;
+	}
+	const uint32_t size = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+	if (size > MAX_FRAME_SIZE)
+	{
+		throw std::length_error("Слишком большое сообщение: "s + std::to_string(size) + " байт"s);
+	}
+	std::string payload(size, '\0');
+	if (size > 0 && !ReadAll(payload.data(), size))
+	{
+		throw std::runtime_error("Соединение закрыто посреди сообщения"s);
+	}
+	return payload;
+}
+
+void UnixSocket::Shutdown() const
+{
+	if (descriptor_ >= 0)
+	{
+		::shutdown(descriptor_, SHUT_RDWR);
+	}
+}
+
+void UnixSocket::Close()
+{
+	if (descriptor_ >= 0)
+	{
+		::close(descriptor_);
+		descriptor_ = -1;
+	}
+}
+
+int UnixSocket::GetDescriptor() const
+{
+	return descriptor_;
+}
+
+UnixSocket::operator bool() const
+{
+	return descriptor_ >= 0;
+}
+
+void UnixSocket::WriteAll(const char* data, size_t size) const
+{
+	while (size > 0)
+	{
+		// MSG_NOSIGNAL turns a write to a closed peer into EPIPE instead of SIGPIPE
+		const ssize_t written = ::send(descriptor_, data, size, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			ThrowSystemError("send"s);
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+}
+
+bool UnixSocket::ReadAll(char* data, size_t size) const
+{
+	size_t total = 0;
+	while (total < size)
+	{
+		const ssize_t received = ::recv(descriptor_, data + total, size - total, 0);
+		if (received < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			ThrowSystemError("recv"s);
+		}
+		if (received == 0)
+		{
+			if (total == 0)
+			{
+				return false;
+			}
+			throw std::runtime_error("Соединение закрыто посреди сообщения"s);
+		}
+		total += static_cast<size_t>(received);
+	}
+	return true;
+}
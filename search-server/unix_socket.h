@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Owner of a Unix domain socket descriptor. Errors of the system calls are thrown as std::system_error
+class UnixSocket
+{
+public:
+	UnixSocket() = default;
+	explicit UnixSocket(int descriptor);
+	UnixSocket(UnixSocket&& other) noexcept;
+	UnixSocket& operator=(UnixSocket&& other) noexcept;
+	UnixSocket(const UnixSocket&) = delete;
+	UnixSocket& operator=(const UnixSocket&) = delete;
+	~UnixSocket();
+
+	// Replaces a stale socket file left at the path by a previous process
+	static UnixSocket Listen(const std::string& path, int backlog = 64);
+	static UnixSocket Connect(const std::string& path);
+	// An empty socket once Shutdown was called on the listening one
+	UnixSocket Accept() const;
+
+	// Frames are a 32-bit little-endian payload length followed by the payload
+	void WriteFrame(std::string_view payload) const;
+	// Nothing when the peer closed the connection between frames
+	std::optional<std::string> ReadFrame() const;
+
+	// Wakes up threads blocked in Accept or ReadFrame on this socket
+	void Shutdown() const;
+	void Close();
+
+	int GetDescriptor() const;
+	explicit operator bool() const;
+
+	static constexpr uint32_t MAX_FRAME_SIZE = 64u << 20;
+
+private:
+	int descriptor_ = -1;
+
+	void WriteAll(const char* data, size_t size) const;
+	// False when the connection is closed before the first byte
+	bool ReadAll(char* data, size_t size) const;
+};
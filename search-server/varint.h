@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Variable-byte encoding shared by the compressed index structures: seven bits of the value per byte,
+// least significant first, with the high bit set on every byte but the last
+
+inline void WriteVarint(std::pmr::vector<uint8_t>& bytes, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		bytes.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back(static_cast<uint8_t>(value));
+}
+
+// Decodes the value starting at position and moves position past it
+inline uint32_t ReadVarint(const uint8_t* bytes, size_t& position)
+{
+	uint32_t value = 0;
+	for (int shift = 0;; shift += 7)
+	{
+		const uint8_t byte = bytes[position++];
+		value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+}
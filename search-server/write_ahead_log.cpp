@@ -0,0 +1,249 @@
+#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace
+{
+	const size_t FRAME_HEADER_SIZE = 8;
+
+	[[noreturn]] void ThrowSystemError(const std::string& what)
+	{
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	std::array<uint32_t, 256> MakeCrcTable()
+	{
+		// Reflected Castagnoli polynomial
+		std::array<uint32_t, 256> table{};
+		for (uint32_t index = 0; index < 256; ++index)
+		{
+			uint32_t value = index;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				value = (value >> 1) ^ ((value & 1) != 0 ? 0x82F63B78u : 0u);
+			}
+			table[index] = value;
+		}
+		return table;
+	}
+
+	uint32_t ComputeCrc32c(std::string_view data)
+	{
+		static const std::array<uint32_t, 256> table = MakeCrcTable();
+		uint32_t crc = ~0u;
+		for (const char c : data)
+		{
+			crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void PutUint32(std::string& data, uint32_t value)
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			data.push_back(static_cast<char>((value >> shift) & 0xFF));
+		}
+	}
+
+	uint32_t GetUint32(const char* data)
+	{
+		uint32_t value = 0;
+		for (int index = 3; index >= 0; --index)
+		{
+			value = (value << 8) | static_cast<uint8_t>(data[index]);
+		}
+		return value;
+	}
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, uint64_t valid_size)
+	: descriptor_(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644))
+	, written_position_(valid_size)
+	, synced_position_(valid_size)
+{
+	if (descriptor_ < 0)
+	{
+		ThrowSystemError("open "s + path);
+	}
+	if (::ftruncate(descriptor_, static_cast<off_t>(valid_size)) != 0 || ::fsync(descriptor_) != 0)
+	{
+		const int error = errno;
+		::close(descriptor_);
+		throw std::system_error(error, std::generic_category(), "ftruncate "s + path);
+	}
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+	::close(descriptor_);
+}
+
+uint64_t WriteAheadLog::Write(std::string_view payload)
+{
+	std::lock_guard guard(mutex_);
+	if (error_)
+	{
+		std::rethrow_exception(error_);
+	}
+	const size_t size = buffer_.size();
+	AppendFrame(buffer_, payload);
+	written_position_ += buffer_.size() - size;
+	return written_position_;
+}
+
+void WriteAheadLog::Sync(uint64_t position)
+{
+	std::unique_lock lock(mutex_);
+	while (synced_position_ < position)
+	{
+		if (error_)
+		{
+			std::rethrow_exception(error_);
+		}
+		if (syncing_)
+		{
+			synced_.wait(lock);
+			continue;
+		}
+
+		syncing_ = true;
+		const std::string data = std::move(buffer_);
+		buffer_.clear();
+		const uint64_t target_position = written_position_;
+		lock.unlock();
+		std::exception_ptr error;
+		try
+		{
+			WriteAndSync(data);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		lock.lock();
+		syncing_ = false;
+		if (error)
+		{
+			// The file may hold a part of the data, nothing may follow it
+			error_ = error;
+		}
+		else
+		{
+			synced_position_ = target_position;
+		}
+		synced_.notify_all();
+	}
+}
+
+uint64_t WriteAheadLog::GetPosition() const
+{
+	std::lock_guard guard(mutex_);
+	return written_position_;
+}
+
+void WriteAheadLog::Rotate(const std::string& path)
+{
+	// Opened first, so that a failure leaves the current file in use
+	const int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+	if (descriptor < 0)
+	{
+		ThrowSystemError("open "s + path);
+	}
+	try
+	{
+		Sync(GetPosition());
+	}
+	catch (...)
+	{
+		::close(descriptor);
+		throw;
+	}
+	std::unique_lock lock(mutex_);
+	synced_.wait(lock, [this]()
+		{
+			return !syncing_;
+		});
+	if (!buffer_.empty())
+	{
+		::close(descriptor);
+		throw std::logic_error("Файл журнала нельзя сменить во время записи в журнал"s);
+	}
+	::close(descriptor_);
+	descriptor_ = descriptor;
+}
+
+void WriteAheadLog::AppendFrame(std::string& data, std::string_view payload)
+{
+	if (payload.empty())
+	{
+		throw std::invalid_argument("Запись журнала не может быть пустой"s);
+	}
+	PutUint32(data, static_cast<uint32_t>(payload.size()));
+	PutUint32(data, ComputeCrc32c(payload));
+	data.append(payload);
+}
+
+std::vector<std::string_view> WriteAheadLog::ReadFrames(std::string_view data, size_t& valid_size)
+{
+	// Frame boundaries only depend on the lengths, the checksums are the expensive part. No frame is empty, and
+	// an empty one would pass its zero checksum, so a zero length ends the data like the zeroed tail a crash may leave
+	std::vector<size_t> offsets;
+	size_t offset = 0;
+	while (data.size() - offset >= FRAME_HEADER_SIZE
+		&& GetUint32(data.data() + offset) > 0
+		&& data.size() - offset - FRAME_HEADER_SIZE >= GetUint32(data.data() + offset))
+	{
+		offsets.push_back(offset);
+		offset += FRAME_HEADER_SIZE + GetUint32(data.data() + offset);
+	}
+
+	std::vector<uint8_t> valid(offsets.size());
+	std::transform(std::execution::par, offsets.begin(), offsets.end(), valid.begin(), [data](size_t frame_offset)
+		{
+			const std::string_view payload = data.substr(frame_offset + FRAME_HEADER_SIZE, GetUint32(data.data() + frame_offset));
+			return static_cast<uint8_t>(ComputeCrc32c(payload) == GetUint32(data.data() + frame_offset + 4));
+		});
+	const size_t frame_count = std::find(valid.begin(), valid.end(), 0) - valid.begin();
+
+	std::vector<std::string_view> payloads;
+	payloads.reserve(frame_count);
+	for (size_t index = 0; index < frame_count; ++index)
+	{
+		payloads.push_back(data.substr(offsets[index] + FRAME_HEADER_SIZE, GetUint32(data.data() + offsets[index])));
+	}
+	valid_size = frame_count < offsets.size() ? offsets[frame_count] : offset;
+	return payloads;
+}
+
+void WriteAheadLog::WriteAndSync(const std::string& data)
+{
+	size_t written = 0;
+	while (written < data.size())
+	{
+		const ssize_t result = ::write(descriptor_, data.data() + written, data.size() - written);
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			ThrowSystemError("write"s);
+		}
+		written += static_cast<size_t>(result);
+	}
+	if (::fdatasync(descriptor_) != 0)
+	{
+		ThrowSystemError("fdatasync"s);
+	}
+}
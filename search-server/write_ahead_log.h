@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Append-only file of checksummed records. Every record is a frame of a 32-bit little-endian payload length,
+// the CRC-32C of the payload, also little-endian, and the payload.
+//
+// Records are buffered by Write and made durable by Sync with group commit: the first caller to find the log
+// behind its record writes and fsyncs whatever all callers buffered so far, the others wait for it, so updates
+// coming in at the same time share one fsync. Errors of the system calls are thrown as std::system_error,
+// after a failed write or fsync the log refuses further records
+class WriteAheadLog
+{
+public:
+	// Creates the file if needed. Whatever follows the first valid_size bytes is cut off, see ReadFrames.
+	// Positions start at valid_size
+	WriteAheadLog(const std::string& path, uint64_t valid_size);
+	WriteAheadLog(const WriteAheadLog&) = delete;
+	WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+	~WriteAheadLog();
+
+	// Returns the position to wait for with Sync
+	uint64_t Write(std::string_view payload);
+	void Sync(uint64_t position);
+	// The position after the last record written
+	uint64_t GetPosition() const;
+	// Syncs the records written so far to the current file, then continues in a new one. The positions go on
+	// from where they were. Must not run concurrently with Write
+	void Rotate(const std::string& path);
+
+	// The payload must not be empty
+	static void AppendFrame(std::string& data, std::string_view payload);
+	// Payloads of the valid frames at the start of the data, the checksums are verified in parallel. Reading stops
+	// at a truncated frame, a zero length or a checksum mismatch, as left by a crash in the middle of a write, and valid_size
+	// receives the size of the data before it
+	static std::vector<std::string_view> ReadFrames(std::string_view data, size_t& valid_size);
+
+private:
+	int descriptor_ = -1;
+	mutable std::mutex mutex_;
+	std::condition_variable synced_;
+	std::string buffer_;
+	// Positions count the bytes of all records ever written, across the files
+	uint64_t written_position_ = 0;
+	uint64_t synced_position_ = 0;
+	bool syncing_ = false;
+	std::exception_ptr error_;
+
+	// Called by the caller that set syncing_, with the mutex unlocked
+	void WriteAndSync(const std::string& data);
+};